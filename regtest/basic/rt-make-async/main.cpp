@@ -0,0 +1,71 @@
+#include "plumed/wrapper/Plumed.h"
+#include <vector>
+#include <fstream>
+#include <cmath>
+
+using namespace PLMD;
+
+// run a short simulation where PLUMED is called either synchronously
+// or overlapping its calculation with the computation of the MD forces
+void run(const std::string & name,bool async,bool energy) {
+  Plumed plumed;
+
+  int natoms=20;
+
+  std::vector<double> positions(3*natoms,0.0);
+  for(unsigned i=0; i<positions.size(); i++) positions[i]=std::sin(i)+0.2*i;
+  std::vector<double> masses(natoms,1.0);
+  std::vector<double> forces(3*natoms,0.0);
+  std::vector<double> box(9,0.0);
+  std::vector<double> virial(9,0.0);
+  double md_energy=0.0;
+
+  plumed.cmd("setNatoms",natoms);
+  plumed.cmd("setLogFile",(name+".log").c_str());
+  plumed.cmd("init");
+  plumed.cmd("readInputLine","d: DISTANCE ATOMS=1,2");
+  plumed.cmd("readInputLine","c: COORDINATION GROUPA=1-10 GROUPB=11-20 R_0=1.0");
+  plumed.cmd("readInputLine","RESTRAINT ARG=d AT=0 KAPPA=1");
+  plumed.cmd("readInputLine","RESTRAINT ARG=c AT=0 KAPPA=2");
+  if(energy) plumed.cmd("readInputLine","e: ENERGY");
+  if(energy) plumed.cmd("readInputLine","PRINT ARG=d,c,e FILE="+name+".colvar");
+  else plumed.cmd("readInputLine","PRINT ARG=d,c FILE="+name+".colvar");
+
+  std::ofstream ofs(name);
+  for(int step=0; step<5; step++) {
+    for(auto & f : forces) f=0.0;
+    for(auto & v : virial) v=0.0;
+    plumed.cmd("setStep",step);
+    plumed.cmd("setPositions",&positions[0],3*natoms);
+    plumed.cmd("setBox",&box[0],9);
+    plumed.cmd("setForces",&forces[0],3*natoms);
+    plumed.cmd("setVirial",&virial[0],9);
+    plumed.cmd("setMasses",&masses[0],natoms);
+    plumed.cmd("setEnergy",&md_energy);
+    plumed.cmd("prepareCalc");
+    if(async) plumed.cmd("startCalc");
+// the MD code computes its own forces and energy
+    md_energy=0.0;
+    for(unsigned i=0; i<forces.size(); i++) {
+      forces[i]+=-0.1*positions[i];
+      md_energy+=0.05*positions[i]*positions[i];
+    }
+    plumed.cmd("performCalc");
+    double bias;
+    plumed.cmd("getBias",&bias);
+    ofs<<"bias: "<<bias<<"\n";
+    ofs<<"f:";
+    for(auto & f : forces) ofs<<" "<<f;
+    ofs<<"\n";
+    for(unsigned i=0; i<positions.size(); i++) positions[i]+=0.01*forces[i];
+  }
+}
+
+int main() {
+  run("sync",false,false);
+  run("async",true,false);
+  // with ENERGY the calculation falls back to the synchronous mode
+  run("sync_energy",false,true);
+  run("async_energy",true,true);
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "mpi.h"
+#include "plumed/wrapper/Plumed.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Replica exchange between two replicas done as in GROMACS, comparing the energies obtained
+// exchanging the positions with the ones obtained with EXCHANGE_ARGUMENTS
+
+using namespace PLMD;
+
+struct Scenario {
+  std::string name;
+  std::string input[2];
+  std::string cv;
+};
+
+// Run a short simulation and return the number of times the CV was calculated
+unsigned run(const Scenario& s,int rank,bool exchangeArguments,std::vector<double>& deltas) {
+  std::string suffix=s.name+"."+std::to_string(exchangeArguments)+"."+std::to_string(rank);
+  {
+    std::ofstream ofs("plumed."+suffix+".dat");
+    if(exchangeArguments) ofs<<"EXCHANGE_ARGUMENTS\n";
+    ofs<<s.input[rank];
+  }
+  const int natoms=6;
+  Plumed p;
+  MPI_Comm intracomm=MPI_COMM_SELF;
+  MPI_Comm intercomm=MPI_COMM_WORLD;
+  p.cmd("GREX setMPIIntracomm",&intracomm);
+  p.cmd("GREX setMPIIntercomm",&intercomm);
+  p.cmd("GREX init");
+  p.cmd("setMDEngine","test");
+  p.cmd("setNatoms",&natoms);
+  double timestep=0.001;
+  p.cmd("setTimestep",&timestep);
+  std::string plumedDat="plumed."+suffix+".dat";
+  std::string logFile="log."+suffix;
+  p.cmd("setPlumedDat",plumedDat.c_str());
+  p.cmd("setLogFile",logFile.c_str());
+  p.cmd("init");
+  int counters=1;
+  p.cmd("setActionCounters",&counters);
+  std::vector<double> positions(3*natoms),forces(3*natoms),masses(natoms,1.0),virial(9);
+  for(int step=0; step<3; step++) {
+    for(int i=0; i<3*natoms; i++) positions[i]=std::sin(0.37*i+0.11*rank+0.05*step)+0.3*i;
+    std::fill(forces.begin(),forces.end(),0.0);
+    std::fill(virial.begin(),virial.end(),0.0);
+    p.cmd("setStep",&step);
+    p.cmd("setPositions",positions.data());
+    p.cmd("setForces",forces.data());
+    p.cmd("setMasses",masses.data());
+    p.cmd("setVirial",virial.data());
+    p.cmd("calc");
+    p.cmd("GREX savePositions");
+    int partner=1-rank;
+    p.cmd("GREX setPartner",&partner);
+    p.cmd("GREX calculate");
+    double delta;
+    p.cmd("GREX getLocalDeltaBias",&delta);
+    deltas.push_back(delta);
+  }
+  int size;
+  p.cmd("getTimingReportSize",&size);
+  std::vector<char> report(size);
+  p.cmd("getTimingReport",report.data());
+  std::istringstream iss(report.data());
+  std::string line;
+  while(std::getline(iss,line)) {
+    std::istringstream words(line);
+    std::string label;
+    unsigned calls;
+    if(words>>label>>calls && label==s.cv) return calls;
+  }
+  return 0;
+}
+
+int main(int argc,char**argv) {
+  MPI_Init(&argc,&argv);
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  std::ofstream ofs("output"+std::to_string(rank));
+
+  std::vector<Scenario> scenarios;
+  scenarios.push_back({"restraint",{
+      "t: TORSION ATOMS=1,2,3,4\nd: DISTANCE ATOMS=1,5\nRESTRAINT ARG=t,d AT=0.5,1.0 KAPPA=10,5\n",
+      "t: TORSION ATOMS=1,2,3,4\nd: DISTANCE ATOMS=1,5\nRESTRAINT ARG=t,d AT=1.5,1.0 KAPPA=10,6\n"
+    },"t"});
+  scenarios.push_back({"combine",{
+      "d1: DISTANCE ATOMS=1,2\nd2: DISTANCE ATOMS=3,4\nc: COMBINE ARG=d1,d2 COEFFICIENTS=1,2 PERIODIC=NO\nUPPER_WALLS ARG=c AT=0.5 KAPPA=100\n",
+      "d1: DISTANCE ATOMS=1,2\nd2: DISTANCE ATOMS=3,4\nc: COMBINE ARG=d1,d2 COEFFICIENTS=1,3 PERIODIC=NO\nRESTRAINT ARG=c,d1 AT=1.0,0.5 KAPPA=10,20\n"
+    },"d1"});
+  scenarios.push_back({"different",{
+      "t: TORSION ATOMS=1,2,3,4\nRESTRAINT ARG=t AT=0.0 KAPPA=1\n",
+      "t: TORSION ATOMS=2,3,4,5\nRESTRAINT ARG=t AT=0.0 KAPPA=1\n"
+    },"t"});
+
+  for(const auto & s : scenarios) {
+    std::vector<double> positionsDeltas,argumentsDeltas;
+    unsigned positionsCalls=run(s,rank,false,positionsDeltas);
+    unsigned argumentsCalls=run(s,rank,true,argumentsDeltas);
+    ofs<<s.name<<"\n";
+    for(unsigned i=0; i<positionsDeltas.size(); i++) {
+      char buffer[100];
+      std::snprintf(buffer,sizeof(buffer),"  step %u delta bias %.8f %.8f",i,positionsDeltas[i],argumentsDeltas[i]);
+      ofs<<buffer<<"\n";
+    }
+    ofs<<"  calculations of "<<s.cv<<" "<<positionsCalls<<" "<<argumentsCalls<<"\n";
+  }
+  ofs.close();
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include "plumed/lepton/Lepton.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace PLMD;
+
+// Compare lepton::CompiledExpression::evaluateBatch with the element by element evaluate
+int main() {
+  std::ofstream ofs("output");
+  std::vector<std::string> funcs= {"x+y*2-3/x","exp(-x^2)*sin(y)+cos(x*y)","step(x-0.5)+delta(y)",
+                                   "sqrt(abs(x))+atan2(y,x)","min(x,y)+max(x,2*y)","x","select(x-0.3,y,x^3)",
+                                   "1/(1+x^2)+erf(y)","tanh(x)+floor(3*y)-ceil(x)","sqrt(x*x+y*y+z)","(x-y)^2+3"
+                                  };
+  std::vector<std::string> names= {"x","y","z","w"};
+  const int n=11;
+  std::vector<std::vector<double>> columns(names.size(),std::vector<double>(n));
+  for(int i=0; i<n; i++) {
+    columns[0][i]=0.1*i-0.3;
+    columns[1][i]=(i%3==0)?0.0:0.7-0.13*i;
+    columns[2][i]=0.5*i;
+    columns[3][i]=1.0;
+  }
+  std::vector<const double*> values;
+  for(const auto & c : columns) values.push_back(c.data());
+  for(const auto & f : funcs) {
+    lepton::CompiledExpression expression=lepton::Parser::parse(f).optimize().createCompiledExpression();
+    expression.setBatchVariables(names);
+    std::vector<double> results(n);
+    ofs << f << std::endl;
+    for(int m : {0,1,2,5,n}) {
+      std::fill(results.begin(),results.end(),-999.0);
+      expression.evaluateBatch(m,values.data(),results.data());
+      unsigned mismatches=0;
+      for(int i=0; i<n; i++) {
+        double ref=-999.0;
+        if(i<m) {
+          for(const auto & v : expression.getVariables()) {
+            unsigned k=std::find(names.begin(),names.end(),v)-names.begin();
+            expression.getVariableReference(v)=columns[k][i];
+          }
+          ref=expression.evaluate();
+        }
+        if(!(ref==results[i] || (std::isnan(ref) && std::isnan(results[i])))) mismatches++;
+      }
+      ofs << "  n=" << m << " mismatches=" << mismatches;
+      if(m==n) {
+        char buffer[32];
+        std::snprintf(buffer,sizeof(buffer)," last=%.8g",results[n-1]);
+        ofs << buffer;
+      }
+      ofs << std::endl;
+    }
+  }
+  return 0;
+}
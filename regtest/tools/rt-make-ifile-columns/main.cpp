@@ -0,0 +1,71 @@
+#include "plumed/tools/File.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace PLMD;
+
+void writeFile(const char* name,const char* content,const char* mode="w") {
+  FILE* fp=std::fopen(name,mode);
+  std::fputs(content,fp);
+  std::fclose(fp);
+}
+
+int testColumns(std::ofstream &ofs) {
+  ofs << "testColumns" << std::endl;
+  writeFile("colvar",
+            "#! FIELDS time x y\n"
+            "#! SET min_x -pi\n"
+            "#! SET max_x pi\n"
+            " 0.0  1.5   2.5\n"
+            "\n"
+            "# a comment\n"
+            " 1.0  -1e-3 pi # trailing comment\r\n"
+            " 2.0  +3    .5\n"
+            "#! FIELDS time y\n"
+            " 3.0  7.25\n"
+            " 4.0  8.5\n");
+  IFile ifile;
+  ifile.open("colvar");
+  std::vector<std::vector<double>> columns;
+  std::vector<std::string> names= {"time","x","y","max_x"};
+  while(std::size_t nrows=ifile.scanColumns(names,columns,2)) {
+    ofs << "block of " << nrows << " rows" << std::endl;
+    for(std::size_t n=0; n<nrows; n++) {
+      for(unsigned i=0; i<names.size(); i++) ofs << " " << names[i] << "=" << columns[i][n];
+      ofs << std::endl;
+    }
+    std::vector<std::string> fields;
+    ifile.scanFieldList(fields);
+    if(ifile && !ifile.FieldExist("x")) names= {"time","y"};
+  }
+  return 0;
+}
+
+int testGrowingFile(std::ofstream &ofs) {
+  ofs << "testGrowingFile" << std::endl;
+  writeFile("hills","#! FIELDS time x\n 0.0 1.0\n 1.0 2");
+  IFile ifile;
+  ifile.open("hills");
+  double t,x;
+  while(ifile.scanField("time",t)) {
+    ifile.scanField("x",x).scanField();
+    ofs << " time=" << t << " x=" << x << std::endl;
+  }
+  ofs << "end of file" << std::endl;
+  writeFile("hills",".5\n 2.0 3.0\n","a");
+  ifile.reset(false);
+  while(ifile.scanField("time",t)) {
+    ifile.scanField("x",x).scanField();
+    ofs << " time=" << t << " x=" << x << std::endl;
+  }
+  ofs << "end of file" << std::endl;
+  return 0;
+}
+
+int main() {
+  std::ofstream ofs("output");
+  testColumns(ofs);
+  testGrowingFile(ofs);
+  return 0;
+}
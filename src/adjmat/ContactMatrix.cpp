@@ -23,6 +23,7 @@
 #include "core/ActionRegister.h"
 #include "tools/SwitchingFunction.h"
 #include "tools/Matrix.h"
+#include "tools/OpenMP.h"
 
 //+PLUMEDOC MATRIX CONTACT_MATRIX_PROPER
 /*
@@ -64,11 +65,24 @@ class ContactMatrix : public AdjacencyMatrixBase {
 private:
 /// switching function
   SwitchingFunction switchingFunction;
+/// The values of the switching function for all the elements of the row that is being computed.
+/// They are computed in a single batch when the first element of the row is requested and are
+/// indexed by atom. There is one of these for each thread, they are allocated in prepare() as the
+/// number of threads can change during the simulation.
+  struct RowCache {
+    std::vector<double> distance2, value, dfunc;
+    std::vector<double> batch_distance2, batch_value, batch_dfunc;
+  };
+  mutable std::vector<RowCache> rowcache;
+/// Compute the switching function for all the elements in the current row
+  void calculateRow( MultiValue& myvals, RowCache& cache ) const ;
 public:
 /// Create manual
   static void registerKeywords( Keywords& keys );
 /// Constructor
   explicit ContactMatrix(const ActionOptions&);
+/// Make sure there is a row cache for each thread
+  void prepare() override;
 /// This does nothing
   double calculateWeight( const Vector& pos1, const Vector& pos2, const unsigned& natoms, MultiValue& myvals ) const override;
 /// Override this so we write the graph properly
@@ -108,10 +122,42 @@ ContactMatrix::ContactMatrix( const ActionOptions& ao ):
   setLinkCellCutoff( true, switchingFunction.get_dmax() );
 }
 
+void ContactMatrix::prepare() {
+  AdjacencyMatrixBase::prepare();
+  if( rowcache.size()<OpenMP::getNumThreads() ) rowcache.resize( OpenMP::getNumThreads() );
+}
+
+void ContactMatrix::calculateRow( MultiValue& myvals, RowCache& cache ) const {
+  const std::vector<unsigned> & indices( myvals.getIndices() );
+  const std::vector<Vector> & atoms( myvals.getAtomVector() );
+  unsigned ntwo_atoms = myvals.getSplitIndex();
+  if( cache.distance2.size()<atoms.size() ) {
+    cache.distance2.resize( atoms.size(), -1.0 ); cache.value.resize( atoms.size() ); cache.dfunc.resize( atoms.size() );
+  }
+  if( cache.batch_distance2.size()<ntwo_atoms ) {
+    cache.batch_distance2.resize( ntwo_atoms ); cache.batch_value.resize( ntwo_atoms ); cache.batch_dfunc.resize( ntwo_atoms );
+  }
+  // Element 0 of indices is the central atom
+  if( ntwo_atoms<2 ) return;
+  for(unsigned i=1; i<ntwo_atoms; ++i) cache.batch_distance2[i-1] = atoms[ indices[i] ].modulo2();
+  switchingFunction.calculateSqr( cache.batch_distance2.data(), cache.batch_value.data(), cache.batch_dfunc.data(), ntwo_atoms-1 );
+  for(unsigned i=1; i<ntwo_atoms; ++i) {
+    cache.distance2[ indices[i] ] = cache.batch_distance2[i-1];
+    cache.value[ indices[i] ] = cache.batch_value[i-1];
+    cache.dfunc[ indices[i] ] = cache.batch_dfunc[i-1];
+  }
+}
+
 double ContactMatrix::calculateWeight( const Vector& pos1, const Vector& pos2, const unsigned& natoms, MultiValue& myvals ) const {
   Vector distance = pos2; double mod2 = distance.modulo2();
   if( mod2<epsilon ) return 0.0;  // Atoms can't be bonded to themselves
-  double dfunc, val = switchingFunction.calculateSqr( mod2, dfunc );
+  // The cached value is only used if it was computed from exactly the same distance
+  const unsigned t=OpenMP::getThreadNum(); plumed_assert( t<rowcache.size() );
+  RowCache & cache( rowcache[t] ); const unsigned col = myvals.getSecondTaskIndex();
+  if( col>=cache.distance2.size() || cache.distance2[col]!=mod2 ) calculateRow( myvals, cache );
+  double dfunc, val;
+  if( col<cache.distance2.size() && cache.distance2[col]==mod2 ) { val = cache.value[col]; dfunc = cache.dfunc[col]; }
+  else val = switchingFunction.calculateSqr( mod2, dfunc );
   if( val<epsilon ) return 0.0;
   if( doNotCalculateDerivatives() ) return val;
   addAtomDerivatives( 0, (-dfunc)*distance, myvals );
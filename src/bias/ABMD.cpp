@@ -89,6 +89,7 @@ class ABMD : public Bias {
 public:
   explicit ABMD(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
@@ -58,6 +58,8 @@ public:
   explicit Bias(const ActionOptions&ao);
   void apply() override;
   unsigned getNumberOfDerivatives() override;
+/// Biases are treated as history dependent unless they are a function of the current step only
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 inline
@@ -76,6 +76,7 @@ class BiasValue : public Bias {
 public:
   explicit BiasValue(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
 };
 
@@ -122,6 +122,7 @@ public:
   explicit ExtendedLagrangian(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
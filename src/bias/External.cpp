@@ -115,6 +115,7 @@ private:
 public:
   explicit External(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
 };
 
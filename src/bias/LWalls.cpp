@@ -80,6 +80,7 @@ class LWalls : public Bias {
 public:
   explicit LWalls(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
 };
 
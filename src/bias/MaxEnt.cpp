@@ -151,6 +151,7 @@ public:
   explicit MaxEnt(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   void update_lambda();
   static void registerKeywords(Keywords& keys);
   void ReadLagrangians(IFile &ifile);
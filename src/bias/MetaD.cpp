@@ -31,6 +31,8 @@
 #include "tools/Random.h"
 #include "tools/File.h"
 #include "tools/Communicator.h"
+#include "tools/CellHash.h"
+#include "tools/BinaryFieldsFile.h"
 #include <ctime>
 #include <numeric>
 
@@ -84,10 +86,16 @@ from the position they were at last neighbor list update. Gaussians are added to
 is within 6.*DP2CUTOFF*sigma*sigma. While the list is updated if the CVs are farther from the center than 0.5 of the
 standard deviation of the Gaussian center distribution of the list. These parameters (6 and 0.5) can be modified using
 NLIST_PARAMETERS. Note that the use of neighbor list does not provide the exact bias.
+The centers of the Gaussians are stored in a cell list in CV space, with cells sized from the width of the
+Gaussians, so that the cost of updating the neighbor list does not grow with the total number of Gaussians.
+NLIST cannot be combined with GRID.
 
 Metadynamics can be restarted either from a HILLS file as well as from a GRID, in this second
 case one can first save a GRID using GRID_WFILE (and GRID_WSTRIDE) and at a later stage read
 it using GRID_RFILE.
+With the flag GRID_BINARY the GRID_WFILE is written in a binary format, that is faster to write and to read for large grids
+and that keeps all the digits of the stored numbers. Binary files are automatically recognized when given as GRID_RFILE,
+and can be converted to and from the usual text format with \ref convert_fields.
 
 The work performed by the METAD bias can be calculated using CALC_WORK, note that this is expensive when not using grids.
 
@@ -386,6 +394,30 @@ private:
       }
     }
   };
+  /// Hills with a diagonal metric, stored as a structure of arrays.
+  /// Centers and inverse widths are stored one CV after the other, each
+  /// row padded to a multiple of simd_width, so that the bias and its
+  /// derivatives can be accumulated over many hills at once.
+  /// Multivariate hills do not fit this layout and are kept aside.
+  struct HillStore {
+    static constexpr std::size_t simd_width=8;
+    unsigned ncv;
+    std::size_t ndiag;
+    std::size_t stride;
+    std::vector<double> height;
+    std::vector<double> center;
+    std::vector<double> invsigma;
+    std::vector<Gaussian> multivariate;
+    explicit HillStore(unsigned n=0): ncv(n), ndiag(0), stride(0) {}
+    std::size_t size() const {
+      return ndiag+multivariate.size();
+    }
+    void clear() {
+      ndiag=0;
+      multivariate.clear();
+    }
+    void push_back(const Gaussian&);
+  };
   struct TemperingSpecs {
     bool is_active;
     std::string name_stem;
@@ -415,6 +447,7 @@ private:
   std::vector<double> sigma0max_;
   // Gaussians
   std::vector<Gaussian> hills_;
+  HillStore hill_store_;
   std::unique_ptr<FlexibleBin> flexbin_;
   int adaptive_;
   OFile hillsOfile_;
@@ -426,6 +459,8 @@ private:
   OFile gridfile_;
   bool storeOldGrids_;
   int wgridstride_;
+  bool binaryGrid_;
+  std::string binaryGridFileName_;
   // multiple walkers
   int mw_n_;
   std::string mw_dir_;
@@ -472,9 +507,15 @@ private:
   bool nlist_update_;
   unsigned nlist_steps_;
   std::array<double,2> nlist_param_;
-  std::vector<Gaussian> nlist_hills_;
+  HillStore nlist_hill_store_;
+  CellHash nlist_index_;
+  std::vector<double> nlist_extent_;
   std::vector<double> nlist_center_;
   std::vector<double> nlist_dev2_;
+  // periods of the arguments (zero if not periodic)
+  std::vector<double> period_;
+  // number of hills processed together by evaluateHillBlock
+  static constexpr std::size_t hill_block_=64;
 
   double stretchA=1.0;
   double stretchB=0.0;
@@ -500,6 +541,8 @@ private:
   double getBiasAndDerivatives(const std::vector<double>&, std::vector<double>&);
   double evaluateGaussian(const std::vector<double>&, const Gaussian&);
   double evaluateGaussianAndDerivatives(const std::vector<double>&, const Gaussian&,std::vector<double>&,std::vector<double>&);
+  double evaluateHillStore(const HillStore&, const std::vector<double>&, std::vector<double>*);
+  double evaluateHillBlock(const HillStore&, std::size_t, std::size_t, const std::vector<double>&, std::vector<double>&, std::vector<double>&, bool);
   double getGaussianNormalization(const Gaussian&);
   std::vector<unsigned> getGaussianSupport(const Gaussian&);
   bool   scanOneHill(IFile* ifile, std::vector<Value>& v, std::vector<double>& center, std::vector<double>& sigma, double& height, bool& multivariate);
@@ -507,11 +550,14 @@ private:
   double getTransitionBarrierBias();
   void   updateFrequencyAdaptiveStride();
   void   updateNlist();
+  std::vector<double> getHillExtent(const Gaussian&);
+  bool   isHillInNlist(const Gaussian&, const std::vector<double>&);
 
 public:
   explicit MetaD(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const override;
 };
@@ -555,11 +601,13 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.add("optional","GRID_BIN","the number of bins for the grid");
   keys.add("optional","GRID_SPACING","the approximate grid spacing (to be used as an alternative or together with GRID_BIN)");
   keys.addFlag("GRID_SPARSE",false,"use a sparse grid to store hills");
+  keys.addFlag("GRID_TILED",false,"use a sparse grid made of tiles of neighboring points, that are allocated when a hill is first added on them. This is usually faster than GRID_SPARSE");
   keys.addFlag("GRID_NOSPLINE",false,"don't use spline interpolation with grids");
   keys.add("optional","GRID_WSTRIDE","write the grid to a file every N steps");
   keys.add("optional","GRID_WFILE","the file on which to write the grid");
   keys.add("optional","GRID_RFILE","a grid file from which the bias should be read at the initial step of the simulation");
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
+  keys.addFlag("GRID_BINARY",false,"write the GRID_WFILE in binary format");
   keys.addFlag("NLIST",false,"Use neighbor list for kernels summation, faster but experimental");
   keys.add("optional", "NLIST_PARAMETERS","(default=6.,0.5) the two cutoff parameters for the Gaussians neighbor list");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or time step dimensions");
@@ -606,6 +654,7 @@ MetaD::MetaD(const ActionOptions& ao):
   adaptive_(FlexibleBin::none),
   grid_(false),
   wgridstride_(0),
+  binaryGrid_(false),
   mw_n_(1), mw_dir_(""), mw_id_(0), mw_rstride_(1),
   walkers_mpi_(false), mpi_nw_(0),
   flying_(false),
@@ -809,6 +858,12 @@ MetaD::MetaD(const ActionOptions& ao):
 
   bool sparsegrid=false;
   parseFlag("GRID_SPARSE",sparsegrid);
+  bool tiledgrid=false;
+  parseFlag("GRID_TILED",tiledgrid);
+  if(sparsegrid && tiledgrid) error("GRID_SPARSE and GRID_TILED cannot be combined");
+  GridBase::Storage gridstorage=GridBase::Storage::dense;
+  if(sparsegrid) gridstorage=GridBase::Storage::sparse;
+  if(tiledgrid) gridstorage=GridBase::Storage::tiled;
   bool nospline=false;
   parseFlag("GRID_NOSPLINE",nospline);
   bool spline=!nospline;
@@ -816,6 +871,11 @@ MetaD::MetaD(const ActionOptions& ao):
   std::string gridfilename_;
   parse("GRID_WFILE",gridfilename_);
   parseFlag("STORE_GRIDS",storeOldGrids_);
+  parseFlag("GRID_BINARY",binaryGrid_);
+  if(binaryGrid_) {
+    if(gridfilename_.length()==0) error("grid filename not specified use GRID_WFILE");
+    if(storeOldGrids_) error("STORE_GRIDS cannot be used with GRID_BINARY");
+  }
   if(grid_ && gridfilename_.length()>0) {
     if(wgridstride_==0 ) error("frequency with which to output grid not specified use GRID_WSTRIDE");
   }
@@ -833,6 +893,12 @@ MetaD::MetaD(const ActionOptions& ao):
   parseFlag("NLIST", nlist_);
   nlist_center_.resize(getNumberOfArguments());
   nlist_dev2_.resize(getNumberOfArguments());
+  hill_store_=HillStore(getNumberOfArguments());
+  nlist_hill_store_=HillStore(getNumberOfArguments());
+  period_.assign(getNumberOfArguments(),0.0);
+  for(unsigned i=0; i<getNumberOfArguments(); i++) {
+    if(getPntrToArgument(i)->isPeriodic()) period_[i]=getPntrToArgument(i)->getMaxMinusMin();
+  }
   if(nlist_&&grid_) error("NLIST and GRID cannot be combined!");
   std::vector<double> nlist_param;
   parseVector("NLIST_PARAMETERS",nlist_param);
@@ -1009,7 +1075,9 @@ MetaD::MetaD(const ActionOptions& ao):
     log.printf("\n");
     if(spline) {log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid) {log.printf("  Grid uses sparse grid\n");}
+    if(tiledgrid) {log.printf("  Grid uses tiled sparse grid\n");}
     if(wgridstride_>0) {log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);}
+    if(binaryGrid_) {log.printf("  Grid is written in binary format\n");}
   }
 
   if(mw_n_>1) {
@@ -1175,8 +1243,7 @@ MetaD::MetaD(const ActionOptions& ao):
         }
       }
       std::string funcl=getLabel() + ".bias";
-      if(!sparsegrid) {BiasGrid_=Tools::make_unique<Grid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
-      else {BiasGrid_=Tools::make_unique<SparseGrid>(funcl,getArguments(),gmin,gmax,gbin,spline,true);}
+      BiasGrid_=GridBase::create(funcl,getArguments(),gmin,gmax,gbin,gridstorage,spline,true);
       std::vector<std::string> actualmin=BiasGrid_->getMin();
       std::vector<std::string> actualmax=BiasGrid_->getMax();
       for(unsigned i=0; i<getNumberOfArguments(); i++) {
@@ -1197,13 +1264,18 @@ MetaD::MetaD(const ActionOptions& ao):
       }
       IFile gridfile;
       gridfile.link(*this);
-      if(gridfile.FileExist(gridreadfilename_)) {
-        gridfile.open(gridreadfilename_);
-      } else {
+      if(!gridfile.FileExist(gridreadfilename_)) {
         error("The GRID file you want to read: " + gridreadfilename_ + ", cannot be found!");
       }
       std::string funcl=getLabel() + ".bias";
-      BiasGrid_=GridBase::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, sparsegrid, spline, true);
+      if(BinaryFieldsFile::isBinary(gridfile.getPath())) {
+        BinaryFieldsFile bfile;
+        bfile.read(gridfile.getPath());
+        BiasGrid_=GridBase::create(funcl, getArguments(), bfile, gmin, gmax, gbin, gridstorage, spline, true);
+      } else {
+        gridfile.open(gridreadfilename_);
+        BiasGrid_=GridBase::create(funcl, getArguments(), gridfile, gmin, gmax, gbin, gridstorage, spline, true);
+      }
       if(BiasGrid_->getDimension()!=getNumberOfArguments()) error("mismatch between dimensionality of input grid and number of arguments");
       for(unsigned i=0; i<getNumberOfArguments(); ++i) {
         if( getPntrToArgument(i)->isPeriodic()!=BiasGrid_->getIsPeriodic()[i] ) error("periodicity mismatch between arguments and input bias");
@@ -1336,6 +1408,11 @@ MetaD::MetaD(const ActionOptions& ao):
     }
     if(mw_n_>1) gridfile_.enforceSuffix("");
     gridfile_.open(gridfilename_);
+    if(binaryGrid_) {
+      // the file is only opened to take care of backups and suffixes, and then replaced each time.
+      // it is left open since it is registered for flushing in PlumedMain
+      binaryGridFileName_=gridfile_.getPath();
+    }
   }
 
   // open hills file for writing
@@ -1539,7 +1616,51 @@ void MetaD::addGaussian(const Gaussian& hill)
         BiasGrid_->addValueAndDerivatives(ineigh,allbias[i],der);
       }
     }
-  } else hills_.push_back(hill);
+  } else {
+    hills_.push_back(hill);
+    hill_store_.push_back(hill);
+    if(nlist_) {
+      // cells are sized from the first hill, the largest extent is used in the queries
+      std::vector<double> extent=getHillExtent(hill);
+      if(!nlist_index_.enabled()) {
+        std::vector<double> cellsize(extent.size());
+        for(unsigned i=0; i<extent.size(); i++) cellsize[i]=std::sqrt(nlist_param_[0]*dp2cutoff)*extent[i];
+        nlist_index_.setup(cellsize,period_);
+        nlist_extent_=extent;
+      }
+      for(unsigned i=0; i<extent.size(); i++) nlist_extent_[i]=std::max(nlist_extent_[i],extent[i]);
+      nlist_index_.insert(hills_.size()-1,hill.center);
+    }
+  }
+}
+
+void MetaD::HillStore::push_back(const Gaussian& hill)
+{
+  if(hill.multivariate) {
+    multivariate.push_back(hill);
+    return;
+  }
+  if(ndiag==stride) {
+    // grow geometrically, keeping each row a multiple of simd_width long
+    std::size_t newstride=std::max(2*stride,simd_width);
+    newstride=((newstride+simd_width-1)/simd_width)*simd_width;
+    std::vector<double> newcenter(ncv*newstride,0.0);
+    std::vector<double> newinvsigma(ncv*newstride,0.0);
+    for(unsigned i=0; i<ncv; i++) {
+      std::copy(center.begin()+i*stride,center.begin()+i*stride+ndiag,newcenter.begin()+i*newstride);
+      std::copy(invsigma.begin()+i*stride,invsigma.begin()+i*stride+ndiag,newinvsigma.begin()+i*newstride);
+    }
+    center.swap(newcenter);
+    invsigma.swap(newinvsigma);
+    height.resize(newstride,0.0);
+    stride=newstride;
+  }
+  height[ndiag]=hill.height;
+  for(unsigned i=0; i<ncv; i++) {
+    center[i*stride+ndiag]=hill.center[i];
+    invsigma[i*stride+ndiag]=hill.invsigma[i];
+  }
+  ndiag++;
 }
 
 std::vector<unsigned> MetaD::getGaussianSupport(const Gaussian& hill)
@@ -1601,23 +1722,8 @@ double MetaD::getBias(const std::vector<double>& cv)
   double bias=0.0;
   if(grid_) bias = BiasGrid_->getValue(cv);
   else {
-    unsigned nt=OpenMP::getNumThreads();
-    unsigned stride=comm.Get_size();
-    unsigned rank=comm.Get_rank();
-
-    if(!nlist_) {
-      #pragma omp parallel num_threads(nt)
-      {
-        #pragma omp for reduction(+:bias) nowait
-        for(unsigned i=rank; i<hills_.size(); i+=stride) bias+=evaluateGaussian(cv,hills_[i]);
-      }
-    } else {
-      #pragma omp parallel num_threads(nt)
-      {
-        #pragma omp for reduction(+:bias) nowait
-        for(unsigned i=rank; i<nlist_hills_.size(); i+=stride) bias+=evaluateGaussian(cv,nlist_hills_[i]);
-      }
-    }
+    if(!nlist_) bias=evaluateHillStore(hill_store_,cv,NULL);
+    else bias=evaluateHillStore(nlist_hill_store_,cv,NULL);
     comm.Sum(bias);
   }
 
@@ -1633,55 +1739,119 @@ double MetaD::getBiasAndDerivatives(const std::vector<double>& cv, std::vector<d
     bias=BiasGrid_->getValueAndDerivatives(cv,vder);
     for(unsigned i=0; i<ncv; i++) der[i]=vder[i];
   } else {
-    unsigned nt=OpenMP::getNumThreads();
-    unsigned stride=comm.Get_size();
-    unsigned rank=comm.Get_rank();
-
-    if(!nlist_) {
-      if(hills_.size()<2*nt*stride||nt==1) {
-        // for performance reasons and thread safety
-        std::vector<double> dp(ncv);
-        for(unsigned i=rank; i<hills_.size(); i+=stride) {
-          bias+=evaluateGaussianAndDerivatives(cv,hills_[i],der,dp);
-        }
-      } else {
-        #pragma omp parallel num_threads(nt)
-        {
-          std::vector<double> omp_deriv(ncv,0.);
-          // for performance reasons and thread safety
-          std::vector<double> dp(ncv);
-          #pragma omp for reduction(+:bias) nowait
-          for(unsigned i=rank; i<hills_.size(); i+=stride) {
-            bias+=evaluateGaussianAndDerivatives(cv,hills_[i],omp_deriv,dp);
-          }
-          #pragma omp critical
-          for(unsigned i=0; i<ncv; i++) der[i]+=omp_deriv[i];
-        }
+    if(!nlist_) bias=evaluateHillStore(hill_store_,cv,&der);
+    else bias=evaluateHillStore(nlist_hill_store_,cv,&der);
+    comm.Sum(bias);
+    comm.Sum(der);
+  }
+
+  return bias;
+}
+
+double MetaD::evaluateHillStore(const HillStore& store, const std::vector<double>& cv, std::vector<double>* der)
+{
+  unsigned ncv=cv.size();
+
+  // with INTERVAL the cv is replaced by the closest limit and,
+  // out of the interval, the bias does not produce forces
+  std::vector<double> xx(cv);
+  bool int_der=false;
+  if(doInt_) {
+    plumed_assert(ncv==1);
+    if(cv[0]<lowI_) {xx[0]=lowI_; int_der=true;}
+    if(cv[0]>uppI_) {xx[0]=uppI_; int_der=true;}
+  }
+
+  unsigned stride=comm.Get_size();
+  unsigned rank=comm.Get_rank();
+
+  // diagonal hills are processed in blocks, contiguous blocks go to the same rank
+  std::size_t nblocks=(store.ndiag+hill_block_-1)/hill_block_;
+  std::size_t first=(nblocks*rank)/stride;
+  std::size_t last=(nblocks*(rank+1))/stride;
+  unsigned nt=OpenMP::getNumThreads();
+  if(store.ndiag<2*nt*stride*hill_block_) nt=1;
+
+  double bias=0.0;
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<double> omp_deriv(ncv,0.);
+    // for performance reasons and thread safety
+    std::vector<double> work((ncv+2)*hill_block_);
+    #pragma omp for reduction(+:bias) nowait
+    for(std::size_t b=first; b<last; b++) {
+      bias+=evaluateHillBlock(store,b*hill_block_,std::min((b+1)*hill_block_,store.ndiag),xx,omp_deriv,work,der && !int_der);
+    }
+    if(der) {
+      #pragma omp critical
+      for(unsigned i=0; i<ncv; i++) (*der)[i]+=omp_deriv[i];
+    }
+  }
+
+  // multivariate hills are evaluated one by one
+  if(store.multivariate.size()>0) {
+    std::vector<double> dp(ncv);
+    for(unsigned k=rank; k<store.multivariate.size(); k+=stride) {
+      if(der) bias+=evaluateGaussianAndDerivatives(cv,store.multivariate[k],*der,dp);
+      else bias+=evaluateGaussian(cv,store.multivariate[k]);
+    }
+  }
+
+  return bias;
+}
+
+double MetaD::evaluateHillBlock(const HillStore& store, std::size_t begin, std::size_t end, const std::vector<double>& cv, std::vector<double>& der, std::vector<double>& work, bool do_der)
+{
+  const unsigned ncv=store.ncv;
+  const std::size_t n=end-begin;
+  // work is split in the squared distances, the weights and the scaled distances along each cv
+  double* dp2=work.data();
+  double* weight=dp2+hill_block_;
+  double* dp=weight+hill_block_;
+  const double* height=store.height.data()+begin;
+
+  #pragma omp simd
+  for(std::size_t k=0; k<n; k++) dp2[k]=0.0;
+  for(unsigned i=0; i<ncv; i++) {
+    const double* center=store.center.data()+i*store.stride+begin;
+    const double* invsigma=store.invsigma.data()+i*store.stride+begin;
+    double* dpi=dp+i*hill_block_;
+    const double x=cv[i];
+    if(period_[i]>0.0) {
+      const double period=period_[i];
+      const double invperiod=1.0/period;
+      #pragma omp simd
+      for(std::size_t k=0; k<n; k++) {
+        dpi[k]=Tools::pbc((x-center[k])*invperiod)*period*invsigma[k];
+        dp2[k]+=dpi[k]*dpi[k];
       }
     } else {
-      if(hills_.size()<2*nt*stride||nt==1) {
-        // for performance reasons and thread safety
-        std::vector<double> dp(ncv);
-        for(unsigned i=rank; i<nlist_hills_.size(); i+=stride) {
-          bias+=evaluateGaussianAndDerivatives(cv,nlist_hills_[i],der,dp);
-        }
-      } else {
-        #pragma omp parallel num_threads(nt)
-        {
-          std::vector<double> omp_deriv(ncv,0.);
-          // for performance reasons and thread safety
-          std::vector<double> dp(ncv);
-          #pragma omp for reduction(+:bias) nowait
-          for(unsigned i=rank; i<nlist_hills_.size(); i+=stride) {
-            bias+=evaluateGaussianAndDerivatives(cv,nlist_hills_[i],omp_deriv,dp);
-          }
-          #pragma omp critical
-          for(unsigned i=0; i<ncv; i++) der[i]+=omp_deriv[i];
-        }
+      #pragma omp simd
+      for(std::size_t k=0; k<n; k++) {
+        dpi[k]=(x-center[k])*invsigma[k];
+        dp2[k]+=dpi[k]*dpi[k];
       }
     }
-    comm.Sum(bias);
-    comm.Sum(der);
+  }
+
+  double bias=0.0;
+  #pragma omp simd reduction(+:bias)
+  for(std::size_t k=0; k<n; k++) {
+    const double arg=0.5*dp2[k];
+    const double g=(arg<dp2cutoff ? height[k]*std::exp(-arg) : 0.0);
+    weight[k]=stretchA*g;
+    bias+=(arg<dp2cutoff ? stretchA*g+height[k]*stretchB : 0.0);
+  }
+
+  if(do_der) {
+    for(unsigned i=0; i<ncv; i++) {
+      const double* invsigma=store.invsigma.data()+i*store.stride+begin;
+      const double* dpi=dp+i*hill_block_;
+      double d=0.0;
+      #pragma omp simd reduction(+:d)
+      for(std::size_t k=0; k<n; k++) d+=weight[k]*dpi[k]*invsigma[k];
+      der[i]-=d;
+    }
   }
 
   return bias;
@@ -1983,6 +2153,8 @@ void MetaD::update()
       // Flying Gaussian
       if (flying_) {
         hills_.clear();
+        hill_store_.clear();
+        nlist_index_.clear();
         comm.Barrier();
       }
 
@@ -2019,7 +2191,15 @@ void MetaD::update()
   }
 
   // dump grid on file
-  if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())) {
+  if(binaryGrid_&&(getStep()%wgridstride_==0||getCPT())) {
+    int r = 0;
+    if(walkers_mpi_ && comm.Get_rank()==0) r=multi_sim_comm.Get_rank();
+    if(comm.Get_rank()==0 && r==0) {
+      BinaryFieldsFile bfile;
+      BiasGrid_->writeToBinaryFile(bfile);
+      bfile.write(binaryGridFileName_);
+    }
+  } else if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())) {
     // in case old grids are stored, a sequence of grids should appear
     // this call results in a repetition of the header:
     if(storeOldGrids_) gridfile_.clearFields();
@@ -2252,53 +2432,89 @@ void MetaD::updateNlist()
   // no need to check for neighbors
   if(hills_.size()==0) return;
 
+  const unsigned ncv=getNumberOfArguments();
+  std::vector<double> cv(ncv);
+  for(unsigned i=0; i<ncv; i++) cv[i]=getArgument(i);
+
+  // candidates are taken from the cells that can contain hills within the cutoff
+  std::vector<double> range(ncv);
+  for(unsigned i=0; i<ncv; i++) range[i]=std::sqrt(nlist_param_[0]*dp2cutoff)*nlist_extent_[i];
+  std::vector<unsigned> candidates;
+  nlist_index_.query(cv,range,candidates);
+  // keep the hills in the order in which they have been added
+  std::sort(candidates.begin(),candidates.end());
+
   // here we generate the neighbor list
-  nlist_hills_.clear();
-  std::vector<Gaussian> local_flat_nl;
-  unsigned nt=OpenMP::getNumThreads();
-  if(hills_.size()<2*nt) nt=1;
-  #pragma omp parallel num_threads(nt)
-  {
-    std::vector<Gaussian> private_flat_nl;
-    #pragma omp for nowait
-    for(unsigned k=0; k<hills_.size(); k++)
-    {
-      double dist2=0;
-      for(unsigned i=0; i<getNumberOfArguments(); i++)
-      {
-        const double d=difference(i,getArgument(i),hills_[k].center[i])/hills_[k].sigma[i];
-        dist2+=d*d;
-      }
-      if(dist2<=nlist_param_[0]*dp2cutoff) private_flat_nl.push_back(hills_[k]);
+  nlist_hill_store_.clear();
+  std::vector<double> dev2(ncv,0.0);
+  for(const auto & k : candidates) {
+    if(!isHillInNlist(hills_[k],cv)) continue;
+    nlist_hill_store_.push_back(hills_[k]);
+    for(unsigned i=0; i<ncv; i++) {
+      const double d=difference(i,cv[i],hills_[k].center[i]);
+      dev2[i]+=d*d;
     }
-    #pragma omp critical
-    local_flat_nl.insert(local_flat_nl.end(), private_flat_nl.begin(), private_flat_nl.end());
   }
-  nlist_hills_ = local_flat_nl;
 
   // here we set some properties that are used to decide when to update it again
-  for(unsigned i=0; i<getNumberOfArguments(); i++) nlist_center_[i]=getArgument(i);
-  std::vector<double> dev2;
-  dev2.resize(getNumberOfArguments(),0);
-  for(unsigned k=0; k<nlist_hills_.size(); k++)
-  {
-    for(unsigned i=0; i<getNumberOfArguments(); i++)
-    {
-      const double d=difference(i,getArgument(i),nlist_hills_[k].center[i]);
-      dev2[i]+=d*d;
-    }
-  }
-  for(unsigned i=0; i<getNumberOfArguments(); i++) {
-    if(dev2[i]>0.) nlist_dev2_[i]=dev2[i]/static_cast<double>(nlist_hills_.size());
+  for(unsigned i=0; i<ncv; i++) nlist_center_[i]=cv[i];
+  for(unsigned i=0; i<ncv; i++) {
+    if(dev2[i]>0.) nlist_dev2_[i]=dev2[i]/static_cast<double>(nlist_hill_store_.size());
     else nlist_dev2_[i]=hills_.back().sigma[i]*hills_.back().sigma[i];
   }
 
   // we are done
-  getPntrToComponent("nlker")->set(nlist_hills_.size());
+  getPntrToComponent("nlker")->set(nlist_hill_store_.size());
   getPntrToComponent("nlsteps")->set(nlist_steps_);
   nlist_steps_=0;
   nlist_update_=false;
 }
 
+std::vector<double> MetaD::getHillExtent(const Gaussian& hill)
+{
+  const unsigned ncv=getNumberOfArguments();
+  std::vector<double> extent(ncv);
+  if(hill.multivariate) {
+    // the marginal standard deviations are the square roots of the diagonal of the covariance
+    unsigned k=0;
+    Matrix<double> mymatrix(ncv,ncv);
+    for(unsigned i=0; i<ncv; i++) {
+      for(unsigned j=i; j<ncv; j++) {
+        mymatrix(i,j)=mymatrix(j,i)=hill.sigma[k];
+        k++;
+      }
+    }
+    Matrix<double> myinv(ncv,ncv);
+    Invert(mymatrix,myinv);
+    for(unsigned i=0; i<ncv; i++) extent[i]=std::sqrt(std::abs(myinv(i,i)));
+  } else {
+    for(unsigned i=0; i<ncv; i++) extent[i]=std::abs(hill.sigma[i]);
+  }
+  return extent;
+}
+
+bool MetaD::isHillInNlist(const Gaussian& hill, const std::vector<double>& cv)
+{
+  const unsigned ncv=getNumberOfArguments();
+  double dist2=0;
+  if(hill.multivariate) {
+    unsigned k=0;
+    for(unsigned i=0; i<ncv; i++) {
+      const double d_i=difference(i,cv[i],hill.center[i]);
+      for(unsigned j=i; j<ncv; j++) {
+        if(i==j) dist2+=d_i*d_i*hill.sigma[k];
+        else dist2+=2.0*d_i*difference(j,cv[j],hill.center[j])*hill.sigma[k];
+        k++;
+      }
+    }
+  } else {
+    for(unsigned i=0; i<ncv; i++) {
+      const double d=difference(i,cv[i],hill.center[i])/hill.sigma[i];
+      dist2+=d*d;
+    }
+  }
+  return dist2<=nlist_param_[0]*dp2cutoff;
+}
+
 }
 }
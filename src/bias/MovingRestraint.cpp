@@ -117,6 +117,7 @@ class MovingRestraint : public Bias {
 public:
   explicit MovingRestraint(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords( Keywords& keys );
 };
 
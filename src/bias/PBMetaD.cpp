@@ -322,6 +322,7 @@ public:
   explicit PBMetaD(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const override;
 };
@@ -344,6 +345,7 @@ void PBMetaD::registerKeywords(Keywords& keys) {
   keys.add("optional","GRID_BIN","the number of bins for the grid");
   keys.add("optional","GRID_SPACING","the approximate grid spacing (to be used as an alternative or together with GRID_BIN)");
   keys.addFlag("GRID_SPARSE",false,"use a sparse grid to store hills");
+  keys.addFlag("GRID_TILED",false,"use a sparse grid made of tiles of neighboring points, that are allocated when a hill is first added on them. This is usually faster than GRID_SPARSE");
   keys.addFlag("GRID_NOSPLINE",false,"don't use spline interpolation with grids");
   keys.add("optional","GRID_WSTRIDE", "frequency for dumping the grid");
   keys.add("optional","GRID_WFILES", "dump grid for the bias, default names are used if GRID_WSTRIDE is used without GRID_WFILES.");
@@ -610,6 +612,12 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
 
   bool sparsegrid=false;
   parseFlag("GRID_SPARSE",sparsegrid);
+  bool tiledgrid=false;
+  parseFlag("GRID_TILED",tiledgrid);
+  if(sparsegrid && tiledgrid) error("GRID_SPARSE and GRID_TILED cannot be combined");
+  GridBase::Storage gridstorage=GridBase::Storage::dense;
+  if(sparsegrid) gridstorage=GridBase::Storage::sparse;
+  if(tiledgrid) gridstorage=GridBase::Storage::tiled;
   bool nospline=false;
   parseFlag("GRID_NOSPLINE",nospline);
   bool spline=!nospline;
@@ -695,6 +703,7 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
     log.printf("\n");
     if(spline) {log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid) {log.printf("  Grid uses sparse grid\n");}
+    if(tiledgrid) {log.printf("  Grid uses tiled sparse grid\n");}
     if(wgridstride_>0) {
       for(unsigned i=0; i<gridfilenames_.size(); ++i) {
         log.printf("  Grid is written on file %s with stride %d\n",gridfilenames_[i].c_str(),wgridstride_);
@@ -749,7 +758,7 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
           error("The GRID file you want to read: " + gridreadfilenames_[i] + ", cannot be found!");
         }
         std::string funcl = getLabel() + ".bias";
-        BiasGrid_=GridBase::create(funcl, args, gridfile, gmin_t, gmax_t, gbin_t, sparsegrid, spline, true);
+        BiasGrid_=GridBase::create(funcl, args, gridfile, gmin_t, gmax_t, gbin_t, gridstorage, spline, true);
         if(BiasGrid_->getDimension() != args.size()) {
           error("mismatch between dimensionality of input grid and number of arguments");
         }
@@ -759,8 +768,7 @@ PBMetaD::PBMetaD(const ActionOptions& ao):
         log.printf("  Restarting from %s:\n",gridreadfilenames_[i].c_str());
         if(getRestart()) restartedFromGrid=true;
       } else {
-        if(!sparsegrid) {BiasGrid_=Tools::make_unique<Grid>(funcl,args,gmin_t,gmax_t,gbin_t,spline,true);}
-        else           {BiasGrid_=Tools::make_unique<SparseGrid>(funcl,args,gmin_t,gmax_t,gbin_t,spline,true);}
+        BiasGrid_=GridBase::create(funcl,args,gmin_t,gmax_t,gbin_t,gridstorage,spline,true);
         std::vector<std::string> actualmin=BiasGrid_->getMin();
         std::vector<std::string> actualmax=BiasGrid_->getMax();
         std::string is;
@@ -73,6 +73,7 @@ class Restraint : public Bias {
 public:
   explicit Restraint(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
 };
 
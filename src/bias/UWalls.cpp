@@ -79,6 +79,7 @@ class UWalls : public Bias {
 public:
   explicit UWalls(const ActionOptions&);
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
 };
 
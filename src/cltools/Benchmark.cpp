@@ -41,6 +41,9 @@
 #include <algorithm>
 #include <chrono>
 #include <string_view>
+#include <array>
+#include <cmath>
+#include <sstream>
 
 namespace PLMD {
 namespace cltools {
@@ -156,6 +159,35 @@ instances will be done, showing the ratio between the total time and the time me
 instance, which will act as a reference. Errors will be estimated with bootstrapping. The warm-up phase will be discarded for
 this analysis.
 
+\par Reports
+
+A machine-readable summary of the run can be written with `--report`. The report is in JSON format
+if the file name ends with `.json` and in CSV format otherwise. For each kernel and input it contains
+the time spent in the initialization and in the first step, and statistics (mean, standard deviation, minimum,
+median, 90th and 99th percentiles, maximum) of the time per step spent in sharing the data with PLUMED (`prepare`),
+in the calculation (`perform`) and in their sum (`total`).
+If the kernel provides the per-action counters (see \ref DEBUG `TIMING_REPORT`), the same statistics are reported for the time
+spent by each action in `calculate`, `apply` and `update`, the samples being the steps in which the action was run.
+In the CSV format, the `action` column is empty for the statistics of the whole step.
+All times are in nanoseconds and the warm-up phase is discarded.
+
+\verbatim
+plumed-runtime benchmark --kernel /path/to/lib/libplumedKernel.so:this --report report.json
+\endverbatim
+
+\par Regression checks
+
+When multiple kernels or inputs are compared, `--slowdown-threshold` can be used to flag the instances
+that are slower than the first one. An instance is flagged if its comparative timing, minus twice its
+bootstrap error, is larger than one plus the threshold. In this case a message is written in the output,
+the instance is marked in the report and `plumed benchmark` exits with a non-zero status,
+so that it can be used to check new builds in a script. For instance, the following command fails if
+the current version is more than 5% slower than the reference one:
+
+\verbatim
+plumed-runtime benchmark --kernel /path/to/reference/libplumedKernel.so:this --slowdown-threshold 0.05
+\endverbatim
+
 */
 //+ENDPLUMEDOC
 
@@ -206,8 +238,17 @@ struct KernelBase {
   PlumedHandle handle;
   Stopwatch stopwatch;
   std::vector<long long int> timings;
+  std::vector<long long int> prepare_timings;
+  std::vector<long long int> perform_timings;
+/// True if the kernel provides per-action counters
+  bool actionCounters=false;
+/// Labels of the actions, in the order in which they appear in the timing report
+  std::vector<std::string> action_labels;
+/// Time per step spent by each action in calculate, apply and update
+  std::vector<std::array<std::vector<long long int>,3>> action_timings;
   double comparative_timing=-1.0;
   double comparative_timing_error=-1.0;
+  bool slowdown=false;
   KernelBase(const std::string & path_,const std::string & plumed_dat_, Log* log_):
     path(path_),
     plumed_dat(plumed_dat_),
@@ -259,8 +300,177 @@ struct Kernel :
     }
     return *this;
   }
+
+/// Read the per-action counters of the last step and reset them
+  void collectActionTimings(bool store) {
+    int size=0;
+    handle.cmd("getTimingReportSize",&size);
+    std::vector<char> report(size);
+    handle.cmd("getTimingReport",report.data());
+    handle.cmd("resetActionCounters",nullptr);
+    if(!store) return;
+    std::istringstream iss(report.data());
+    std::string line;
+    while(std::getline(iss,line)) {
+      if(line.empty() || line[0]=='#') continue;
+      std::istringstream words(line);
+      std::string label;
+      unsigned long long calls,tasks,atoms,derivatives;
+      long long int calculate,apply,update=0;
+      if(!(words>>label>>calls>>calculate>>apply>>tasks>>atoms>>derivatives)) continue;
+      // update_ns is missing in the reports of older kernels
+      words>>update;
+      auto it=std::find(action_labels.begin(),action_labels.end(),label);
+      std::size_t i=it-action_labels.begin();
+      if(it==action_labels.end()) {
+        action_labels.push_back(label);
+        action_timings.emplace_back();
+      }
+      action_timings[i][0].push_back(calculate);
+      action_timings[i][1].push_back(apply);
+      action_timings[i][2].push_back(update);
+    }
+  }
+};
+
+/// Statistics of the timings of a phase of the calculation
+struct TimingStatistics {
+  std::size_t samples=0;
+  double mean=0.0;
+  double stddev=0.0;
+  long long int min=0;
+  long long int p50=0;
+  long long int p90=0;
+  long long int p99=0;
+  long long int max=0;
+  explicit TimingStatistics(std::vector<long long int> t) {
+    samples=t.size();
+    if(samples==0) return;
+    std::sort(t.begin(),t.end());
+    double sum=0.0;
+    double sum2=0.0;
+    for(auto x : t) {
+      sum+=x;
+      sum2+=double(x)*double(x);
+    }
+    mean=sum/samples;
+    stddev=std::sqrt(std::max(0.0,sum2/samples-mean*mean));
+    // nearest-rank percentiles
+    auto percentile=[&](double p) {
+      std::size_t rank=std::ceil(p/100.0*samples);
+      if(rank>0) rank--;
+      return t[std::min(rank,samples-1)];
+    };
+    min=t.front();
+    p50=percentile(50);
+    p90=percentile(90);
+    p99=percentile(99);
+    max=t.back();
+  }
 };
 
+/// Escape a string so that it can be written in a JSON file
+std::string jsonEscape(const std::string & str) {
+  std::string escaped;
+  for(auto c : str) {
+    if(c=='"' || c=='\\') escaped+='\\';
+    escaped+=c;
+  }
+  return escaped;
+}
+
+/// Quote a string so that it can be written as a field of a CSV file
+std::string csvQuote(const std::string & str) {
+  std::string quoted="\"";
+  for(auto c : str) {
+    if(c=='"') quoted+='"';
+    quoted+=c;
+  }
+  return quoted+"\"";
+}
+
+/// Write timing statistics as a JSON object
+void writeJsonStatistics(std::ofstream & ofs,const TimingStatistics & stats) {
+  ofs<<"{"
+     <<"\"samples\": "<<stats.samples
+     <<", \"mean_ns\": "<<stats.mean
+     <<", \"stddev_ns\": "<<stats.stddev
+     <<", \"min_ns\": "<<stats.min
+     <<", \"p50_ns\": "<<stats.p50
+     <<", \"p90_ns\": "<<stats.p90
+     <<", \"p99_ns\": "<<stats.p99
+     <<", \"max_ns\": "<<stats.max<<"}";
+}
+
+/// Write timing statistics as a line of a CSV file
+void writeCsvStatistics(std::ofstream & ofs,const Kernel & k,const std::string & action,const std::string & phase,const TimingStatistics & stats) {
+  ofs<<csvQuote(k.path)<<","<<csvQuote(k.plumed_dat)<<","<<csvQuote(action)<<","<<phase<<","
+     <<stats.samples<<","<<stats.mean<<","<<stats.stddev<<","
+     <<stats.min<<","<<stats.p50<<","<<stats.p90<<","<<stats.p99<<","<<stats.max<<","
+     <<k.comparative_timing<<","<<k.comparative_timing_error<<","<<(k.slowdown?1:0)<<"\n";
+}
+
+/// Write the report of the kernels (listed in reverse order) in JSON or CSV format
+void writeReport(const std::string & filename,std::vector<Kernel> & kernels,unsigned natoms) {
+  std::ofstream ofs(filename);
+  if(!ofs) plumed_error()<<"cannot open file "<<filename<<" for writing the report";
+  const bool json=filename.size()>=5 && filename.compare(filename.size()-5,5,".json")==0;
+  const std::array<std::string,3> phases{"prepare","perform","total"};
+  const std::array<std::string,3> action_phases{"calculate","apply","update"};
+  if(json) {
+    ofs<<"{\n";
+    ofs<<"  \"natoms\": "<<natoms<<",\n";
+    ofs<<"  \"kernels\": [\n";
+  } else {
+    ofs<<"kernel,input,action,phase,samples,mean_ns,stddev_ns,min_ns,p50_ns,p90_ns,p99_ns,max_ns,comparative,comparative_error,slowdown\n";
+  }
+  for(auto it = kernels.rbegin(); it != kernels.rend(); ++it) {
+    auto & k(*it);
+    const std::array<TimingStatistics,3> stats{
+      TimingStatistics(k.prepare_timings),
+      TimingStatistics(k.perform_timings),
+      TimingStatistics(k.timings)
+    };
+    if(json) {
+      ofs<<"    {\n";
+      ofs<<"      \"kernel\": \""<<jsonEscape(k.path)<<"\",\n";
+      ofs<<"      \"input\": \""<<jsonEscape(k.plumed_dat)<<"\",\n";
+      ofs<<"      \"initialization_ns\": "<<k.stopwatch.getTotal("A Initialization")<<",\n";
+      ofs<<"      \"first_step_ns\": "<<k.stopwatch.getTotal("B0 First step")<<",\n";
+      ofs<<"      \"comparative\": "<<k.comparative_timing<<",\n";
+      ofs<<"      \"comparative_error\": "<<k.comparative_timing_error<<",\n";
+      ofs<<"      \"slowdown\": "<<(k.slowdown?"true":"false")<<",\n";
+      ofs<<"      \"phases\": {\n";
+      for(unsigned i=0; i<phases.size(); i++) {
+        ofs<<"        \""<<phases[i]<<"\": ";
+        writeJsonStatistics(ofs,stats[i]);
+        ofs<<(i+1<phases.size()?",":"")<<"\n";
+      }
+      ofs<<"      },\n";
+      ofs<<"      \"actions\": [\n";
+      for(unsigned a=0; a<k.action_labels.size(); a++) {
+        ofs<<"        {\"label\": \""<<jsonEscape(k.action_labels[a])<<"\"";
+        for(unsigned i=0; i<action_phases.size(); i++) {
+          ofs<<", \""<<action_phases[i]<<"\": ";
+          writeJsonStatistics(ofs,TimingStatistics(k.action_timings[a][i]));
+        }
+        ofs<<"}"<<(a+1<k.action_labels.size()?",":"")<<"\n";
+      }
+      ofs<<"      ]\n";
+      ofs<<"    }"<<(std::next(it)!=kernels.rend()?",":"")<<"\n";
+    } else {
+      for(unsigned i=0; i<phases.size(); i++) writeCsvStatistics(ofs,k,"",phases[i],stats[i]);
+      for(unsigned a=0; a<k.action_labels.size(); a++) {
+        for(unsigned i=0; i<action_phases.size(); i++) writeCsvStatistics(ofs,k,k.action_labels[a],action_phases[i],TimingStatistics(k.action_timings[a][i]));
+      }
+    }
+  }
+  if(json) {
+    ofs<<"  ]\n";
+    ofs<<"}\n";
+  }
+}
+
 namespace  {
 
 class UniformSphericalVector {
@@ -454,6 +664,8 @@ void Benchmark::registerKeywords( Keywords& keys ) {
   keys.add("compulsory","--atom-distribution","line","the kind of possible atomic displacement at each step");
   keys.addFlag("--domain-decomposition",false,"simulate domain decomposition, implies --shuffle");
   keys.addFlag("--shuffled",false,"reshuffle atoms");
+  keys.add("optional","--report","write a report with the timings of each kernel on this file, in JSON format if the name ends with .json and in CSV format otherwise");
+  keys.add("compulsory","--slowdown-threshold","-1","flag the kernels that are slower than the first one by more than this fraction, with a significance of two standard errors, and exit with a non-zero status (-1 means no check)");
 }
 
 Benchmark::Benchmark(const CLToolOptions& co ):
@@ -487,9 +699,19 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
   log <<"Welcome to PLUMED benchmark\n";
   std::vector<Kernel> kernels;
 
+  std::string reportFile;
+  if(parse("--report",reportFile)) log << "Using --report=" << reportFile << "\n";
+  double slowdownThreshold;
+  parse("--slowdown-threshold",slowdownThreshold);
+  if(slowdownThreshold>=0.0) log << "Using --slowdown-threshold=" << slowdownThreshold << "\n";
+  bool slowdownFound=false;
+  unsigned natoms;
+  parse("--natoms",natoms);
+  const bool writesReport=pc.Get_rank()==0 && !reportFile.empty();
+
   // perform comparative analysis
   // ensure that kernels vector is destroyed from last to first element upon exit
-  auto kernels_deleter=[&log](auto f) {
+  auto kernels_deleter=[&log,&reportFile,slowdownThreshold,&slowdownFound,natoms,writesReport](auto f) {
     if(!f) {
       return;
     }
@@ -569,6 +791,12 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
             //B are the bootstrap iterations
             it->comparative_timing=sum/B;
             it->comparative_timing_error=std::sqrt(sum2/B-sum*sum/(B*B));
+            if(slowdownThreshold>=0.0 && it->comparative_timing-2.0*it->comparative_timing_error>1.0+slowdownThreshold) {
+              it->slowdown=true;
+              slowdownFound=true;
+              log.printf("SLOWDOWN: kernel %s with input %s is %.3f +- %.3f times slower than the reference\n",
+                         it->path.c_str(),it->plumed_dat.c_str(),it->comparative_timing,it->comparative_timing_error);
+            }
           }
         }
 
@@ -576,6 +804,13 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
         log<<"Unexpected error during comparative analysis\n";
         log<<e.what()<<"\n";
       }
+    if(writesReport) try {
+        writeReport(reportFile,*f,natoms);
+        log<<"Report written on "<<reportFile<<"\n";
+      } catch(std::exception & e) {
+        log<<"Unexpected error while writing the report\n";
+        log<<e.what()<<"\n";
+      }
     while(!f->empty()) f->pop_back();
 
   };
@@ -634,7 +869,6 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
     log << "Using --shuffled\n";
   int nf; parse("--nsteps",nf);
   log << "Using --nsteps=" << nf << "\n";
-  unsigned natoms; parse("--natoms",natoms);
   log << "Using --natoms=" << natoms << "\n";
   double maxtime; parse("--maxtime",maxtime);
   log << "Using --maxtime=" << maxtime << "\n";
@@ -676,6 +910,14 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
     p.cmd("setLog",out);
     p.cmd("setNatoms",natoms);
     p.cmd("init");
+    // older kernels do not provide per-action counters
+    try {
+      int counters=1;
+      p.cmd("setActionCounters",&counters);
+      k.actionCounters=true;
+    } catch(std::exception &) {
+      log<<"Kernel "<<k.path<<" does not provide per-action timings\n";
+    }
   }
 
   std::vector<double> cell( 9 ), virial( 9 );
@@ -749,6 +991,7 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
     for(unsigned i=0; i<kernels_ptr.size(); i++) {
       auto & p(kernels_ptr[i]->handle);
 
+      auto prepare_start=std::chrono::high_resolution_clock::now();
       {
         auto sw=kernels_ptr[i]->stopwatch.startPause(sw_name);
         p.cmd("setStep",step);
@@ -765,6 +1008,7 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
         }
         p.cmd("prepareCalc");
       }
+      auto prepare_time=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-prepare_start).count();
 
       // mimick MD calculation here
       {
@@ -774,12 +1018,20 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
         std::fprintf(log_dev_null.get(),"%u",k);
       }
 
+      auto perform_start=std::chrono::high_resolution_clock::now();
       {
         auto sw=kernels_ptr[i]->stopwatch.startStop(sw_name);
         p.cmd("performCalc");
       }
+      auto perform_time=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-perform_start).count();
 
-      if(kernels_ptr.size()>1 && part>1) kernels_ptr[i]->timings.push_back(kernels_ptr[i]->stopwatch.getLastCycle(sw_name));
+      if(part>1) {
+        kernels_ptr[i]->timings.push_back(kernels_ptr[i]->stopwatch.getLastCycle(sw_name));
+        kernels_ptr[i]->prepare_timings.push_back(prepare_time);
+        kernels_ptr[i]->perform_timings.push_back(perform_time);
+      }
+      // counters are reset at every step, also during warm-up
+      if(kernels_ptr[i]->actionCounters) kernels_ptr[i]->collectActionTimings(part>1);
       if(plumedStopCondition || signalReceived.load()) fast_finish=true;
     }
     auto elapsed=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-initial_time).count();
@@ -807,7 +1059,10 @@ int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
     if(fast_finish) break;
   }
 
-  return 0;
+  // run the comparative analysis and write the report now, so that slowdowns can be reported in the exit status
+  kernels_deleter_obj.reset();
+
+  return slowdownFound?1:0;
 }
 
 } // namespace unnamed
@@ -0,0 +1,177 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CLTool.h"
+#include "core/CLToolRegister.h"
+#include "tools/Tools.h"
+#include "tools/IFile.h"
+#include "tools/OFile.h"
+#include "tools/BinaryFieldsFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace PLMD {
+namespace cltools {
+
+//+PLUMEDOC TOOLS convert_fields
+/*
+Convert a file with fields between the text and the binary format.
+
+Files with fields are the files written by PLUMED with a "#! FIELDS" header,
+such as the STATE files of \ref OPES_METAD or the grids of \ref METAD.
+The binary format stores the constant fields (the "#! SET" lines) and the columns of numbers
+without any loss of precision and is used by \ref OPES_METAD when the flag STATE_BINARY is given
+and by \ref METAD when the flag GRID_BINARY is given.
+The direction of the conversion is detected automatically: binary files are converted to text
+and text files are converted to binary.
+
+Only files with a single set of fields can be converted to binary. For instance, a STATE file
+written with STORE_STATES contains many states and cannot be converted.
+The columns of a text file should all contain numbers.
+
+\par Examples
+
+The following command converts the binary STATE file written by \ref OPES_METAD with STATE_BINARY to text
+\verbatim
+plumed convert_fields --input STATE --output STATE.txt
+\endverbatim
+
+The following command converts it back, so that it can be read again with STATE_RFILE
+\verbatim
+plumed convert_fields --input STATE.txt --output STATE
+\endverbatim
+
+Similarly, a text grid written by \ref METAD with GRID_WFILE can be converted to binary and read with GRID_RFILE
+\verbatim
+plumed convert_fields --input GRID --output GRID.bin
+\endverbatim
+
+*/
+//+ENDPLUMEDOC
+
+class ConvertFields:
+  public CLTool
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit ConvertFields(const CLToolOptions& co );
+  int main(FILE* in, FILE*out,Communicator& pc) override;
+  std::string description()const override {
+    return "convert a file with fields between the text and the binary format";
+  }
+};
+
+PLUMED_REGISTER_CLTOOL(ConvertFields,"convert_fields")
+
+void ConvertFields::registerKeywords( Keywords& keys ) {
+  CLTool::registerKeywords( keys );
+  keys.add("compulsory","--input","the file to be converted");
+  keys.add("compulsory","--output","the converted file");
+  keys.add("compulsory","--fmt","%23.16lg","the format used to write the columns of text files");
+}
+
+ConvertFields::ConvertFields(const CLToolOptions& co ):
+  CLTool(co)
+{
+  inputdata=commandline;
+}
+
+int ConvertFields::main(FILE* in, FILE*out,Communicator& pc) {
+
+  std::string input; parse("--input",input);
+  std::string output; parse("--output",output);
+  std::string fmt; parse("--fmt",fmt);
+
+  BinaryFieldsFile bfile;
+  if(BinaryFieldsFile::isBinary(input)) {
+    bfile.read(input);
+    OFile ofile;
+    ofile.open(output);
+    ofile.fmtField(" "+fmt);
+    for(const auto & c : bfile.getConstants()) ofile.addConstantField(c.first);
+    for(const auto & c : bfile.getConstants()) ofile.printField(c.first,c.second);
+    const auto & names=bfile.getColumnNames();
+    std::vector<const double*> columns;
+    for(const auto & n : names) columns.push_back(bfile.getColumn(n));
+    for(std::size_t k=0; k<bfile.getNumberOfRows(); k++) {
+      for(unsigned i=0; i<names.size(); i++) ofile.printField(names[i],columns[i][k]);
+      ofile.printField();
+    }
+    ofile.close();
+    std::fprintf(out,"converted binary file %s to text file %s\n",input.c_str(),output.c_str());
+    return 0;
+  }
+
+  IFile ifile;
+  ifile.open(input);
+  std::vector<std::string> fields;
+  std::vector<std::string> header;
+  std::vector<std::string> names;
+  std::vector<std::string> constants;
+  std::vector<std::string> values;
+  std::vector<std::vector<double>> columns;
+  bool first=true;
+  while(ifile.scanFieldList(fields)) {
+    if(first) {
+      header=fields;
+      for(const auto & f : fields) {
+        if(ifile.FieldIsConstant(f)) {
+          constants.push_back(f);
+          values.emplace_back();
+          ifile.scanField(f,values.back());
+        } else names.push_back(f);
+      }
+      columns.resize(names.size());
+      first=false;
+    } else {
+      plumed_massert(fields==header,"fields change along file " + input + ", only files with a single set of fields can be converted");
+      for(unsigned i=0; i<constants.size(); i++) {
+        std::string value;
+        ifile.scanField(constants[i],value);
+        plumed_massert(value==values[i],"field " + constants[i] + " changes along file " + input + ", only files with a single set of fields can be converted");
+      }
+    }
+    for(unsigned i=0; i<names.size(); i++) {
+      double x;
+      ifile.scanField(names[i],x);
+      columns[i].push_back(x);
+    }
+    ifile.scanField();
+  }
+  ifile.close();
+
+  for(unsigned i=0; i<constants.size(); i++) bfile.setConstant(constants[i],values[i]);
+  bfile.setNumberOfRows(columns.empty() ? 0 : columns[0].size());
+  for(unsigned i=0; i<names.size(); i++) {
+    double* c=bfile.addColumn(names[i]);
+    std::copy(columns[i].begin(),columns[i].end(),c);
+  }
+  OFile bck;
+  bck.backupFile("bck",output);
+  bfile.write(output);
+  std::fprintf(out,"converted text file %s to binary file %s\n",input.c_str(),output.c_str());
+  return 0;
+}
+
+} // End of namespace
+}
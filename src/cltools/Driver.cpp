@@ -39,6 +39,8 @@
 #include "tools/PDB.h"
 #include "tools/FileBase.h"
 #include "tools/IFile.h"
+#include "tools/OFile.h"
+#include "tools/ReadAhead.h"
 #include "xdrfile/xdrfile_trr.h"
 #include "xdrfile/xdrfile_xtc.h"
 
@@ -174,6 +176,30 @@ Notice that the xdrfile implementation of xtc and trr
 is more robust than the molfile one, since it provides support for generic cell shapes.
 In addition, it allows \ref DUMPATOMS to write compressed xtc files.
 
+Decoding compressed trajectories can take a time comparable with the analysis itself. With the
+`--read-ahead` option, frames of xtc, trr and molfile trajectories are read and decoded on a separate
+thread while the previous ones are analysed:
+\verbatim
+plumed driver --plumed plumed.dat --ixtc traj.xtc --read-ahead 4
+\endverbatim
+Here up to four frames are kept ready in memory.
+
+When PLUMED is compiled with MPI, the frames of a long trajectory can be analysed in parallel
+by using the `--frame-parallel` option:
+\verbatim
+mpirun -np 4 plumed driver --plumed plumed.dat --ixtc traj.xtc --frame-parallel
+\endverbatim
+Frame \f$i\f$ is then analysed by the process with rank \f$i\f$ modulo the number of processes, each of them
+running an independent copy of PLUMED (that can in turn use OpenMP threads).
+Every process writes its own files with a `.shardN` suffix. At the end of the calculation, the files that have
+the time in their first column (e.g. the ones written by \ref PRINT) and the file written with `--dump-forces`
+are merged in the proper order into a single file with the name given in the input. Other files are
+left as they are, one for each process.
+Since every copy of PLUMED only sees a part of the frames, actions whose result depends on the frames
+seen before (e.g. \ref METAD or \ref AVERAGE) cannot be used and an error is reported.
+Also notice that neighbor lists are only updated on the frames whose step is a multiple of the
+neighbor list stride, so that they might be updated less often than in a serial calculation.
+
 
 */
 //+ENDPLUMEDOC
@@ -195,6 +221,83 @@ static int register_cb(void *v, vmdplugin_t *p) {
 }
 #endif
 
+/// Merge the output files written by the shards of a frame-parallel run.
+/// Files should start with a "#! FIELDS time" header: data lines are then sorted by time,
+/// while the header is taken only once. Returns false if the header is not found.
+static bool mergeShardFiles(const std::vector<std::string>& shards,const std::string& merged,bool append) {
+  const unsigned n=shards.size();
+  std::vector<std::unique_ptr<IFile>> ifiles(n);
+  for(unsigned i=0; i<n; i++) {
+    ifiles[i]=Tools::make_unique<IFile>();
+    ifiles[i]->allowNoEOL();
+    ifiles[i]->open(shards[i]);
+  }
+// for each shard: the next data line, its time, and the comment lines that precede it
+  std::vector<std::string> next(n),pending(n);
+  std::vector<double> time(n);
+  std::vector<bool> done(n,false);
+  auto advance=[&](unsigned i) {
+    pending[i].clear();
+    std::string line;
+    while(ifiles[i]->getline(line)) {
+      if(line.length()>0 && line[0]=='#') {
+        pending[i]+=line+"\n";
+        continue;
+      }
+      std::vector<std::string> words=Tools::getWords(line);
+      if(words.empty()) continue;
+      if(!Tools::convertNoexcept(words[0],time[i])) plumed_merror("cannot read time from line \""+line+"\" of file "+shards[i]);
+      next[i]=line;
+      return;
+    }
+    done[i]=true;
+  };
+  for(unsigned i=0; i<n; i++) advance(i);
+// the header is taken from the first shard that wrote something
+  unsigned first=0;
+  while(first<n && done[first] && pending[first].empty()) first++;
+  if(first==n) return false;
+  std::vector<std::string> words=Tools::getWords(pending[first].substr(0,pending[first].find('\n')));
+  if(words.size()<3 || words[0]!="#!" || words[1]!="FIELDS" || words[2]!="time") return false;
+
+  OFile ofile;
+  if(append) ofile.enforceRestart();
+  ofile.open(merged);
+  ofile.printf("%s",pending[first].c_str());
+  for(unsigned i=0; i<n; i++) pending[i].clear();
+  while(true) {
+    int imin=-1;
+    for(unsigned i=0; i<n; i++) if(!done[i] && (imin<0 || time[i]<time[imin])) imin=i;
+    if(imin<0) break;
+    ofile.printf("%s%s\n",pending[imin].c_str(),next[imin].c_str());
+    advance(imin);
+  }
+  return true;
+}
+
+/// Merge the forces dumped by the shards of a frame-parallel run.
+/// Frames are taken in turn from each shard, in the same order they were assigned.
+static void mergeShardForces(const std::vector<std::string>& shards,const std::string& merged,int natoms) {
+  auto deleter=[](auto f) { if(f) std::fclose(f); };
+  std::vector<std::unique_ptr<FILE,decltype(deleter)>> in;
+  for(const auto & s : shards) {
+    in.emplace_back(std::fopen(s.c_str(),"r"),deleter);
+    if(!in.back()) plumed_merror("cannot open file "+s);
+  }
+  std::unique_ptr<FILE,decltype(deleter)> out(std::fopen(merged.c_str(),"w"),deleter);
+  if(!out) plumed_merror("cannot open file "+merged);
+  std::string line;
+  for(unsigned frame=0;; frame++) {
+    FILE* fp=in[frame%in.size()].get();
+    if(!Tools::getline(fp,line)) break;
+    std::fprintf(out.get(),"%s\n",line.c_str());
+    for(int i=0; i<natoms+1; i++) {
+      if(!Tools::getline(fp,line)) plumed_merror("premature end of file "+shards[frame%in.size()]);
+      std::fprintf(out.get(),"%s\n",line.c_str());
+    }
+  }
+}
+
 template<typename real>
 class Driver : public CLTool {
 public:
@@ -221,6 +324,9 @@ void Driver<real>::registerKeywords( Keywords& keys ) {
   keys.addFlag("--noatoms",false,"don't read in a trajectory.  Just use colvar files as specified in plumed.dat");
   keys.addFlag("--parse-only",false,"read the plumed input file and stop");
   keys.addFlag("--restart",false,"makes driver behave as if restarting");
+  keys.add("compulsory","--read-ahead","0","number of frames of xtc, trr and molfile trajectories that are read and decoded in advance on a separate thread, "
+           "0 to read them when they are needed");
+  keys.addFlag("--frame-parallel",false,"distribute the frames of the trajectory among the MPI processes, each of them running an independent copy of PLUMED");
   keys.add("atoms","--ixyz","the trajectory in xyz format");
   keys.add("atoms","--igro","the trajectory in gro format");
   keys.add("atoms","--idlp4","the trajectory in DL_POLY_4 format");
@@ -289,6 +395,8 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   std::string full_outputfile; parse("--shortcut-ofile",full_outputfile);
   std::string valuedict_file; parse("--valuedict-ofile",valuedict_file);
   bool restart; parseFlag("--restart",restart);
+  bool frameParallel; parseFlag("--frame-parallel",frameParallel);
+  unsigned readAhead; parse("--read-ahead",readAhead);
 
   std::string fakein;
   bool debug_float=false;
@@ -339,6 +447,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     if(multi*nintra!=ntot) error("invalid number of processes for multi environment");
     pc.Split(pc.Get_rank()/nintra,pc.Get_rank(),intracomm);
     pc.Split(pc.Get_rank()%nintra,pc.Get_rank(),intercomm);
+  } else if(frameParallel) {
+// every process analyses its own frames
+    pc.Split(pc.Get_rank(),0,intracomm);
   } else {
     intracomm.Set_comm(pc.Get_comm());
   }
@@ -516,6 +627,27 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     if( !Communicator::initialized() ) error("needs mpi for debug-pd");
   }
 
+// in frame-parallel mode frame f is analysed by process f%nshards
+  int nshards=1;
+  int shard=0;
+  std::string shardSuffix;
+  if(frameParallel) {
+    if(noatoms) error("--frame-parallel cannot be used with --noatoms");
+    if(parseOnly) error("--frame-parallel cannot be used with --parse-only");
+    if(multi) error("--frame-parallel cannot be used with --multi");
+    if(debug_pd || debug_dd || debug_grex) error("--frame-parallel cannot be used with the debug options");
+    if(debugforces.length()>0) error("--frame-parallel cannot be used with --debug-forces");
+    if(trajectoryFile=="-") error("--frame-parallel cannot read the trajectory from standard input");
+    if(Communicator::initialized()) {
+      nshards=pc.Get_size();
+      shard=pc.Get_rank();
+    }
+    if(nshards>1) {
+      std::string n; Tools::convert(shard,n);
+      shardSuffix=".shard"+n;
+    }
+  }
+
   PlumedMain p; if( parseOnly ) p.activateParseOnlyMode();
   p.cmd("setRealPrecision",(int)sizeof(real));
   int checknatoms=-1;
@@ -524,7 +656,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   if(restart) p.cmd("setRestart",1);
 
-  if(Communicator::initialized()) {
+  if(Communicator::initialized() && !frameParallel) {
     if(multi) {
       if(intracomm.Get_rank()==0) p.cmd("GREX setMPIIntercomm",&intercomm.Get_comm());
       p.cmd("GREX setMPIIntracomm",&intracomm.Get_comm());
@@ -538,7 +670,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   p.cmd("setMDEngine","driver");
   p.cmd("setTimestep",timestep);
   if( !parseOnly || full_outputfile.length()==0 ) p.cmd("setPlumedDat",plumedFile.c_str());
-  p.cmd("setLog",out);
+  if(shard==0) p.cmd("setLog",out);
+  else p.cmd("setLogFile","/dev/null");
+  if(shardSuffix.length()>0) p.setSuffix(shardSuffix);
 
   int natoms;
   int lvl=0;
@@ -607,7 +741,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       }
     }
     if(dumpforces.length()>0) {
-      if(Communicator::initialized() && pc.Get_size()>1) {
+      if(shardSuffix.length()>0) {
+        dumpforces=FileBase::appendSuffix(dumpforces,shardSuffix);
+      } else if(Communicator::initialized() && pc.Get_size()>1) {
         std::string n;
         Tools::convert(pc.Get_rank(),n);
         dumpforces+="."+n;
@@ -654,19 +790,108 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     std::sscanf(line.c_str(),"%d %d %d",&lvl,&pb,&natoms);
 
   }
-  bool lstep=true;
-  while(true) {
-    if(!noatoms&&!parseOnly) {
-      if(use_molfile==true) {
+// a frame of a binary trajectory, decoded into the arrays passed to plumed
+  struct BinaryFrame {
+    std::vector<real> coordinates;
+    std::vector<real> cell;
+    long long int step=0;
+  };
+  const bool binaryTrajectory=(use_molfile || trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr");
+  std::unique_ptr<xdrfile::rvec[]> xdr_pos;
+// read and decode the next frame of a binary trajectory, returns false at the end of the file.
+// frames that are skipped are only decoded as much as needed to move to the following one.
+  auto readBinaryFrame=[&](BinaryFrame& fr,bool skip) {
+    fr.coordinates.assign(3*natoms,real(0.0));
+    fr.cell.assign(9,real(0.0));
+    if(use_molfile) {
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+      {
         std::unique_ptr<std::lock_guard<std::mutex>> lck;
         if(api->is_reentrant==VMDPLUGIN_THREADUNSAFE) lck=Tools::molfile_lock();
         int rc;
-        rc = api->read_next_timestep(h_in, natoms, &ts_in);
-        if(rc==MOLFILE_EOF) {
-          break;
+        rc = api->read_next_timestep(h_in, natoms, skip ? NULL : &ts_in);
+        if(rc==MOLFILE_EOF) return false;
+      }
+      if(skip) return true;
+      std::vector<real> & cell(fr.cell);
+      if(pbc_cli_given==false) {
+        if(ts_in.A>0.0) { // this is negative if molfile does not provide box
+          // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
+          real cosBC=cos(real(ts_in.alpha)*pi/180.);
+          //double sinBC=std::sin(ts_in.alpha*pi/180.);
+          real cosAC=std::cos(real(ts_in.beta)*pi/180.);
+          real cosAB=std::cos(real(ts_in.gamma)*pi/180.);
+          real sinAB=std::sin(real(ts_in.gamma)*pi/180.);
+          real Ax=real(ts_in.A);
+          real Bx=real(ts_in.B)*cosAB;
+          real By=real(ts_in.B)*sinAB;
+          real Cx=real(ts_in.C)*cosAC;
+          real Cy=(real(ts_in.C)*real(ts_in.B)*cosBC-Cx*Bx)/By;
+          real Cz=std::sqrt(real(ts_in.C)*real(ts_in.C)-Cx*Cx-Cy*Cy);
+          cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
+          cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
+          cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
+        } else {
+          cell[0]=0.0; cell[1]=0.0; cell[2]=0.0;
+          cell[3]=0.0; cell[4]=0.0; cell[5]=0.0;
+          cell[6]=0.0; cell[7]=0.0; cell[8]=0.0;
         }
+      } else {
+        for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
+      }
+      // info on coords
+      // the order is xyzxyz...
+      for(int i=0; i<3*natoms; i++) {
+        fr.coordinates[i]=real(ts_in.coords[i])/real(10.); //convert to nm
+        //cerr<<"COOR "<<coordinates[i]<<endl;
+      }
 #endif
+    } else {
+      int localstep;
+      float time;
+      xdrfile::matrix box;
+// here we cannot use a std::vector<rvec> since it does not compile.
+// we thus use a std::unique_ptr<rvec[]>
+      if(!xdr_pos) xdr_pos=Tools::make_unique<xdrfile::rvec[]>(natoms);
+      float prec,lambda;
+      int ret=xdrfile::exdrOK;
+      if(trajectory_fmt=="xdr-xtc") ret=xdrfile::read_xtc(xd,natoms,&localstep,&time,box,xdr_pos.get(),&prec);
+      if(trajectory_fmt=="xdr-trr") ret=xdrfile::read_trr(xd,natoms,&localstep,&time,&lambda,box,xdr_pos.get(),NULL,NULL);
+      if(ret==xdrfile::exdrENDOFFILE) return false;
+      if(ret!=xdrfile::exdrOK) return false;
+      fr.step=localstep;
+      if(skip) return true;
+      for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) fr.cell[3*i+j]=box[i][j];
+      for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
+          fr.coordinates[3*i+j]=real(xdr_pos[i][j]);
+    }
+    return true;
+  };
+// frames assigned to other shards are read but not analysed
+  auto isSkipped=[&](long long int frame) { return frame%nshards!=shard; };
+  BinaryFrame syncFrame;
+  long long int prefetched=0;
+  std::unique_ptr<ReadAhead<BinaryFrame>> prefetcher;
+  if(readAhead>0 && !noatoms && !parseOnly) {
+    if(binaryTrajectory) {
+      prefetcher=Tools::make_unique<ReadAhead<BinaryFrame>>(readAhead,[&](BinaryFrame& fr) { return readBinaryFrame(fr,isSkipped(prefetched++)); });
+      std::fprintf(out,"DRIVER: reading up to %u frames in advance\n",readAhead);
+    } else {
+      std::fprintf(out,"DRIVER: --read-ahead is ignored since it is only available for xtc, trr and molfile trajectories\n");
+    }
+  }
+
+  bool lstep=true;
+  long long int frame=0;
+  while(true) {
+    const bool skipFrame=isSkipped(frame);
+    frame++;
+    BinaryFrame* binaryFrame=nullptr;
+    if(!noatoms&&!parseOnly) {
+      if(binaryTrajectory) {
+        if(prefetcher) binaryFrame=prefetcher->next();
+        else if(readBinaryFrame(syncFrame,skipFrame)) binaryFrame=&syncFrame;
+        if(!binaryFrame) break;
       } else if(trajectory_fmt=="xyz" || trajectory_fmt=="gro" || trajectory_fmt=="dlp4") {
         if(!Tools::getline(fp,line)) break;
       }
@@ -723,6 +948,11 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       checknatoms=natoms;
       p.cmd("setNatoms",natoms);
       p.cmd("init");
+      if(frameParallel) {
+        for(const auto & pp : p.getActionSet()) {
+          if(pp->checkIsHistoryDependent()) error("action " + pp->getLabel() + " of type " + pp->getName() + " depends on the previous frames and cannot be used with --frame-parallel");
+        }
+      }
       // Check if we have been asked to output the long version of the input and if there are shortcuts
       if( parseOnly && full_outputfile.length()>0 ) {
 
@@ -906,57 +1136,11 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
     int plumedStopCondition=0;
     if(!noatoms) {
-      if(use_molfile) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        if(pbc_cli_given==false) {
-          if(ts_in.A>0.0) { // this is negative if molfile does not provide box
-            // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
-            real cosBC=cos(real(ts_in.alpha)*pi/180.);
-            //double sinBC=std::sin(ts_in.alpha*pi/180.);
-            real cosAC=std::cos(real(ts_in.beta)*pi/180.);
-            real cosAB=std::cos(real(ts_in.gamma)*pi/180.);
-            real sinAB=std::sin(real(ts_in.gamma)*pi/180.);
-            real Ax=real(ts_in.A);
-            real Bx=real(ts_in.B)*cosAB;
-            real By=real(ts_in.B)*sinAB;
-            real Cx=real(ts_in.C)*cosAC;
-            real Cy=(real(ts_in.C)*real(ts_in.B)*cosBC-Cx*Bx)/By;
-            real Cz=std::sqrt(real(ts_in.C)*real(ts_in.C)-Cx*Cx-Cy*Cy);
-            cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
-            cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
-            cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
-          } else {
-            cell[0]=0.0; cell[1]=0.0; cell[2]=0.0;
-            cell[3]=0.0; cell[4]=0.0; cell[5]=0.0;
-            cell[6]=0.0; cell[7]=0.0; cell[8]=0.0;
-          }
-        } else {
-          for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
-        }
-        // info on coords
-        // the order is xyzxyz...
-        for(int i=0; i<3*natoms; i++) {
-          coordinates[i]=real(ts_in.coords[i])/real(10.); //convert to nm
-          //cerr<<"COOR "<<coordinates[i]<<endl;
-        }
-#endif
-      } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
-        int localstep;
-        float time;
-        xdrfile::matrix box;
-// here we cannot use a std::vector<rvec> since it does not compile.
-// we thus use a std::unique_ptr<rvec[]>
-        auto pos=Tools::make_unique<xdrfile::rvec[]>(natoms);
-        float prec,lambda;
-        int ret=xdrfile::exdrOK;
-        if(trajectory_fmt=="xdr-xtc") ret=xdrfile::read_xtc(xd,natoms,&localstep,&time,box,pos.get(),&prec);
-        if(trajectory_fmt=="xdr-trr") ret=xdrfile::read_trr(xd,natoms,&localstep,&time,&lambda,box,pos.get(),NULL,NULL);
-        if(stride==0) step=localstep;
-        if(ret==xdrfile::exdrENDOFFILE) break;
-        if(ret!=xdrfile::exdrOK) break;
-        for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) cell[3*i+j]=box[i][j];
-        for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
-            coordinates[3*i+j]=real(pos[i][j]);
+      if(binaryFrame) {
+// swap rather than copy, the arrays are reused for the following frames
+        coordinates.swap(binaryFrame->coordinates);
+        cell.swap(binaryFrame->cell);
+        if(!use_molfile && stride==0) step=binaryFrame->step;
       } else {
         if(trajectory_fmt=="xyz") {
           if(!Tools::getline(fp,line)) error("premature end of trajectory file");
@@ -1004,6 +1188,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
         for(int i=0; i<natoms; i++) {
           bool ok=Tools::getline(fp,line);
           if(!ok) error("premature end of trajectory file");
+          if(skipFrame && trajectory_fmt!="dlp4") continue;
           double cc[3];
           if(trajectory_fmt=="xyz") {
             char dummy[1000];
@@ -1070,6 +1255,11 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
       }
 
+      if(skipFrame) {
+        step+=stride;
+        continue;
+      }
+
       p.cmd("setStepLongLong",step);
       p.cmd("setStopFlag",&plumedStopCondition);
 
@@ -1186,6 +1376,43 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   }
   if(!parseOnly) p.cmd("runFinalJobs");
 
+  if(shardSuffix.length()>0) {
+// all shards have the same input, so that the list of files from the first one can be used
+    p.fflush();
+    fp_forces_deleter.reset();
+    pc.Barrier();
+    if(shard==0) {
+      auto shardNames=[&](const std::string& path) {
+        std::vector<std::string> names(nshards);
+        for(int i=0; i<nshards; i++) {
+          std::string n; Tools::convert(i,n);
+          names[i]=FileBase::appendSuffix(path,".shard"+n);
+        }
+        return names;
+      };
+      for(const auto & path : p.getOutputFilePaths()) {
+        auto pos=path.rfind(shardSuffix);
+        if(pos==std::string::npos) continue;
+        std::string merged=path.substr(0,pos)+path.substr(pos+shardSuffix.length());
+        std::vector<std::string> shards=shardNames(merged);
+        if(mergeShardFiles(shards,merged,restart)) {
+          for(const auto & s : shards) std::remove(s.c_str());
+          std::fprintf(out,"DRIVER: merged output of all shards in file %s\n",merged.c_str());
+        } else {
+          std::fprintf(out,"DRIVER: file %s is not time-indexed, each shard kept its own copy\n",merged.c_str());
+        }
+      }
+      if(dumpforces.length()>0) {
+        auto pos=dumpforces.rfind(shardSuffix);
+        std::string merged=dumpforces.substr(0,pos)+dumpforces.substr(pos+shardSuffix.length());
+        std::vector<std::string> shards=shardNames(merged);
+        mergeShardForces(shards,merged,natoms);
+        for(const auto & s : shards) std::remove(s.c_str());
+      }
+    }
+    pc.Barrier();
+  }
+
   return 0;
 }
 
@@ -44,6 +44,7 @@ ClusteringBase::ClusteringBase(const ActionOptions&ao):
   addValue( shape ); setNotPeriodic(); getPntrToValue()->buildDataStore();
   // Resize local variables
   which_cluster.resize( getPntrToArgument(0)->getShape()[0] ); cluster_sizes.resize( getPntrToArgument(0)->getShape()[0] );
+  cluster_rank.resize( getPntrToArgument(0)->getShape()[0] );
 }
 
 void ClusteringBase::retrieveAdjacencyLists( std::vector<unsigned>& nneigh, Matrix<unsigned>& adj_list ) {
@@ -75,13 +76,10 @@ void ClusteringBase::calculate() {
   performClustering();
   // Order the clusters in the system by size (this returns ascending order )
   std::sort( cluster_sizes.begin(), cluster_sizes.end() );
+  // Work out the position of each cluster in the ordered list
+  for(unsigned i=0; i<cluster_sizes.size(); ++i) cluster_rank[cluster_sizes[i].second] = cluster_sizes.size()-i;
   // Set the elements of the value to the cluster identies
-  for(unsigned i=0; i<cluster_sizes.size(); ++i) {
-    double this_size = static_cast<double>(cluster_sizes.size()-i);
-    for(unsigned j=0; j<cluster_sizes.size(); ++j) {
-      if( which_cluster[j]==cluster_sizes[i].second ) getPntrToValue()->set( j, this_size );
-    }
-  }
+  for(unsigned j=0; j<which_cluster.size(); ++j) getPntrToValue()->set( j, static_cast<double>(cluster_rank[which_cluster[j]]) );
 }
 
 void ClusteringBase::apply() {
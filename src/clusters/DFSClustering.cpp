@@ -21,12 +21,8 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "ClusteringBase.h"
 #include "core/ActionRegister.h"
-
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/connected_components.hpp>
-#include <boost/graph/graph_utility.hpp>
-#endif
+#include "tools/OpenMP.h"
+#include <atomic>
 
 //+PLUMEDOC MATRIXF DFSCLUSTERING
 /*
@@ -40,6 +36,12 @@ a depth first search clustering to find the connected components of this graph.
 
 https://en.wikipedia.org/wiki/Depth-first_search
 
+The connected components are actually found using a concurrent union-find (disjoint set) algorithm that runs over the non-zero elements of the
+sparse matrix in parallel when PLUMED is run with multiple OpenMP threads.  The clusters that are found and the order in which they are numbered
+are the same as those that would be obtained from a depth first search.  You can read more about the union-find algorithm here:
+
+https://en.wikipedia.org/wiki/Disjoint-set_data_structure
+
 This action is useful if you are looking at a phenomenon such as nucleation where the aim is to detect the sizes of the crystalline nuclei that have formed
 in your simulation cell.
 
@@ -68,16 +70,12 @@ namespace clusters {
 
 class DFSClustering : public ClusteringBase {
 private:
-#ifndef __PLUMED_HAS_BOOST_GRAPH
-/// The number of neighbors each atom has
-  std::vector<unsigned> nneigh;
-/// The adjacency list
-  Matrix<unsigned> adj_list;
-/// The color that tells us whether a node has been visited
-  std::vector<unsigned> color;
-/// The recursive function at the heart of this method
-  int explore( const unsigned& index );
-#endif
+/// The parent of each node in the union-find forest
+  std::vector<std::atomic<unsigned> > parent;
+/// Find the root of the tree that contains a node, halving the path as we go
+  unsigned findRoot( unsigned index );
+/// Merge the trees that contain two nodes
+  void merge( unsigned i, unsigned j );
 public:
 /// Create manual
   static void registerKeywords( Keywords& keys );
@@ -96,55 +94,75 @@ void DFSClustering::registerKeywords( Keywords& keys ) {
 
 DFSClustering::DFSClustering(const ActionOptions&ao):
   Action(ao),
-  ClusteringBase(ao)
+  ClusteringBase(ao),
+  parent(getNumberOfNodes())
 {
-#ifndef __PLUMED_HAS_BOOST_GRAPH
-  nneigh.resize( getNumberOfNodes() ); color.resize(getNumberOfNodes());
-#endif
   bool lowmem; parseFlag("LOWMEM",lowmem);
   if( lowmem ) warning("LOWMEM flag is deprecated and is no longer required for this action");
 }
 
-void DFSClustering::performClustering() {
-#ifdef __PLUMED_HAS_BOOST_GRAPH
-  // Get the list of edges
-  unsigned nedges=0; retrieveEdgeList( 0, nedges );
-
-  // Build the graph using boost
-  boost::adjacency_list<boost::vecS,boost::vecS,boost::undirectedS> sg(&pairs[0],&pairs[nedges],getNumberOfNodes());
-
-  // Find the connected components using boost (-1 here for compatibility with non-boost version)
-  number_of_cluster=boost::connected_components(sg,&which_cluster[0]) - 1;
-
-  // And work out the size of each cluster
-  for(unsigned i=0; i<which_cluster.size(); ++i) cluster_sizes[which_cluster[i]].first++;
-#else
-  // Get the adjacency matrix
-  retrieveAdjacencyLists( nneigh, adj_list );
-
-  // Perform clustering
-  number_of_cluster=-1; color.assign(color.size(),0);
-  for(unsigned i=0; i<getNumberOfNodes(); ++i) {
-    if( color[i]==0 ) { number_of_cluster++; color[i]=explore(i); }
+unsigned DFSClustering::findRoot( unsigned index ) {
+  while( true ) {
+    unsigned p = parent[index].load();
+    if( p==index ) return index;
+    unsigned gp = parent[p].load();
+    // Point this node at its grandparent.  If another thread got here first that is fine too
+    if( gp!=p ) parent[index].compare_exchange_weak( p, gp );
+    index = gp;
   }
-#endif
 }
 
-#ifndef __PLUMED_HAS_BOOST_GRAPH
-int DFSClustering::explore( const unsigned& index ) {
+void DFSClustering::merge( unsigned i, unsigned j ) {
+  while( true ) {
+    i = findRoot( i ); j = findRoot( j );
+    if( i==j ) return;
+    // Always attach the root with the larger index to the one with the smaller index so no cycles can form
+    // and so the root of each tree is the lowest numbered node in the cluster
+    if( i<j ) std::swap( i, j );
+    unsigned expected = i;
+    if( parent[i].compare_exchange_strong( expected, j ) ) return;
+  }
+}
 
-  color[index]=1;
-  for(unsigned i=0; i<nneigh[index]; ++i) {
-    unsigned j=adj_list(index,i);
-    if( color[j]==0 ) color[j]=explore(j);
+void DFSClustering::performClustering() {
+  Value* mat = getPntrToArgument(0); unsigned nnodes = getNumberOfNodes(), ncols = mat->getNumberOfColumns();
+  bool symmetric = mat->isSymmetric();
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt*10>nnodes ) nt=nnodes/10;
+  if( nt==0 ) nt=1;
+
+  // Every node starts in a cluster of its own
+  #pragma omp parallel num_threads(nt)
+  {
+    #pragma omp for
+    for(unsigned i=0; i<nnodes; ++i) parent[i].store(i);
+
+    // Merge the clusters of all connected nodes by running over the sparse matrix
+    #pragma omp for
+    for(unsigned i=0; i<nnodes; ++i) {
+      unsigned ncol = mat->getRowLength(i);
+      for(unsigned j=0; j<ncol; ++j) {
+        if( fabs(mat->get(i*ncols+j,false))<epsilon ) continue;
+        unsigned k = mat->getRowIndex(i,j);
+        if( k==i || (symmetric && k>i) ) continue;
+        merge( i, k );
+      }
+    }
+
+    // Find the root of every node
+    #pragma omp for
+    for(unsigned i=0; i<nnodes; ++i) which_cluster[i] = findRoot(i);
   }
 
-  // Count the size of the cluster
-  cluster_sizes[number_of_cluster].first++;
-  which_cluster[index] = number_of_cluster;
-  return color[index];
+  // Number the clusters in order of their lowest numbered node as the depth first search would.
+  // The root of each cluster is its lowest numbered node so it is always relabelled before the other members
+  number_of_cluster=-1;
+  for(unsigned i=0; i<nnodes; ++i) {
+    if( which_cluster[i]==i ) { number_of_cluster++; which_cluster[i]=number_of_cluster; }
+    else which_cluster[i]=which_cluster[which_cluster[i]];
+    cluster_sizes[which_cluster[i]].first++;
+  }
 }
-#endif
 
 }
 }
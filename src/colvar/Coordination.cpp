@@ -46,6 +46,10 @@ but it can be changed using the optional SWITCH option.
 
 To make your calculation faster you can use a neighbor list, which makes it that only a
 relevant subset of the pairwise distance are calculated at every step.
+When the box is known, the neighbor list is built using link cells, so that its cost grows linearly
+with the number of atoms. Instead of rebuilding it every NL_STRIDE steps, you can use NL_SKIN:
+the list is then rebuilt only when an atom has moved by more than half of NL_SKIN since the last
+update. In this case NL_CUTOFF should be the distance after which the switching function is zero plus NL_SKIN.
 
 If GROUPB is empty, it will sum the \f$\frac{N(N-1)}{2}\f$ pairs in GROUPA. This avoids computing
 twice permuted indexes (e.g. pair (i,j) and (j,i)) thus running at twice the speed.
@@ -62,6 +66,12 @@ The following example instructs plumed to calculate the total coordination numbe
 COORDINATION GROUPA=1-10 GROUPB=20-100 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_STRIDE=100
 \endplumedfile
 
+The same calculation can be done with a neighbor list that is only updated when it is necessary.
+Here the switching function is set to zero beyond 0.6 nm and the skin is 0.2 nm.
+\plumedfile
+COORDINATION GROUPA=1-10 GROUPB=20-100 SWITCH={RATIONAL R_0=0.3 D_MAX=0.6} NLIST NL_CUTOFF=0.8 NL_SKIN=0.2
+\endplumedfile
+
 The following is a dummy example which should compute the value 0 because the self interaction
 of atom 1 is skipped. Notice that in plumed 2.0 "self interactions" were not skipped, and the
 same calculation should return 1.
@@ -100,6 +110,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   double pairing(double distance,double&dfunc,unsigned i,unsigned j)const override;
+  void pairingBatch(const double* distance,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const override;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -150,6 +161,12 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::pairingBatch(const double* distance,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const {
+  (void) i; // avoid warnings
+  (void) j; // avoid warnings
+  switchingFunction.calculateSqr(distance,result,dfunc,n);
+}
+
 }
 
 }
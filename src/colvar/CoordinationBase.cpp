@@ -24,6 +24,9 @@
 #include "tools/Communicator.h"
 #include "tools/OpenMP.h"
 
+#include <algorithm>
+#include <array>
+
 namespace PLMD {
 namespace colvar {
 
@@ -34,6 +37,7 @@ void CoordinationBase::registerKeywords( Keywords& keys ) {
   keys.addFlag("NLIST",false,"Use a neighbor list to speed up the calculation");
   keys.add("optional","NL_CUTOFF","The cutoff for the neighbor list");
   keys.add("optional","NL_STRIDE","The frequency with which we are updating the atoms in the neighbor list");
+  keys.add("optional","NL_SKIN","Update the neighbor list only when an atom has moved by more than half of this distance since the last update, instead of every NL_STRIDE steps. NL_CUTOFF should include the skin");
   keys.add("atoms","GROUPA","First list of atoms");
   keys.add("atoms","GROUPB","Second list of atoms (if empty, N*(N-1)/2 pairs in GROUPA are counted)");
 }
@@ -63,21 +67,26 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
 // neighbor list stuff
   bool doneigh=false;
   double nl_cut=0.0;
+  double nl_skin=0.0;
   int nl_st=0;
   parseFlag("NLIST",doneigh);
   if(doneigh) {
     parse("NL_CUTOFF",nl_cut);
     if(nl_cut<=0.0) error("NL_CUTOFF should be explicitly specified and positive");
+    parse("NL_SKIN",nl_skin);
+    if(nl_skin<0.0 || nl_skin>=nl_cut) error("NL_SKIN should be positive and smaller than NL_CUTOFF");
     parse("NL_STRIDE",nl_st);
-    if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
+    if(nl_skin>0.0) {
+      if(nl_st>0) error("NL_STRIDE and NL_SKIN cannot be used together");
+    } else if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
   }
 
   addValueWithDerivatives(); setNotPeriodic();
   if(gb_lista.size()>0) {
-    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm,nl_cut,nl_st);
+    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm,nl_cut,nl_st,nl_skin);
     else         nl=Tools::make_unique<NeighborList>(ga_lista,gb_lista,serial,dopair,pbc,getPbc(),comm);
   } else {
-    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm,nl_cut,nl_st);
+    if(doneigh)  nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm,nl_cut,nl_st,nl_skin);
     else         nl=Tools::make_unique<NeighborList>(ga_lista,serial,pbc,getPbc(),comm);
   }
 
@@ -100,7 +109,8 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   if(dopair) log.printf("  with PAIR option\n");
   if(doneigh) {
     log.printf("  using neighbor lists with\n");
-    log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+    if(nl_skin>0.0) log.printf("  update when an atom moves by more than %f and cutoff %f\n",0.5*nl_skin,nl_cut);
+    else log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
   }
 }
 
@@ -123,6 +133,10 @@ void CoordinationBase::prepare() {
   }
 }
 
+void CoordinationBase::pairingBatch(const double* distance,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const {
+  for(unsigned k=0; k<n; ++k) result[k]=pairing(distance[k],dfunc[k],i[k],j[k]);
+}
+
 // calculator
 void CoordinationBase::calculate()
 {
@@ -133,6 +147,8 @@ void CoordinationBase::calculate()
 
   if(nl->getStride()>0 && invalidateList) {
     nl->update(getPositions());
+  } else if(nl->getSkin()>0.0 && nl->needsUpdate(getPositions())) {
+    nl->update(getPositions());
   }
 
   unsigned stride;
@@ -149,47 +165,75 @@ void CoordinationBase::calculate()
   const unsigned nn=nl->size();
   if(nt*stride*10>nn) nt=1;
 
+// pairs are processed in blocks, so that pairingBatch() can be applied to all the distances of a block
+  constexpr unsigned pairBlock=64;
+  const unsigned nlocal=(rank<nn ? (nn-rank+stride-1)/stride : 0);
+  const unsigned nblocks=(nlocal+pairBlock-1)/pairBlock;
+
+  // the contributions of the threads are summed in a fixed order, so that the result
+  // does not depend on the order in which the threads finish
+  OpenMP::ArrayReduction<Vector> deriv_reduction(nt,deriv.size());
+  std::vector<double> thread_ncoord(nt,0.0);
+  std::vector<Tensor> thread_virial(nt);
+
   #pragma omp parallel num_threads(nt)
   {
-    std::vector<Vector> omp_deriv(getPositions().size());
+    // with a single thread the derivatives are accumulated directly
+    std::vector<Vector> & omp_deriv(nt>1 ? deriv_reduction.getArray() : deriv);
+    double omp_ncoord=0.0;
     Tensor omp_virial;
-
-    #pragma omp for reduction(+:ncoord) nowait
-    for(unsigned int i=rank; i<nn; i+=stride) {
-
-      Vector distance;
-      unsigned i0=nl->getClosePair(i).first;
-      unsigned i1=nl->getClosePair(i).second;
-
-      if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
-
-      if(pbc) {
-        distance=pbcDistance(getPosition(i0),getPosition(i1));
-      } else {
-        distance=delta(getPosition(i0),getPosition(i1));
+    std::array<Vector,pairBlock> distance;
+    std::array<double,pairBlock> distance2;
+    std::array<double,pairBlock> value;
+    std::array<double,pairBlock> dfunc;
+    std::array<unsigned,pairBlock> first;
+    std::array<unsigned,pairBlock> second;
+
+    #pragma omp for nowait
+    for(unsigned b=0; b<nblocks; ++b) {
+
+      const unsigned kend=std::min(nlocal,(b+1)*pairBlock);
+      unsigned npairs=0;
+      for(unsigned k=b*pairBlock; k<kend; ++k) {
+        const unsigned i=rank+k*stride;
+        unsigned i0=nl->getClosePair(i).first;
+        unsigned i1=nl->getClosePair(i).second;
+
+        if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+
+        if(pbc) {
+          distance[npairs]=pbcDistance(getPosition(i0),getPosition(i1));
+        } else {
+          distance[npairs]=delta(getPosition(i0),getPosition(i1));
+        }
+        distance2[npairs]=distance[npairs].modulo2();
+        first[npairs]=i0;
+        second[npairs]=i1;
+        npairs++;
       }
 
-      double dfunc=0.;
-      ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
+      pairingBatch(distance2.data(),value.data(),dfunc.data(),first.data(),second.data(),npairs);
 
-      Vector dd(dfunc*distance);
-      Tensor vv(dd,distance);
-      if(nt>1) {
-        omp_deriv[i0]-=dd;
-        omp_deriv[i1]+=dd;
+      for(unsigned k=0; k<npairs; ++k) {
+        omp_ncoord += value[k];
+        // pairs beyond the cutoff do not contribute to the derivatives
+        if(dfunc[k]==0.0) continue;
+
+        Vector dd(dfunc[k]*distance[k]);
+        Tensor vv(dd,distance[k]);
+        omp_deriv[first[k]]-=dd;
+        omp_deriv[second[k]]+=dd;
         omp_virial-=vv;
-      } else {
-        deriv[i0]-=dd;
-        deriv[i1]+=dd;
-        virial-=vv;
       }
 
     }
-    #pragma omp critical
-    if(nt>1) {
-      for(unsigned i=0; i<getPositions().size(); i++) deriv[i]+=omp_deriv[i];
-      virial+=omp_virial;
-    }
+    thread_ncoord[OpenMP::getThreadNum()]=omp_ncoord;
+    thread_virial[OpenMP::getThreadNum()]=omp_virial;
+    deriv_reduction.sum(deriv);
+  }
+  for(unsigned t=0; t<nt; ++t) {
+    ncoord+=thread_ncoord[t];
+    virial+=thread_virial[t];
   }
 
   if(!serial) {
@@ -44,6 +44,9 @@ public:
   void calculate() override;
   void prepare() override;
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute pairing() for n pairs of atoms at once.
+/// The default implementation calls pairing() on each pair, derived classes can override it to vectorize the loop
+  virtual void pairingBatch(const double* distance,double* result,double* dfunc,const unsigned* i,const unsigned* j,unsigned n)const;
   static void registerKeywords( Keywords& keys );
 };
 
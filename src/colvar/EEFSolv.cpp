@@ -202,9 +202,12 @@ void EEFSolv::calculate() {
   unsigned nt=OpenMP::getNumThreads();
   if(nt*stride*10>size) nt=1;
 
+  OpenMP::ArrayReduction<Vector> deriv_reduction(nt,size);
+
   #pragma omp parallel num_threads(nt)
   {
-    std::vector<Vector> deriv_omp(size, Vector(0,0,0));
+    // with a single thread the derivatives are accumulated directly
+    std::vector<Vector> & deriv_omp(nt>1 ? deriv_reduction.getArray() : deriv);
     #pragma omp for reduction(+:bias) nowait
     for (unsigned i=rank; i<size; i+=stride) {
       const Vector posi = getPosition(i);
@@ -242,8 +245,7 @@ void EEFSolv::calculate() {
             const Vector dd    = e_deriv*dist;
             fedensity    += fact;
             deriv_i      += dd;
-            if(nt>1) deriv_omp[j] -= dd;
-            else deriv[j] -= dd;
+            deriv_omp[j] -= dd;
           }
 
           // j-i interaction
@@ -256,8 +258,7 @@ void EEFSolv::calculate() {
             const Vector dd    = e_deriv*dist;
             fedensity    += fact;
             deriv_i      += dd;
-            if(nt>1) deriv_omp[j] -= dd;
-            else deriv[j] -= dd;
+            deriv_omp[j] -= dd;
           }
         } else {
           // i-j interaction
@@ -270,18 +271,15 @@ void EEFSolv::calculate() {
             const Vector dd    = e_deriv*dist;
             fedensity    += fact;
             deriv_i      += dd;
-            if(nt>1) deriv_omp[j] -= dd;
-            else deriv[j] -= dd;
+            deriv_omp[j] -= dd;
           }
         }
 
       }
-      if(nt>1) deriv_omp[i] += deriv_i;
-      else deriv[i] += deriv_i;
+      deriv_omp[i] += deriv_i;
       bias += 0.5*fedensity;
     }
-    #pragma omp critical
-    if(nt>1) for(unsigned i=0; i<size; i++) deriv[i]+=deriv_omp[i];
+    deriv_reduction.sum(deriv);
   }
 
   if(!serial) {
@@ -150,13 +150,14 @@ void MultiColvarTemplate<T>::performTask( const unsigned& task_index, MultiValue
     }
   } else if( fpositions.size()==1 ) fpositions[0]=delta(Vector(0.0,0.0,0.0),getPosition( ablocks[0][task_index] ) );
   // Retrieve the masses and charges
-  myvals.resizeTemporyVector(2);
+  myvals.resizeTemporyVector(3);
   std::vector<double> & mass( myvals.getTemporyVector(0) );
   std::vector<double> & charge( myvals.getTemporyVector(1) );
   if( mass.size()!=ablocks.size() ) { mass.resize(ablocks.size()); charge.resize(ablocks.size()); }
   for(unsigned i=0; i<ablocks.size(); ++i) { mass[i]=getMass( ablocks[i][task_index] ); charge[i]=getCharge( ablocks[i][task_index] ); }
   // Make some space to store various things
-  std::vector<double> values( getNumberOfComponents() );
+  std::vector<double> & values( myvals.getTemporyVector(2) );
+  values.assign( getNumberOfComponents(), 0.0 );
   std::vector<Tensor> & virial( myvals.getFirstAtomVirialVector() );
   std::vector<std::vector<Vector> > & derivs( myvals.getFirstAtomDerivativeVector() );
   if( derivs.size()!=values.size() ) { derivs.resize( values.size() ); virial.resize( values.size() ); }
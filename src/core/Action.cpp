@@ -81,6 +81,10 @@ Action::Action(const ActionOptions&ao):
   // Retrieve the timestep and save it
   resetStoredTimestep();
 
+  for(const auto & w : line) {
+    if(!definition.empty()) definition+=" ";
+    definition+=w;
+  }
   line.erase(line.begin());
   if( !keywords.exists("NO_ACTION_LOG") ) {
     log.printf("Action %s\n",name.c_str());
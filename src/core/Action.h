@@ -85,6 +85,9 @@ class Action {
 /// so as to check if all the present keywords are correct.
   std::vector<std::string> line;
 
+/// Complete directive line, as it was before being parsed.
+  std::string definition;
+
 /// Update only after this time.
   double update_from;
 
@@ -274,6 +277,9 @@ public:
 /// Returns the name
   const std::string & getName()const;
 
+/// Returns the complete input line of the action, as it was before being parsed
+  const std::string & getDefinition()const;
+
 /// Set action to active
   virtual void activate();
 
@@ -300,6 +306,18 @@ public:
 /// Check if the action needs gradient
   virtual bool checkNeedsGradients()const {return false;}
 
+/// Check if the action modifies data that other actions use without depending on it (e.g. the positions of the atoms).
+/// When independent actions are calculated concurrently, such an action is calculated after all the actions
+/// that precede it in the input and before all the ones that follow it.
+  virtual bool checkModifiesSharedData()const {return false;}
+
+/// Check if the result of the action depends on the sequence of frames it has seen before (e.g. a bias that is
+/// deposited or a quantity that is accumulated along the trajectory).
+/// Such an action cannot be calculated on frames that are analysed out of order or by independent processes.
+/// Biases are assumed to be history dependent unless they say otherwise, and any other action that keeps a state
+/// between steps (e.g. in update()) must override this.
+  virtual bool checkIsHistoryDependent()const {return false;}
+
 /// Perform calculation using numerical derivatives
 /// N.B. only pass an ActionWithValue to this routine if you know exactly what you
 /// are doing.
@@ -360,6 +378,11 @@ const std::string & Action::getName()const {
   return name;
 }
 
+inline
+const std::string & Action::getDefinition()const {
+  return definition;
+}
+
 template<class T>
 void Action::parse(const std::string&key,T&t) {
   // Check keyword has been registered
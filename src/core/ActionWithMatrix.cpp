@@ -169,8 +169,8 @@ void ActionWithMatrix::runTask( const std::string& controller, const unsigned& c
   if( matrix_to_do_after ) matrix_to_do_after->runTask( controller, current, colno, myvals );
 }
 
-void ActionWithMatrix::gatherThreads( const unsigned& nt, const unsigned& bufsize, const std::vector<double>& omp_buffer, std::vector<double>& buffer, MultiValue& myvals ) {
-  ActionWithVector::gatherThreads( nt, bufsize, omp_buffer, buffer, myvals );
+void ActionWithMatrix::gatherThreads( MultiValue& myvals ) {
+  ActionWithVector::gatherThreads( myvals );
   for(unsigned i=0; i<matrix_bookeeping.size(); ++i) matrix_bookeeping[i] += myvals.getMatrixBookeeping()[i];
 }
 
@@ -227,7 +227,9 @@ bool ActionWithMatrix::checkForTaskForce( const unsigned& itask, const Value* my
 void ActionWithMatrix::gatherForcesOnStoredValue( const Value* myval, const unsigned& itask, const MultiValue& myvals, std::vector<double>& forces ) const {
   if( myval->getRank()==1 ) { ActionWithVector::gatherForcesOnStoredValue( myval, itask, myvals, forces ); return; }
   unsigned matind = myval->getPositionInMatrixStash();
-  for(unsigned j=0; j<forces.size(); ++j) forces[j] += myvals.getStashedMatrixForce( matind, j );
+  for(unsigned k=0; k<myvals.getNumberOfStashedMatrixForces( matind ); ++k) {
+    unsigned j = myvals.getStashedMatrixForceIndex( matind, k ); forces[j] += myvals.getStashedMatrixForce( matind, j );
+  }
 }
 
 void ActionWithMatrix::clearMatrixElements( MultiValue& myvals ) const {
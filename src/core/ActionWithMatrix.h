@@ -79,7 +79,7 @@ public:
 /// Gather a row of the matrix
   void gatherStoredValue( const unsigned& valindex, const unsigned& code, const MultiValue& myvals, const unsigned& bufstart, std::vector<double>& buffer ) const override;
 /// Gather all the data from the threads
-  void gatherThreads( const unsigned& nt, const unsigned& bufsize, const std::vector<double>& omp_buffer, std::vector<double>& buffer, MultiValue& myvals ) override ;
+  void gatherThreads( MultiValue& myvals ) override ;
 /// Gather all the data from the MPI processes
   void gatherProcesses( std::vector<double>& buffer ) override;
 /// This is the virtual that will do the calculation of the task for a particular matrix element
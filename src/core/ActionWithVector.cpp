@@ -46,6 +46,7 @@ ActionWithVector::ActionWithVector(const ActionOptions&ao):
   never_reduce_tasks(false),
   reduce_tasks(false),
   atomsWereRetrieved(false),
+  ntasks_run(0),
   done_in_chain(false)
 {
   if( keywords.exists("SERIAL") ) parseFlag("SERIAL",serial);
@@ -431,6 +432,7 @@ std::vector<unsigned>& ActionWithVector::getListOfActiveTasks( ActionWithVector*
 }
 
 void ActionWithVector::runAllTasks() {
+  ntasks_run=0;
 // Skip this if this is done elsewhere
   if( action_to_do_before ) return;
 
@@ -441,6 +443,7 @@ void ActionWithVector::runAllTasks() {
   // Get the list of active tasks
   std::vector<unsigned> & partialTaskList( getListOfActiveTasks( this ) );
   unsigned nactive_tasks=partialTaskList.size();
+  if( rank<nactive_tasks ) ntasks_run=(nactive_tasks-rank+stride-1)/stride;
 
   // Get number of threads for OpenMP
   unsigned nt=OpenMP::getNumThreads();
@@ -463,12 +466,14 @@ void ActionWithVector::runAllTasks() {
   unsigned nderivatives = 0; bool gridsInStream=checkForGrids(nderivatives);
   if( !doNotCalculateDerivatives() && !gridsInStream ) getNumberOfStreamedDerivatives( nderivatives, NULL );
 
+  // The copies of the buffer of the threads are summed block by block at the end
+  OpenMP::BufferReduction buffer_reduction( nt, buffer );
+  if( workspaces.size()<nt ) workspaces.resize( nt );
   #pragma omp parallel num_threads(nt)
   {
-    std::vector<double> omp_buffer;
-    if( nt>1 ) omp_buffer.resize( bufsize, 0.0 );
-    MultiValue myvals( nquants, nderivatives, nmatrices, maxcol, nbooks );
-    myvals.clearAll();
+    // with a single thread the data is accumulated directly in the buffer
+    std::vector<double> & omp_buffer( nt>1 ? buffer_reduction.getArray() : buffer );
+    MultiValue& myvals( getWorkspace( nquants, nderivatives, nmatrices, maxcol, nbooks ) );
 
     #pragma omp for nowait
     for(unsigned i=rank; i<nactive_tasks; i+=stride) {
@@ -476,14 +481,14 @@ void ActionWithVector::runAllTasks() {
       runTask( partialTaskList[i], myvals );
 
       // Now transfer the data to the actions that accumulate values from the calculated quantities
-      if( nt>1 ) gatherAccumulators( partialTaskList[i], myvals, omp_buffer );
-      else gatherAccumulators( partialTaskList[i], myvals, buffer );
+      gatherAccumulators( partialTaskList[i], myvals, omp_buffer );
 
       // Clear the value
       myvals.clearAll();
     }
+    if( nt>1 ) buffer_reduction.sum( buffer );
     #pragma omp critical
-    gatherThreads( nt, bufsize, omp_buffer, buffer, myvals );
+    gatherThreads( myvals );
   }
 
   // MPI Gather everything
@@ -491,12 +496,47 @@ void ActionWithVector::runAllTasks() {
   finishComputations( buffer );
 }
 
-void ActionWithVector::gatherThreads( const unsigned& nt, const unsigned& bufsize, const std::vector<double>& omp_buffer, std::vector<double>& buffer, MultiValue& myvals ) {
-  if( nt>1 ) for(unsigned i=0; i<bufsize; ++i) buffer[i]+=omp_buffer[i];
+MultiValue& ActionWithVector::getWorkspace( const unsigned& nquants, const unsigned& nder, const unsigned& nmat, const unsigned& maxcol, const unsigned& nbooks ) {
+  std::unique_ptr<MultiValue>& ws( workspaces[OpenMP::getThreadNum()] );
+  // The workspace is allocated by the thread that uses it
+  if( !ws ) ws=Tools::make_unique<MultiValue>( nquants, nder, nmat, maxcol, nbooks );
+  else ws->resize( nquants, nder, nmat, maxcol, nbooks );
+  ws->clearAll(); return *ws;
 }
 
 void ActionWithVector::gatherProcesses( std::vector<double>& buffer ) {
-  comm.Sum( buffer );
+  // Small buffers are summed in one go
+  constexpr unsigned blocksize=64;
+  const unsigned nblocks=(buffer.size()+blocksize-1)/blocksize;
+  if( nblocks<16 ) { comm.Sum( buffer ); return; }
+  // Find the blocks that are non zero on at least one process
+  std::vector<unsigned> populated( nblocks, 0 );
+  for(unsigned k=0; k<nblocks; ++k) {
+    const unsigned jend=std::min( static_cast<unsigned>(buffer.size()), (k+1)*blocksize );
+    for(unsigned j=k*blocksize; j<jend; ++j) {
+      if( buffer[j]!=0 ) { populated[k]=1; break; }
+    }
+  }
+  comm.Sum( populated );
+  unsigned npopulated=0;
+  for(unsigned k=0; k<nblocks; ++k) if( populated[k]>0 ) npopulated++;
+  // If most of the buffer is populated there is nothing to gain from packing it
+  if( 2*npopulated>nblocks ) { comm.Sum( buffer ); return; }
+  // Only the populated blocks are packed, summed and unpacked
+  std::vector<double> packed;
+  packed.reserve( npopulated*blocksize );
+  for(unsigned k=0; k<nblocks; ++k) {
+    if( populated[k]==0 ) continue;
+    const unsigned jend=std::min( static_cast<unsigned>(buffer.size()), (k+1)*blocksize );
+    packed.insert( packed.end(), buffer.begin()+k*blocksize, buffer.begin()+jend );
+  }
+  if( packed.size()>0 ) comm.Sum( packed );
+  unsigned p=0;
+  for(unsigned k=0; k<nblocks; ++k) {
+    if( populated[k]==0 ) continue;
+    const unsigned jend=std::min( static_cast<unsigned>(buffer.size()), (k+1)*blocksize );
+    for(unsigned j=k*blocksize; j<jend; ++j) buffer[j]=packed[p++];
+  }
 }
 
 bool ActionWithVector::checkForGrids( unsigned& nder ) const {
@@ -680,12 +720,12 @@ bool ActionWithVector::checkForForces() {
   // Clear force buffer
   forcesForApply.assign( forcesForApply.size(), 0.0 );
 
+  if( workspaces.size()<nt ) workspaces.resize( nt );
   #pragma omp parallel num_threads(nt)
   {
     std::vector<double> omp_forces;
     if( nt>1 ) omp_forces.resize( forcesForApply.size(), 0.0 );
-    MultiValue myvals( nquants, nderiv, nmatrices, maxcol, nbooks );
-    myvals.clearAll();
+    MultiValue& myvals( getWorkspace( nquants, nderiv, nmatrices, maxcol, nbooks ) );
 
     #pragma omp for nowait
     for(unsigned i=rank; i<nf_tasks; i+=stride) {
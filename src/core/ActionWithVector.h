@@ -26,6 +26,7 @@
 #include "ActionAtomistic.h"
 #include "ActionWithArguments.h"
 #include "tools/MultiValue.h"
+#include <memory>
 #include <vector>
 
 namespace PLMD {
@@ -43,6 +44,10 @@ private:
   std::vector<double> buffer;
 /// The list of active tasks
   std::vector<unsigned> active_tasks;
+/// The MultiValue used by each OpenMP thread. These are kept between calls so that their memory is reused
+  std::vector<std::unique_ptr<MultiValue> > workspaces;
+/// Get the cleared workspace of the calling thread, resized to hold the streamed quantities
+  MultiValue& getWorkspace( const unsigned& nquants, const unsigned& nder, const unsigned& nmat, const unsigned& maxcol, const unsigned& nbooks );
   /// Action that must be done before this one
   ActionWithVector* action_to_do_before;
 /// Actions that must be done after this one
@@ -89,6 +94,8 @@ private:
   bool reduce_tasks;
 /// Were the atoms retrieved in some earlier action
   bool atomsWereRetrieved;
+/// The number of tasks run on this process in the last call to runAllTasks
+  unsigned ntasks_run;
 /// This is used to build the argument store when we cannot use the chain
   unsigned reallyBuildArgumentStore( const unsigned& argstart );
 protected:
@@ -118,6 +125,8 @@ public:
   void unlockRequests() override;
   virtual void prepare() override;
   void retrieveAtoms( const bool& force=false ) override;
+/// Get the number of tasks run on this process in the last call to runAllTasks (zero if they are run by an earlier action in the chain)
+  unsigned getNumberOfTasksRun() const { return ntasks_run; }
   void calculateNumericalDerivatives(ActionWithValue* av) override;
 /// Are we running this command in a chain
   bool actionInChain() const ;
@@ -156,11 +165,11 @@ public:
   virtual void performTask( const unsigned& current, MultiValue& myvals ) const = 0;
 /// This is used to ensure that all indices are updated when you do local average
   virtual void updateAdditionalIndices( const unsigned& ostrn, MultiValue& myvals ) const {}
-/// Gather the data from all the OpenMP threads
-  virtual void gatherThreads( const unsigned& nt, const unsigned& bufsize, const std::vector<double>& omp_buffer, std::vector<double>& buffer, MultiValue& myvals );
+/// Gather the data that is not stored in the buffer from all the OpenMP threads. The buffers of the threads are summed in runAllTasks
+  virtual void gatherThreads( MultiValue& myvals ) {}
 /// Can be used to reduce the number of tasks that are performed when you use an ation from elsewhere
   virtual void switchTaskReduction( const bool& task_reduction, ActionWithVector* aselect ) {}
-/// Gather all the data from the MPI processes
+/// Gather all the data from the MPI processes. Only the parts of the buffer that are non zero on some process are summed
   virtual void gatherProcesses( std::vector<double>& buffer );
 /// Gather the values that we intend to store in the buffer
   virtual void gatherStoredValue( const unsigned& valindex, const unsigned& code, const MultiValue& myvals, const unsigned& bufstart, std::vector<double>& buffer ) const ;
@@ -21,9 +21,15 @@
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "GREX.h"
 #include "PlumedMain.h"
+#include "ActionSet.h"
+#include "ActionWithArguments.h"
+#include "ActionWithVector.h"
 #include "tools/Tools.h"
 #include "tools/Communicator.h"
+#include <algorithm>
+#include <functional>
 #include <sstream>
+#include <unordered_map>
 
 namespace PLMD {
 
@@ -35,7 +41,9 @@ GREX::GREX(PlumedMain&p):
   foreignDeltaBias(0),
   localUNow(0),
   localUSwap(0),
-  myreplica(-1) // = unset
+  myreplica(-1), // = unset
+  argumentsExchangeable(false),
+  argumentsSignature(0)
 {
   p.setSuffix(".NA");
 }
@@ -184,24 +192,121 @@ void GREX::savePositions() {
   std::ostringstream o;
   plumedMain.writeBinary(o);
   buffer=o.str();
+  saveArguments();
+}
+
+void GREX::saveArguments() {
+  argumentsExchangeable=false;
+  argumentsSignature=0;
+  argumentsBuffer.clear();
+  exchangedArguments.clear();
+  recalculatedActions.clear();
+  if(!plumedMain.getExchangeArguments()) return;
+
+  const ActionSet & actionSet(plumedMain.getActionSet());
+  std::unordered_map<const Action*,unsigned> position;
+  for(unsigned i=0; i<actionSet.size(); i++) position[actionSet[i].get()]=i;
+// these actions only depend on their scalar arguments, and can be recalculated on the arguments of the partner
+  auto recalculable=[](Action* p) {
+    return p->castToActionWithArguments() && !p->castToActionAtomistic() && !dynamic_cast<ActionWithVector*>(p);
+  };
+  std::vector<bool> recalculate(actionSet.size(),false);
+  std::vector<bool> upstream(actionSet.size(),false);
+// start from the actions that contribute to the bias
+  for(unsigned i=0; i<actionSet.size(); i++) {
+    Action* p=actionSet[i].get();
+    ActionWithValue* av=p->castToActionWithValue();
+    if(!p->isActive() || !av || !av->exists(p->getLabel()+".bias")) continue;
+    if(!recalculable(p)) return;
+    recalculate[i]=true;
+  }
+// dependencies always come earlier in the input, so that a single backward loop is enough
+  for(unsigned i=actionSet.size(); i>0; i--) {
+    Action* p=actionSet[i-1].get();
+    if(recalculate[i-1]) {
+      const auto & args(p->castToActionWithArguments()->getArguments());
+      for(const auto & d : p->getDependencies()) {
+        if(recalculable(d)) {
+          recalculate[position[d]]=true;
+          continue;
+        }
+// the other dependencies should provide arguments, whose values are exchanged
+        bool provides=false;
+        for(const auto & a : args) {
+          if(a->getPntrToAction()!=d->castToActionWithValue()) continue;
+          if(a->getRank()>1) return;
+          provides=true;
+          if(std::find(exchangedArguments.begin(),exchangedArguments.end(),a)==exchangedArguments.end()) exchangedArguments.push_back(a);
+        }
+        if(!provides) return;
+        upstream[position[d]]=true;
+      }
+    }
+    if(upstream[i-1]) {
+      for(const auto & d : p->getDependencies()) upstream[position[d]]=true;
+    }
+  }
+  if(exchangedArguments.empty()) return;
+
+// the arguments can only be exchanged if they are computed in the same way on the partner.
+// Actions modifying the positions (e.g. WHOLEMOLECULES) change the arguments without being among their dependencies
+  std::string signature;
+  for(unsigned i=0; i<actionSet.size(); i++) {
+    if(upstream[i] || actionSet[i]->checkModifiesSharedData()) signature+=actionSet[i]->getDefinition()+"\n";
+    if(recalculate[i]) recalculatedActions.push_back(actionSet[i].get());
+  }
+  for(const auto & a : exchangedArguments) {
+    signature+=a->getName()+" "+std::to_string(a->getNumberOfValues())+"\n";
+    for(unsigned j=0; j<a->getNumberOfValues(); j++) argumentsBuffer.push_back(a->get(j));
+  }
+  argumentsSignature=std::hash<std::string>()(signature);
+  argumentsExchangeable=true;
 }
 
 void GREX::calculate() {
-  unsigned nn=buffer.size();
-  std::vector<char> rbuf(nn);
   localDeltaBias=-plumedMain.getBias();
+// both replicas should be able to exchange the same arguments, otherwise the positions are exchanged
+  std::vector<unsigned long long> localSignature(2),partnerSignature(2);
+  localSignature[0]=argumentsExchangeable;
+  localSignature[1]=argumentsSignature;
   if(intracomm.Get_rank()==0) {
-    Communicator::Request req=intercomm.Isend(buffer,partner,1066);
-    intercomm.Recv(rbuf,partner,1066);
+    Communicator::Request req=intercomm.Isend(localSignature,partner,1068);
+    intercomm.Recv(partnerSignature,partner,1068);
     req.wait();
   }
-  intracomm.Bcast(rbuf,0);
-  std::istringstream i(std::string(&rbuf[0],rbuf.size()));
-  plumedMain.readBinary(i);
-  plumedMain.setExchangeStep(true);
-  plumedMain.prepareDependencies();
-  plumedMain.justCalculate();
-  plumedMain.setExchangeStep(false);
+  intracomm.Bcast(partnerSignature,0);
+  if(localSignature[0] && partnerSignature[0] && localSignature[1]==partnerSignature[1]) {
+    std::vector<double> rbuf(argumentsBuffer.size());
+    if(intracomm.Get_rank()==0) {
+      Communicator::Request req=intercomm.Isend(argumentsBuffer,partner,1069);
+      intercomm.Recv(rbuf,partner,1069);
+      req.wait();
+    }
+    intracomm.Bcast(rbuf,0);
+    unsigned k=0;
+    for(const auto & a : exchangedArguments) {
+      for(unsigned j=0; j<a->getNumberOfValues(); j++) a->set(j,rbuf[k++]);
+    }
+    plumedMain.setExchangeStep(true);
+    plumedMain.prepareDependencies();
+    plumedMain.justCalculate(recalculatedActions);
+    plumedMain.setExchangeStep(false);
+  } else {
+    unsigned nn=buffer.size();
+    std::vector<char> rbuf(nn);
+    if(intracomm.Get_rank()==0) {
+      Communicator::Request req=intercomm.Isend(buffer,partner,1066);
+      intercomm.Recv(rbuf,partner,1066);
+      req.wait();
+    }
+    intracomm.Bcast(rbuf,0);
+    std::istringstream i(std::string(&rbuf[0],rbuf.size()));
+    plumedMain.readBinary(i);
+    plumedMain.setExchangeStep(true);
+    plumedMain.prepareDependencies();
+    plumedMain.justCalculate();
+    plumedMain.setExchangeStep(false);
+  }
   localDeltaBias+=plumedMain.getBias();
   localDeltaBias+=localUSwap-localUNow;
   if(intracomm.Get_rank()==0) {
@@ -31,6 +31,8 @@ namespace PLMD {
 
 class PlumedMain;
 class Communicator;
+class Action;
+class Value;
 
 class GREX:
   public WithCmd
@@ -49,6 +51,18 @@ class GREX:
   std::vector<double> allDeltaBias;
   std::string buffer;
   int myreplica;
+/// True if the arguments of the biases can be exchanged instead of the positions
+  bool argumentsExchangeable;
+/// Signature of the part of the input that computes the exchanged arguments
+  unsigned long long argumentsSignature;
+/// The values of the exchanged arguments
+  std::vector<double> argumentsBuffer;
+/// The exchanged arguments
+  std::vector<Value*> exchangedArguments;
+/// The actions that are recalculated on the arguments of the partner
+  std::vector<Action*> recalculatedActions;
+/// Find the arguments to exchange and save their values
+  void saveArguments();
 public:
   explicit GREX(PlumedMain&);
   ~GREX();
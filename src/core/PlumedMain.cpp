@@ -26,6 +26,7 @@
 #include "ActionRegister.h"
 #include "ActionSet.h"
 #include "ActionWithValue.h"
+#include "ActionWithVector.h"
 #include "ActionWithVirtualAtom.h"
 #include "ActionToGetData.h"
 #include "ActionToPutData.h"
@@ -39,11 +40,13 @@
 #include "tools/DLLoader.h"
 #include "tools/Exception.h"
 #include "tools/IFile.h"
+#include "tools/OFile.h"
 #include "tools/Log.h"
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
 #include "tools/TypesafePtr.h"
+#include "tools/ThreadPool.h"
 #include "lepton/Exception.h"
 #include "DataPassingTools.h"
 #include "small_vector/small_vector.h"
@@ -67,6 +70,8 @@
 #include <optional>
 #include <variant>
 #include <filesystem>
+#include <chrono>
+#include <sstream>
 
 namespace PLMD {
 
@@ -267,7 +272,14 @@ PlumedMain::PlumedMain():
 }
 
 // destructor needed to delete forward declarated objects
+/// Calculation running on a helper thread, see startCalc()
+struct PlumedMain::AsyncCalculation {
+  std::future<void> future;
+};
+
 PlumedMain::~PlumedMain() {
+// do not leave a helper thread running on a destroyed object
+  if(asyncCalc) asyncCalc->future.wait();
   CountInstances::decrease();
 }
 
@@ -386,6 +398,11 @@ void PlumedMain::cmd(std::string_view word,const TypesafePtr & val) {
         CHECK_INIT(initialized,word);
         performCalc();
         break;
+      /* ADDED WITH API==10 */
+      case cmd_startCalc:
+        CHECK_INIT(initialized,word);
+        startCalc();
+        break;
       case cmd_performCalcNoUpdate:
         CHECK_INIT(initialized,word);
         performCalcNoUpdate();
@@ -549,7 +566,7 @@ void PlumedMain::cmd(std::string_view word,const TypesafePtr & val) {
           DomainDecomposition* dd=pp->castToDomainDecomposition();
           if ( dd ) natoms.push_back( dd->getNumberOfAtoms() );
         }
-        actionSet.clearDelete(); inputs.clear();
+        actionSet.clearDelete(); inputs.clear(); actionCounterMap.clear();
         for(unsigned i=0; i<natoms.size(); ++i) {
           std::string str_natoms; Tools::convert( natoms[i], str_natoms );
           readInputLine( MDEngine + ": DOMAIN_DECOMPOSITION NATOMS=" + str_natoms +
@@ -817,6 +834,32 @@ void PlumedMain::cmd(std::string_view word,const TypesafePtr & val) {
           if( p->getLabel()==words[1] && p->isActive() ) { val.set(int(1)); break; }
         }
         break;
+      /* ADDED WITH API==10 */
+      case cmd_setNumActionThreads:
+        CHECK_NOTNULL(val,word);
+        actionThreads=val.get<unsigned>();
+        if(actionThreads==0) actionThreads=1;
+        break;
+      case cmd_setActionCounters:
+        CHECK_NOTNULL(val,word);
+        actionCounters=val.get<int>()!=0;
+        break;
+      case cmd_resetActionCounters:
+        resetActionCounters();
+        break;
+      case cmd_getTimingReportSize:
+        CHECK_NOTNULL(val,word);
+        val.set(int(getTimingReport().size()+1));
+        break;
+      case cmd_getTimingReport:
+      {
+        CHECK_NOTNULL(val,word);
+        const auto report=getTimingReport();
+        auto ptr=val.get<char*>(report.size()+1);
+        std::copy(report.begin(),report.end(),ptr);
+        ptr[report.size()]=0;
+      }
+      break;
       case cmd_GREX:
         if(!grex) grex=Tools::make_unique<GREX>(*this);
         plumed_massert(grex,"error allocating grex");
@@ -888,6 +931,8 @@ void PlumedMain::init() {
   log.printf("Running over %d %s\n",comm.Get_size(),(comm.Get_size()>1?"nodes":"node"));
   log<<"Number of threads: "<<OpenMP::getNumThreads()<<"\n";
   log<<"Cache line size: "<<OpenMP::getCachelineSize()<<"\n";
+  if(actionThreads==1 && std::getenv("PLUMED_NUM_ACTION_THREADS")) Tools::convert(std::getenv("PLUMED_NUM_ACTION_THREADS"),actionThreads);
+  if(actionThreads>1) log<<"Number of threads for independent actions: "<<actionThreads<<"\n";
   for(const auto & pp : inputs ) {
     plumed_assert(pp);
     DomainDecomposition* dd=pp->castToDomainDecomposition();
@@ -1092,25 +1137,65 @@ void PlumedMain::shareData() {
 }
 
 void PlumedMain::performCalcNoUpdate() {
-  waitData();
-  justCalculate();
+  waitCalculation();
   backwardPropagate();
   resetInputs();
 }
 
 void PlumedMain::performCalcNoForces() {
-  waitData();
-  justCalculate();
+  waitCalculation();
 }
 
 void PlumedMain::performCalc() {
-  waitData();
-  justCalculate();
+  waitCalculation();
   backwardPropagate();
   update();
   resetInputs();
 }
 
+bool PlumedMain::canCalculateAsynchronously() {
+  std::string reason;
+  if(comm.Get_size()>1) reason="the calculation is distributed with MPI";
+  else if(multi_sim_comm.Get_size()>1) reason="multiple replicas are used";
+  else if(name_of_energy!="" && actionSet.selectWithLabel<ActionToPutData*>(name_of_energy)->isActive()) reason="the energy is needed";
+  else for(const auto & ip : inputs) {
+      if(ip->isActive() && !ip->hasBeenSet()) {
+        reason="input "+ip->getLabel()+" has not been set";
+        break;
+      }
+    }
+  if(reason.empty()) return true;
+  if(!asyncCalcWarned) {
+    log<<"Calculation cannot be started asynchronously because "<<reason<<", it will be done when forces are requested\n";
+    asyncCalcWarned=true;
+  }
+  return false;
+}
+
+void PlumedMain::startCalc() {
+  if(!active) return;
+  plumed_massert(!asyncCalc,"startCalc should be followed by performCalc, performCalcNoUpdate or performCalcNoForces");
+  if(!canCalculateAsynchronously()) return;
+  waitData();
+// the helper thread does not use the stopwatch, which is not thread safe
+  auto calc=std::make_unique<AsyncCalculation>();
+  calc->future=std::async(std::launch::async,[this]() { forwardLoop(false); });
+  asyncCalc=std::move(calc);
+}
+
+void PlumedMain::waitCalculation() {
+  if(asyncCalc) {
+// Stopwatch is stopped when sw goes out of scope
+    auto sw=stopwatch.startStop("4 Calculating (forward loop)");
+    auto calc=std::move(asyncCalc);
+// this rethrows exceptions raised on the helper thread
+    calc->future.get();
+  } else {
+    waitData();
+    justCalculate();
+  }
+}
+
 void PlumedMain::waitData() {
   if(!active)return;
 // Stopwatch is stopped when sw goes out of scope
@@ -1123,10 +1208,35 @@ void PlumedMain::waitData() {
 
 void PlumedMain::justCalculate() {
   if(!active)return;
+// Stopwatch is stopped when sw goes out of scope
+  auto sw=stopwatch.startStop("4 Calculating (forward loop)");
+  forwardLoop(detailedTimers);
+}
+
+void PlumedMain::justCalculate(const std::vector<Action*>& actions) {
+  if(!active)return;
 // Stopwatch is stopped when sw goes out of scope
   auto sw=stopwatch.startStop("4 Calculating (forward loop)");
   bias=0.0;
   work=0.0;
+  for(const auto & p : actions) {
+    try {
+      if(!p->isActive()) continue;
+      if(!calculateAction(p,false)) continue;
+      ActionWithValue*av=p->castToActionWithValue();
+      if(av) {
+        bias+=av->getOutputQuantity("bias");
+        work+=av->getOutputQuantity("work");
+      }
+    } catch(...) {
+      plumed_error_nested() << "An error happened while calculating " << p->getLabel();
+    }
+  }
+}
+
+void PlumedMain::forwardLoop(bool timers) {
+  bias=0.0;
+  work=0.0;
 
   // Check the input actions to determine if we need to calculate constants that
   // depend on masses and charges
@@ -1136,6 +1246,8 @@ void PlumedMain::justCalculate() {
   }
   if( firststep ) { for(const auto & ip : inputs) ip->firststep=false; }
 
+  if(actionThreads>1 && !timers && forwardLoopConcurrent(firststep)) return;
+
   int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
   for(const auto & pp : actionSet) {
@@ -1146,35 +1258,20 @@ void PlumedMain::justCalculate() {
 // Stopwatch is stopped when sw goes out of scope.
 // We explicitly declare a Stopwatch::Handler here to allow for conditional initialization.
         Stopwatch::Handler sw;
-        if(detailedTimers) {
+        if(timers) {
           auto actionNumberLabel=std::to_string(iaction);
           const unsigned m=actionSet.size();
           unsigned k=0; unsigned n=1; while(n<m) { n*=10; k++; }
           auto spaces=std::string(k-actionNumberLabel.length(),' ');
           sw=stopwatch.startStop("4A " + spaces + actionNumberLabel+" "+p->getLabel());
         }
-        ActionWithValue*av=p->castToActionWithValue();
-        ActionAtomistic*aa=p->castToActionAtomistic();
-        {
-          if(av) av->clearInputForces();
-          if(av) av->clearDerivatives();
-          if( av && av->calculateOnUpdate() ) continue ;
-        }
-        {
-          if(aa) if(aa->isActive()) aa->retrieveAtoms();
-        }
-        if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
-        else p->calculate();
+        if(!calculateAction(p,firststep)) continue;
         // This retrieves components called bias
+        ActionWithValue*av=p->castToActionWithValue();
         if(av) {
           bias+=av->getOutputQuantity("bias");
           work+=av->getOutputQuantity("work");
-          av->setGradientsIfNeeded();
         }
-        // This makes all values that depend on the (fixed) masses and charges constant
-        if( firststep ) p->setupConstantValues( true );
-        ActionWithVirtualAtom*avv=p->castToActionWithVirtualAtom();
-        if(avv)avv->setGradientsIfNeeded();
       }
     } catch(...) {
       plumed_error_nested() << "An error happened while calculating " << p->getLabel();
@@ -1183,6 +1280,138 @@ void PlumedMain::justCalculate() {
   }
 }
 
+bool PlumedMain::calculateAction(Action* p,bool firststep) {
+  ActionWithValue*av=p->castToActionWithValue();
+  ActionAtomistic*aa=p->castToActionAtomistic();
+  {
+    if(av) av->clearInputForces();
+    if(av) av->clearDerivatives();
+    if( av && av->calculateOnUpdate() ) return false;
+  }
+  {
+    if(aa) if(aa->isActive()) aa->retrieveAtoms();
+  }
+  std::chrono::steady_clock::time_point start;
+  if(actionCounters) start=std::chrono::steady_clock::now();
+  if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
+  else p->calculate();
+  if(actionCounters) {
+    auto & counter(actionCounterMap[p]);
+    counter.calls++;
+    counter.calculateTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+    if(aa) counter.atoms+=aa->getNumberOfAtoms();
+    if(auto avec=dynamic_cast<ActionWithVector*>(p)) counter.tasks+=avec->getNumberOfTasksRun();
+    if(av) for(int i=0; i<av->getNumberOfComponents(); i++) {
+        const Value* v=av->copyOutput(i);
+        if(v->hasDerivatives()) counter.derivatives+=static_cast<unsigned long long>(v->getNumberOfValues())*v->getNumberOfDerivatives();
+      }
+  }
+  if(av) av->setGradientsIfNeeded();
+  // This makes all values that depend on the (fixed) masses and charges constant
+  if( firststep ) p->setupConstantValues( true );
+  ActionWithVirtualAtom*avv=p->castToActionWithVirtualAtom();
+  if(avv)avv->setGradientsIfNeeded();
+  return true;
+}
+
+bool PlumedMain::forwardLoopConcurrent(bool firststep) {
+// actions doing collective communications should be called in the same order on all processes
+  if(comm.Get_size()>1 || multi_sim_comm.Get_size()>1) return false;
+
+// Actions are grouped so that the ones belonging to the same chain are calculated by the same thread,
+// since the first action of a chain calculates the values of all the others.
+// Each group is calculated after the groups containing the actions its members depend on.
+  std::vector<std::vector<unsigned>> groups;
+  std::unordered_map<const Action*,unsigned> groupOf;
+  for(unsigned i=0; i<actionSet.size(); i++) {
+    Action* p=actionSet[i].get();
+    if(!p->isActive()) continue;
+    const Action* head=p;
+    auto avec=dynamic_cast<ActionWithVector*>(p);
+    if(avec && avec->actionInChain()) head=avec->getFirstActionInChain();
+    auto it=groupOf.find(head);
+    unsigned g;
+    if(it!=groupOf.end()) g=it->second;
+    else {
+      g=groups.size();
+      groups.emplace_back();
+      groupOf[head]=g;
+    }
+    groupOf[p]=g;
+    groups[g].push_back(i);
+  }
+  std::vector<std::vector<unsigned>> deps(groups.size());
+// groups containing actions that modify shared data are calculated in input order with respect to all the other groups
+  unsigned lastBarrier=0;
+  bool hasBarrier=false;
+  for(unsigned g=0; g<groups.size(); g++) {
+    bool barrier=false;
+    for(auto i : groups[g]) {
+      if(actionSet[i]->checkModifiesSharedData()) barrier=true;
+      for(const auto & d : actionSet[i]->getDependencies()) {
+        auto it=groupOf.find(d);
+        if(it==groupOf.end() || it->second==g) continue;
+        if(std::find(deps[g].begin(),deps[g].end(),it->second)==deps[g].end()) deps[g].push_back(it->second);
+      }
+    }
+    if(barrier) {
+      for(unsigned h=(hasBarrier?lastBarrier:0); h<g; h++) if(std::find(deps[g].begin(),deps[g].end(),h)==deps[g].end()) deps[g].push_back(h);
+      lastBarrier=g;
+      hasBarrier=true;
+    } else if(hasBarrier && std::find(deps[g].begin(),deps[g].end(),lastBarrier)==deps[g].end()) {
+      deps[g].push_back(lastBarrier);
+    }
+  }
+  if(!ThreadPool::isAcyclic(deps)) return false;
+
+  if(!actionThreadPool || actionThreadPool->getNumThreads()!=actionThreads) actionThreadPool=Tools::make_unique<ThreadPool>(actionThreads);
+// counters are created here so that the map is not modified concurrently
+  if(actionCounters) for(const auto & gr : groups) for(auto i : gr) actionCounterMap[actionSet[i].get()];
+
+  std::vector<char> calculated(actionSet.size(),0);
+  std::vector<std::exception_ptr> errors;
+  actionThreadPool->runGraph(deps,[&](unsigned g) {
+    for(auto i : groups[g]) {
+      Action* p=actionSet[i].get();
+      try {
+        calculated[i]=calculateAction(p,firststep);
+      } catch(...) {
+        plumed_error_nested() << "An error happened while calculating " << p->getLabel();
+      }
+    }
+  },errors);
+  for(const auto & e : errors) if(e) std::rethrow_exception(e);
+
+// the bias is accumulated in input order so that the result does not depend on the number of threads
+  for(unsigned i=0; i<actionSet.size(); i++) {
+    if(!calculated[i]) continue;
+    ActionWithValue*av=actionSet[i]->castToActionWithValue();
+    if(av) {
+      bias+=av->getOutputQuantity("bias");
+      work+=av->getOutputQuantity("work");
+    }
+  }
+  return true;
+}
+
+std::string PlumedMain::getTimingReport() {
+  std::ostringstream ostr;
+  ostr<<"#! FIELDS action calls calculate_ns apply_ns tasks atoms derivatives update_ns\n";
+  ostr<<"#! SET step "<<getStep()<<"\n";
+  for(const auto & p : actionSet) {
+    const auto it=actionCounterMap.find(p.get());
+    if(it==actionCounterMap.end()) continue;
+    const auto & c(it->second);
+    ostr<<p->getLabel()<<" "<<c.calls<<" "<<c.calculateTime<<" "<<c.applyTime<<" "
+        <<c.tasks<<" "<<c.atoms<<" "<<c.derivatives<<" "<<c.updateTime<<"\n";
+  }
+  return ostr.str();
+}
+
+void PlumedMain::resetActionCounters() {
+  actionCounterMap.clear();
+}
+
 void PlumedMain::justApply() {
   backwardPropagate();
   update();
@@ -1210,7 +1439,13 @@ void PlumedMain::backwardPropagate() {
         sw=stopwatch.startStop("5A " + spaces + actionNumberLabel+" "+p->getLabel());
       }
 
-      p->apply();
+      if(actionCounters) {
+        auto start=std::chrono::steady_clock::now();
+        p->apply();
+        actionCounterMap[p].applyTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+      } else {
+        p->apply();
+      }
     }
     iaction++;
   }
@@ -1233,8 +1468,11 @@ void PlumedMain::update() {
     p->beforeUpdate();
     if(p->isActive() && p->checkUpdate() && updateFlagsTop()) {
       ActionWithValue* av=dynamic_cast<ActionWithValue*>(p.get());
+      std::chrono::steady_clock::time_point start;
+      if(actionCounters) start=std::chrono::steady_clock::now();
       if( av && av->calculateOnUpdate() ) { p->prepare(); p->calculate(); }
       else p->update();
+      if(actionCounters) actionCounterMap[p.get()].updateTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
     }
   }
   while(!updateFlags.empty()) updateFlags.pop();
@@ -1349,6 +1587,17 @@ void PlumedMain::fflush() {
   }
 }
 
+std::vector<std::string> PlumedMain::getOutputFilePaths()const {
+  std::vector<std::string> paths;
+  for(const auto & p : files) {
+    auto ofile=dynamic_cast<OFile*>(p);
+    if(ofile && ofile->isOpen()) paths.push_back(ofile->getPath());
+  }
+  std::sort(paths.begin(),paths.end());
+  paths.erase(std::unique(paths.begin(),paths.end()),paths.end());
+  return paths;
+}
+
 void PlumedMain::insertFile(FileBase&f) {
   files.insert(&f);
 }
@@ -31,6 +31,7 @@
 #include <stack>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <atomic>
 
 // !!!!!!!!!!!!!!!!!!!!!!    DANGER   !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!11
@@ -53,6 +54,7 @@ namespace PLMD {
 
 
 
+class Action;
 class ActionAtomistic;
 class ActionPilot;
 class ActionForInterface;
@@ -66,6 +68,7 @@ class Citations;
 class ExchangePatterns;
 class FileBase;
 class TypesafePtr;
+class ThreadPool;
 class IFile;
 class Units;
 class Keywords;
@@ -212,9 +215,13 @@ private:
 
 /// Set to true if on an exchange step
   bool exchangeStep=false;
+/// Set to true if GREX should exchange the arguments of the biases rather than the positions
+  bool exchangeArguments=false;
 
 /// Flag for restart
   bool restart=false;
+/// Flag for writing the output files on a background thread
+  bool asyncOutput=false;
 
 /// Flag for checkpointig
   bool doCheckPoint=false;
@@ -240,6 +247,50 @@ public:
   TypesafePtr& stopFlag=*stopFlag_fwd;
   bool stopNow=false;
 
+/// Counters accumulated for each action when actionCounters is set
+  struct ActionCounter {
+/// Number of times the action has been calculated
+    unsigned long long calls=0;
+/// Wall time spent in calculate (ns)
+    long long int calculateTime=0;
+/// Wall time spent in apply (ns)
+    long long int applyTime=0;
+/// Wall time spent in update (ns)
+    long long int updateTime=0;
+/// Number of tasks run on this process
+    unsigned long long tasks=0;
+/// Number of atoms requested
+    unsigned long long atoms=0;
+/// Number of derivatives stored in the output values
+    unsigned long long derivatives=0;
+  };
+
+/// Calculation running on a helper thread, see startCalc()
+  struct AsyncCalculation;
+  std::unique_ptr<AsyncCalculation> asyncCalc;
+
+/// Set once the reason for not running asynchronously has been written in the log
+  bool asyncCalcWarned=false;
+
+/// The forward loop on active actions, without the global timer
+  void forwardLoop(bool timers);
+
+/// Calculate a single action in the forward loop. Returns false if it is calculated on update.
+  bool calculateAction(Action* p,bool firststep);
+
+/// Calculate the active actions on actionThreadPool, running concurrently the ones that do not depend on each other.
+/// Returns false if this is not possible, in which case nothing has been calculated.
+  bool forwardLoopConcurrent(bool firststep);
+
+/// Number of threads used to calculate independent actions concurrently
+  unsigned actionThreads=1;
+
+/// Pool of threads used to calculate independent actions concurrently
+  std::unique_ptr<ThreadPool> actionThreadPool;
+
+/// Per-action counters, see actionCounters
+  std::unordered_map<const Action*,ActionCounter> actionCounterMap;
+
 /// Stack for update flags.
 /// Store information used in class \ref generic::UpdateIf
   std::stack<bool> updateFlags;
@@ -263,6 +314,15 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers=false;
 
+/// Flag to switch on the per-action counters reported by getTimingReport()
+  bool actionCounters=false;
+
+/// Get a table with the per-action counters, one line per action
+  std::string getTimingReport();
+
+/// Reset the per-action counters
+  void resetActionCounters();
+
 /// GpuDevice Identifier
   int gpuDeviceId=-1;
 
@@ -385,6 +445,23 @@ public:
     Shortcut for: waitData() + justCalculate()
   */
   void performCalcNoForces();
+  /**
+    Start the calculation on a helper thread.
+    Waits for the data shared with shareData() and runs justCalculate() on a helper thread,
+    so that the MD code can compute its own forces in the meanwhile.
+    Forces are only applied by the following call to performCalc(), performCalcNoUpdate() or performCalcNoForces(),
+    which wait for the helper thread to complete. No other method should be called in between.
+    If the calculation cannot be overlapped (see canCalculateAsynchronously()), this does nothing
+    and the whole calculation is done later.
+  */
+  void startCalc();
+  /**
+    Check if the forward loop can be run on a helper thread.
+    This is not possible if the calculation is distributed with MPI, if the energy is needed
+    (since it is computed by the MD code together with the forces), or if some of the requested
+    data has not been shared yet.
+  */
+  bool canCalculateAsynchronously();
   /**
     Complete PLUMED calculation.
     Shortcut for prepareCalc() + performCalc()
@@ -400,6 +477,15 @@ public:
     Perform the forward loop on active actions.
   */
   void justCalculate();
+  /**
+    Perform the forward loop only on the listed actions that are active.
+    The bias is computed from these actions only.
+  */
+  void justCalculate(const std::vector<Action*>& actions);
+  /**
+    Complete the calculation started by startCalc(), or do waitData() + justCalculate() if it was not started.
+  */
+  void waitCalculation();
   /**
     Backward propagate and update.
     Shortcut for backwardPropagate() + update()
@@ -455,16 +541,26 @@ public:
   void eraseFile(FileBase&);
 /// Flush all files
   void fflush();
+/// Get the paths of the output files that are currently open
+  std::vector<std::string> getOutputFilePaths()const;
 /// Check if restarting
   bool getRestart()const;
 /// Set restart flag
   void setRestart(bool f) {if(!doParseOnly) restart=f;}
+/// Check if output files are written on a background thread
+  bool getAsyncOutput()const {return asyncOutput;}
+/// Write the output files opened from now on on a background thread
+  void setAsyncOutput(bool f) {asyncOutput=f;}
 /// Check if checkpointing
   bool getCPT()const;
 /// Set exchangeStep flag
   void setExchangeStep(bool f);
 /// Get exchangeStep flag
   bool getExchangeStep()const;
+/// Check if GREX should exchange the arguments of the biases rather than the positions
+  bool getExchangeArguments()const {return exchangeArguments;}
+/// Let GREX exchange the arguments of the biases rather than the positions when possible
+  void setExchangeArguments(bool f) {exchangeArguments=f;}
 /// Stop the calculation cleanly (both the MD code and plumed)
   void stop();
 /// Enforce active flag.
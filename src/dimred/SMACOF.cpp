@@ -20,6 +20,7 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "SMACOF.h"
+#include "tools/OpenMP.h"
 
 namespace PLMD {
 namespace dimred {
@@ -41,46 +42,88 @@ void SMACOF::optimize( const double& tol, const unsigned& maxloops, std::vector<
     for(unsigned j=0; j<nlow; ++j) { Z(i,j)=proj[k]; k++; }
   }
 
-  // Calculate V
-  Matrix<double> V(M,M);
+  // The Guttman transform multiplies B(Z)Z by the pseudo-inverse of V.  The rows of V sum to zero.  If V has no other null vectors
+  // adding 1/M to all its elements gives a non-singular matrix.  The inverse of this matrix acts on B(Z)Z, which is orthogonal to the
+  // vector of ones, in the same way as the pseudo-inverse of V.  We thus do an LU factorisation of this matrix, which is much cheaper
+  // than the singular value decomposition that is required to compute the pseudo-inverse.
+  int nrow=M, info; std::vector<int> ipiv(M); std::vector<double> lu(M*M);
   for(unsigned i=0; i<M; ++i) {
+    double vii=0;
     for(unsigned j=0; j<M; ++j) {
       if(i==j) continue;
-      V(i,j)=-Weights(i,j);
+      lu[M*j+i] = -Weights(i,j) + 1.0/M; vii += Weights(i,j);
     }
-    for(unsigned j=0; j<M; ++j) {
-      if(i==j)continue;
-      V(i,i)-=V(i,j);
+    lu[M*i+i] = vii + 1.0/M;
+  }
+  plumed_lapack_dgetrf(&nrow,&nrow,lu.data(),&nrow,ipiv.data(),&info);
+  if( info==0 ) {
+    // Check for very small pivots, which would indicate that V has more than one null vector
+    double maxpiv=0, minpiv=fabs(lu[0]);
+    for(unsigned i=0; i<M; ++i) { double piv=fabs(lu[M*i+i]); if( piv>maxpiv ) maxpiv=piv; if( piv<minpiv ) minpiv=piv; }
+    if( minpiv<M*epsilon*maxpiv ) info=1;
+  }
+  // Calculate the pseudo-inverse of V if the factorisation failed
+  Matrix<double> mypseudo;
+  if( info!=0 ) {
+    lu.resize(0); Matrix<double> V(M,M);
+    for(unsigned i=0; i<M; ++i) {
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j) continue;
+        V(i,j)=-Weights(i,j);
+      }
+      for(unsigned j=0; j<M; ++j) {
+        if(i==j)continue;
+        V(i,i)-=V(i,j);
+      }
     }
+    mypseudo.resize(M, M); pseudoInvert(V, mypseudo);
   }
-  // And pseudo invert V
-  Matrix<double> mypseudo(M, M); pseudoInvert(V, mypseudo);
-  Matrix<double> dists( M, M ); double myfirstsig = calculateSigma( Z, dists );
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt*10>M ) nt=M/10;
+  if( nt==0 ) nt=1;
+  double myfirstsig = calculateSigma( Z, nt );
 
   // initial sigma is made up of the original distances minus the distances between the projections all squared.
-  Matrix<double> temp( M, M ), BZ( M, M ), newZ( M, nlow );
+  Matrix<double> BZ( M, nlow ), newZ( M, nlow );
   for(unsigned n=0; n<maxloops; ++n) {
     if(n==maxloops-1) plumed_merror("ran out of steps in SMACOF algorithm");
 
-    // Recompute BZ matrix
+    // Compute the product of the B(Z) matrix and Z.  The diagonal elements of B(Z) are minus the sum of the off diagonal elements
+    // (Equation 8.25) so row i of the product is a sum of the differences between the projection of point i and the other projections.
+    // B(Z) is thus never stored, which saves memory and reduces the cost of an iteration from O(M^3) to O(M^2)
+    #pragma omp parallel for num_threads(nt)
     for(unsigned i=0; i<M; ++i) {
+      for(unsigned l=0; l<nlow; ++l) BZ(i,l)=0;
       for(unsigned j=0; j<M; ++j) {
         if(i==j) continue;  //skips over the diagonal elements
-
-        if( dists(i,j)>0 ) BZ(i,j) = -Weights(i,j)*Distances(i,j) / dists(i,j);
-        else BZ(i,j)=0.;
+        double dlow=0; for(unsigned l=0; l<nlow; ++l) { double tmp=Z(i,l) - Z(j,l); dlow+=tmp*tmp; }
+        if( dlow<=0 ) continue;
+        double bij = Weights(i,j)*Distances(i,j) / sqrt(dlow);
+        for(unsigned l=0; l<nlow; ++l) BZ(i,l) += bij*( Z(i,l) - Z(j,l) );
       }
-      //the diagonal elements are -off diagonal elements BZ(i,i)-=BZ(i,j)   (Equation 8.25)
-      BZ(i,i)=0; //create the space memory for the diagonal elements which are scalars
-      for(unsigned j=0; j<M; ++j) {
-        if(i==j) continue;
-        BZ(i,i)-=BZ(i,j);
+    }
+    // And the Guttman transform
+    if( lu.size()>0 ) {
+      int nrhs=nlow; std::vector<double> rhs( M*nlow );
+      for(unsigned i=0; i<M; ++i) {
+        for(unsigned l=0; l<nlow; ++l) rhs[M*l+i]=BZ(i,l);
+      }
+      plumed_lapack_dgetrs("N",&nrow,&nrhs,lu.data(),&nrow,ipiv.data(),rhs.data(),&nrow,&info);
+      plumed_massert( info==0, "problem solving linear equations in SMACOF algorithm");
+      for(unsigned i=0; i<M; ++i) {
+        for(unsigned l=0; l<nlow; ++l) newZ(i,l)=rhs[M*l+i];
+      }
+    } else {
+      #pragma omp parallel for num_threads(nt)
+      for(unsigned i=0; i<M; ++i) {
+        for(unsigned l=0; l<nlow; ++l) newZ(i,l)=0;
+        for(unsigned j=0; j<M; ++j) {
+          for(unsigned l=0; l<nlow; ++l) newZ(i,l) += mypseudo(i,j)*BZ(j,l);
+        }
       }
     }
-
-    mult( mypseudo, BZ, temp); mult(temp, Z, newZ);
     //Compute new sigma
-    double newsig = calculateSigma( newZ, dists );
+    double newsig = calculateSigma( newZ, nt );
     //Computing whether the algorithm has converged (has the mass of the potato changed
     //when we put it back in the oven!)
     if( fabs( newsig - myfirstsig )<tol ) break;
@@ -94,12 +137,13 @@ void SMACOF::optimize( const double& tol, const unsigned& maxloops, std::vector<
   }
 }
 
-double SMACOF::calculateSigma( const Matrix<double>& Z, Matrix<double>& dists ) {
+double SMACOF::calculateSigma( const Matrix<double>& Z, const unsigned& nt ) const {
   unsigned M = Distances.nrows(); double sigma=0; double totalWeight=0;
+  #pragma omp parallel for num_threads(nt) reduction(+:sigma,totalWeight)
   for(unsigned i=1; i<M; ++i) {
     for(unsigned j=0; j<i; ++j) {
       double dlow=0; for(unsigned k=0; k<Z.ncols(); ++k) { double tmp=Z(i,k) - Z(j,k); dlow+=tmp*tmp; }
-      dists(i,j)=dists(j,i)=sqrt(dlow); double tmp3 = Distances(i,j) - dists(i,j);
+      double tmp3 = Distances(i,j) - sqrt(dlow);
       sigma += Weights(i,j)*tmp3*tmp3; totalWeight+=Weights(i,j);
     }
   }
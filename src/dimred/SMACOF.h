@@ -32,7 +32,8 @@ namespace dimred {
 class SMACOF {
 private:
   Matrix<double> Distances, Weights;
-  double calculateSigma( const Matrix<double>& InitialZ, Matrix<double>& dists );
+/// Calculate the stress for a projection using nt OpenMP threads
+  double calculateSigma( const Matrix<double>& Z, const unsigned& nt ) const ;
 public:
   explicit SMACOF( const Value* mysquaredists );
   void optimize( const double& tol, const unsigned& maxloops, std::vector<double>& proj);
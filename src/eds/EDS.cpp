@@ -271,6 +271,7 @@ public:
   explicit EDS(const ActionOptions &);
   void calculate();
   void update();
+  bool checkIsHistoryDependent()const override {return true;}
   void turnOnDerivatives();
   static void registerKeywords(Keywords &keys);
   ~EDS();
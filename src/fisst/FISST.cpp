@@ -157,6 +157,7 @@ public:
   explicit FISST(const ActionOptions&);
   void calculate();
   void update();
+  bool checkIsHistoryDependent()const override {return true;}
   void turnOnDerivatives();
   static void registerKeywords(Keywords& keys);
   ~FISST();
@@ -363,7 +363,28 @@ void Custom::calc( const ActionWithArguments* action, const std::vector<double>&
   }
 }
 
-}
+void Custom::calcBatch( const ActionWithArguments* action, const unsigned& n, const std::vector<const double*>& args, double* vals, const std::vector<double*>& derivatives ) const {
+  function.evaluateBatch( n, args, vals, derivatives );
+  if( args.size()<=1 || (check_multiplication_vars.size()==0 && !zerowhenallzero) ) return;
+  // Apply the same shortcut as calc on the points where the arguments are zero
+  for(unsigned k=0; k<n; ++k) {
+    bool allzero=false;
+    if( check_multiplication_vars.size()>0 ) {
+      for(unsigned i=0; i<check_multiplication_vars.size(); ++i) {
+        if( fabs(args[check_multiplication_vars[i]][k])<epsilon ) { allzero=true; break; }
+      }
+    } else {
+      allzero=(fabs(args[0][k])<epsilon);
+      for(unsigned i=1; i<args.size(); ++i) {
+        if( fabs(args[i][k])>epsilon ) { allzero=false; break; }
+      }
+    }
+    if( allzero ) {
+      vals[k]=0; for(unsigned i=0; i<derivatives.size(); ++i) derivatives[i][k]=0.0;
+    }
+  }
 }
 
+}
+}
 
@@ -42,6 +42,8 @@ public:
   bool getDerivativeZeroIfValueIsZero() const override;
   std::vector<Value*> getArgumentsToCheck( const std::vector<Value*>& args ) override;
   void calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const override;
+  bool hasBatchCalc() const override { return true; }
+  void calcBatch( const ActionWithArguments* action, const unsigned& n, const std::vector<const double*>& args, double* vals, const std::vector<double*>& derivatives ) const override;
 };
 
 }
@@ -47,6 +47,12 @@ private:
   std::vector<std::string> actionsLabelsInChain;
 /// Get the shape of the output matrix
   std::vector<unsigned> getValueShapeFromArguments();
+/// Are the values of the function computed for all the elements at once before running the tasks
+  bool usebatch;
+/// The values and the derivatives of the function that were computed at once
+  std::vector<double> batch_values, batch_derivatives;
+/// Compute the function for all the elements at once if the function and the arguments allow it
+  void calculateBatch();
 public:
   static void registerKeywords(Keywords&);
   explicit FunctionOfMatrix(const ActionOptions&);
@@ -58,6 +64,8 @@ public:
   unsigned getNumberOfDerivatives() override ;
 /// Resize the matrices
   void prepare() override ;
+/// Calculate the function
+  void calculate() override ;
 /// This gets the number of columns
   unsigned getNumberOfColumns() const override ;
 /// This checks for tasks in the parent class
@@ -95,7 +103,8 @@ template <class T>
 FunctionOfMatrix<T>::FunctionOfMatrix(const ActionOptions&ao):
   Action(ao),
   ActionWithMatrix(ao),
-  firststep(true)
+  firststep(true),
+  usebatch(false)
 {
   if( myfunc.getArgStart()>0 ) error("this has not beeen implemented -- if you are interested email gareth.tribello@gmail.com");
   // Get the shape of the output
@@ -215,6 +224,49 @@ void FunctionOfMatrix<T>::prepare() {
   ActionWithVector::prepare();
 }
 
+template <class T>
+void FunctionOfMatrix<T>::calculateBatch() {
+  usebatch = myfunc.hasBatchCalc() && getNumberOfComponents()==1 && getPntrToComponent(0)->getRank()==2;
+  unsigned argstart=myfunc.getArgStart(), nargs=getNumberOfArguments()-argstart;
+  // Sparse matrices are computed element by element
+  for(unsigned j=0; j<nargs && usebatch; ++j) {
+    Value* myarg=getPntrToArgument(argstart+j);
+    if( myarg->getRank()==2 && myarg->getNumberOfColumns()<myarg->getShape()[1] ) usebatch=false;
+  }
+  if( !usebatch ) return;
+  unsigned n=getPntrToComponent(0)->getShape()[0]*getPntrToComponent(0)->getShape()[1];
+  // Copy the arguments in arrays, scalars are repeated for every element
+  std::vector<double> argvals( nargs*n );
+  for(unsigned j=0; j<nargs; ++j) {
+    Value* myarg=getPntrToArgument(argstart+j);
+    if( myarg->getRank()==2 ) { for(unsigned i=0; i<n; ++i) argvals[j*n+i] = myarg->get(i); }
+    else std::fill( argvals.begin()+j*n, argvals.begin()+(j+1)*n, myarg->get() );
+  }
+  bool doderiv=!doNotCalculateDerivatives();
+  batch_values.resize( n ); batch_derivatives.resize( doderiv ? nargs*n : 0 );
+  // The elements are divided in blocks that are computed by the OpenMP threads
+  const unsigned blocksize=1024, nblocks=(n+blocksize-1)/blocksize;
+  unsigned nt=OpenMP::getNumThreads(); if( nt>nblocks ) nt=nblocks;
+  if( nt==0 ) nt=1;
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<const double*> blockargs( nargs ); std::vector<double*> blockderivs( doderiv ? nargs : 0 );
+    #pragma omp for
+    for(unsigned b=0; b<nblocks; ++b) {
+      unsigned start=b*blocksize, m=std::min( blocksize, n-start );
+      for(unsigned j=0; j<nargs; ++j) blockargs[j] = argvals.data() + j*n + start;
+      for(unsigned j=0; j<blockderivs.size(); ++j) blockderivs[j] = batch_derivatives.data() + j*n + start;
+      myfunc.calcBatch( this, m, blockargs, batch_values.data()+start, blockderivs );
+    }
+  }
+}
+
+template <class T>
+void FunctionOfMatrix<T>::calculate() {
+  if( !actionInChain() ) calculateBatch();
+  ActionWithMatrix::calculate();
+}
+
 template <class T>
 unsigned FunctionOfMatrix<T>::getNumberOfColumns() const {
   if( getConstPntrToComponent(0)->getRank()==2 ) {
@@ -269,21 +321,30 @@ void FunctionOfMatrix<T>::performTask( const std::string& controller, const unsi
   unsigned ind2 = index2;
   if( getConstPntrToComponent(0)->getRank()==2 && index2>=getConstPntrToComponent(0)->getShape()[0] ) ind2 = index2 - getConstPntrToComponent(0)->getShape()[0];
   else if( index2>=getPntrToArgument(0)->getShape()[0] ) ind2 = index2 - getPntrToArgument(0)->getShape()[0];
-  if( actionInChain() ) {
-    for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
-      if( getPntrToArgument(i)->getRank()==0 ) args[i-argstart] = getPntrToArgument(i)->get();
-      else if( !getPntrToArgument(i)->valueHasBeenSet() ) args[i-argstart] = myvals.get( getPntrToArgument(i)->getPositionInStream() );
-      else args[i-argstart] = getPntrToArgument(i)->get( getPntrToArgument(i)->getShape()[1]*index1 + ind2 );
+  std::vector<double> vals( getNumberOfComponents() ); Matrix<double> derivatives( getNumberOfComponents(), getNumberOfArguments()-argstart );
+  if( usebatch && !actionInChain() ) {
+    // The function was already computed in calculateBatch
+    unsigned nelements=batch_values.size(), elem=getConstPntrToComponent(0)->getShape()[1]*index1 + ind2;
+    vals[0] = batch_values[elem];
+    if( !doNotCalculateDerivatives() ) {
+      for(unsigned j=0; j<args.size(); ++j) derivatives(0,j) = batch_derivatives[j*nelements+elem];
     }
   } else {
-    for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
-      if( getPntrToArgument(i)->getRank()==2 ) args[i-argstart]=getPntrToArgument(i)->get( getPntrToArgument(i)->getShape()[1]*index1 + ind2 );
-      else args[i-argstart] = getPntrToArgument(i)->get();
+    if( actionInChain() ) {
+      for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
+        if( getPntrToArgument(i)->getRank()==0 ) args[i-argstart] = getPntrToArgument(i)->get();
+        else if( !getPntrToArgument(i)->valueHasBeenSet() ) args[i-argstart] = myvals.get( getPntrToArgument(i)->getPositionInStream() );
+        else args[i-argstart] = getPntrToArgument(i)->get( getPntrToArgument(i)->getShape()[1]*index1 + ind2 );
+      }
+    } else {
+      for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
+        if( getPntrToArgument(i)->getRank()==2 ) args[i-argstart]=getPntrToArgument(i)->get( getPntrToArgument(i)->getShape()[1]*index1 + ind2 );
+        else args[i-argstart] = getPntrToArgument(i)->get();
+      }
     }
+    // Calculate the function and its derivatives
+    myfunc.calc( this, args, vals, derivatives );
   }
-  // Calculate the function and its derivatives
-  std::vector<double> vals( getNumberOfComponents() ); Matrix<double> derivatives( getNumberOfComponents(), getNumberOfArguments()-argstart );
-  myfunc.calc( this, args, vals, derivatives );
   // And set the values
   for(unsigned i=0; i<vals.size(); ++i) myvals.addValue( getConstPntrToComponent(i)->getPositionInStream(), vals[i] );
   // Return if we are not computing derivatives
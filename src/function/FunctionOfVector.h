@@ -26,6 +26,7 @@
 //#include "core/CollectFrames.h"
 #include "core/ActionSetup.h"
 #include "tools/Matrix.h"
+#include "tools/OpenMP.h"
 #include "Sum.h"
 
 namespace PLMD {
@@ -44,6 +45,12 @@ private:
   unsigned nderivatives;
 /// A vector that tells us if we have stored the input value
   std::vector<bool> stored_arguments;
+/// Are the values of the function computed for all the elements at once before running the tasks
+  bool usebatch;
+/// The values and the derivatives of the function that were computed at once
+  std::vector<double> batch_values, batch_derivatives;
+/// Compute the function for all the elements at once if the function allows it
+  void calculateBatch();
 public:
   static void registerKeywords(Keywords&);
 /// This method is used to run the calculation with functions such as highest/lowest and sort.
@@ -100,7 +107,8 @@ FunctionOfVector<T>::FunctionOfVector(const ActionOptions&ao):
   ActionWithVector(ao),
   doAtEnd(true),
   firststep(true),
-  nderivatives(0)
+  nderivatives(0),
+  usebatch(false)
 {
   // Get the shape of the output
   std::vector<unsigned> shape(1); shape[0]=getNumberOfFinalTasks();
@@ -222,21 +230,29 @@ void FunctionOfVector<T>::setupStreamedComponents( const std::string& headstr, u
 template <class T>
 void FunctionOfVector<T>::performTask( const unsigned& current, MultiValue& myvals ) const {
   unsigned argstart=myfunc.getArgStart(); std::vector<double> args( getNumberOfArguments()-argstart);
-  if( actionInChain() ) {
-    for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
-      if(  getPntrToArgument(i)->getRank()==0 ) args[i-argstart] = getPntrToArgument(i)->get();
-      else if( !getPntrToArgument(i)->valueHasBeenSet() ) args[i-argstart] = myvals.get( getPntrToArgument(i)->getPositionInStream() );
-      else args[i-argstart] = getPntrToArgument(i)->get( myvals.getTaskIndex() );
+  std::vector<double> vals( getNumberOfComponents() ); Matrix<double> derivatives( getNumberOfComponents(), args.size() );
+  if( usebatch && !actionInChain() ) {
+    // The function was already computed in calculateBatch
+    unsigned nelements=batch_values.size(); vals[0] = batch_values[current];
+    if( !doNotCalculateDerivatives() ) {
+      for(unsigned j=0; j<args.size(); ++j) derivatives(0,j) = batch_derivatives[j*nelements+current];
     }
   } else {
-    for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
-      if( getPntrToArgument(i)->getRank()==1 ) args[i-argstart]=getPntrToArgument(i)->get(current);
-      else args[i-argstart] = getPntrToArgument(i)->get();
+    if( actionInChain() ) {
+      for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
+        if(  getPntrToArgument(i)->getRank()==0 ) args[i-argstart] = getPntrToArgument(i)->get();
+        else if( !getPntrToArgument(i)->valueHasBeenSet() ) args[i-argstart] = myvals.get( getPntrToArgument(i)->getPositionInStream() );
+        else args[i-argstart] = getPntrToArgument(i)->get( myvals.getTaskIndex() );
+      }
+    } else {
+      for(unsigned i=argstart; i<getNumberOfArguments(); ++i) {
+        if( getPntrToArgument(i)->getRank()==1 ) args[i-argstart]=getPntrToArgument(i)->get(current);
+        else args[i-argstart] = getPntrToArgument(i)->get();
+      }
     }
+    // Calculate the function and its derivatives
+    myfunc.calc( this, args, vals, derivatives );
   }
-  // Calculate the function and its derivatives
-  std::vector<double> vals( getNumberOfComponents() ); Matrix<double> derivatives( getNumberOfComponents(), args.size() );
-  myfunc.calc( this, args, vals, derivatives );
   // And set the values
   for(unsigned i=0; i<vals.size(); ++i) myvals.addValue( getConstPntrToComponent(i)->getPositionInStream(), vals[i] );
   // Return if we are not computing derivatives
@@ -345,12 +361,44 @@ void FunctionOfVector<T>::runSingleTaskCalculation( const Value* arg, ActionWith
   }
 }
 
+template <class T>
+void FunctionOfVector<T>::calculateBatch() {
+  usebatch = myfunc.hasBatchCalc() && getNumberOfComponents()==1 && getPntrToComponent(0)->getRank()==1;
+  if( !usebatch ) return;
+  unsigned argstart=myfunc.getArgStart(), nargs=getNumberOfArguments()-argstart;
+  unsigned n=getPntrToComponent(0)->getShape()[0];
+  // Copy the arguments in arrays, scalars are repeated for every element
+  std::vector<double> argvals( nargs*n );
+  for(unsigned j=0; j<nargs; ++j) {
+    Value* myarg=getPntrToArgument(argstart+j);
+    if( myarg->getRank()==1 ) { for(unsigned i=0; i<n; ++i) argvals[j*n+i] = myarg->get(i); }
+    else std::fill( argvals.begin()+j*n, argvals.begin()+(j+1)*n, myarg->get() );
+  }
+  bool doderiv=!doNotCalculateDerivatives();
+  batch_values.resize( n ); batch_derivatives.resize( doderiv ? nargs*n : 0 );
+  // The elements are divided in blocks that are computed by the OpenMP threads
+  const unsigned blocksize=1024, nblocks=(n+blocksize-1)/blocksize;
+  unsigned nt=OpenMP::getNumThreads(); if( nt>nblocks ) nt=nblocks;
+  if( nt==0 ) nt=1;
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<const double*> blockargs( nargs ); std::vector<double*> blockderivs( doderiv ? nargs : 0 );
+    #pragma omp for
+    for(unsigned b=0; b<nblocks; ++b) {
+      unsigned start=b*blocksize, m=std::min( blocksize, n-start );
+      for(unsigned j=0; j<nargs; ++j) blockargs[j] = argvals.data() + j*n + start;
+      for(unsigned j=0; j<blockderivs.size(); ++j) blockderivs[j] = batch_derivatives.data() + j*n + start;
+      myfunc.calcBatch( this, m, blockargs, batch_values.data()+start, blockderivs );
+    }
+  }
+}
+
 template <class T>
 void FunctionOfVector<T>::calculate() {
   // Everything is done elsewhere
   if( actionInChain() ) return;
   // This is done if we are calculating a function of multiple cvs
-  if( !doAtEnd ) runAllTasks();
+  if( !doAtEnd ) { calculateBatch(); runAllTasks(); }
   // This is used if we are doing sorting actions on a single vector
   else if( !myfunc.doWithTasks() ) runSingleTaskCalculation( getPntrToArgument(0), this, myfunc );
 }
@@ -60,6 +60,11 @@ public:
   virtual unsigned getArgStart() const { return 0; }
   virtual void setup( ActionWithValue* action );
   virtual void calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const = 0;
+/// Override this function and calcBatch if a function with a single output can be evaluated on many points at once
+  virtual bool hasBatchCalc() const { return false; }
+/// Calculate the function at n points, args[j] points to the n values of the j-th argument.
+/// The values are stored in vals and, if derivatives is not empty, the derivatives with respect to the j-th argument in derivatives[j]
+  virtual void calcBatch( const ActionWithArguments* action, const unsigned& n, const std::vector<const double*>& args, double* vals, const std::vector<double*>& derivatives ) const { plumed_error(); }
 };
 
 template<class T>
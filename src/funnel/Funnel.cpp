@@ -129,6 +129,7 @@ public:
   // ~Funnel();
 
   void calculate();
+  bool checkIsHistoryDependent()const override {return false;}
   static void registerKeywords(Keywords& keys);
   void createBIAS(const double& R_cyl, const double& z_cc, const double& alpha, const double& KAPPA,
                   const double& MIN_S, const double& MAX_S, const double& NBIN_S, const double& NBIN_Z,
@@ -55,6 +55,7 @@ public:
   void calculate() override {}
   void apply() override {}
   void update() override ;
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(Collect,"COLLECT")
@@ -72,6 +72,7 @@ public:
   explicit Committor(const ActionOptions&ao);
   void calculate() override;
   void apply() override {}
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(Committor,"COMMITTOR")
@@ -23,6 +23,9 @@
 #include "core/ActionPilot.h"
 #include "core/ActionSet.h"
 #include "core/PlumedMain.h"
+#include "tools/Communicator.h"
+#include <cstdio>
+#include <fstream>
 
 namespace PLMD {
 namespace generic {
@@ -42,6 +45,19 @@ DEBUG DETAILED_TIMERS
 DEBUG logRequestedAtoms STRIDE=2
 \endplumedfile
 
+The following input collects, for each action, the number of times it has been calculated, the
+wall time spent in its calculation, in the application of forces and in its update, the number of tasks it has run and
+the number of atoms and derivatives it has used. Every 100 steps, these counters are written on a file
+that is overwritten each time, so that it can be monitored while the simulation is running.
+
+\plumedfile
+DEBUG TIMING_REPORT=timings.dat STRIDE=100
+\endplumedfile
+
+The same counters can be switched on by the MD code with `cmd("setActionCounters",&flag)` and retrieved
+at any time with `cmd("getTimingReportSize",&size)` followed by `cmd("getTimingReport",buffer)`, where `buffer`
+is a `char` array of size `size`.
+
 */
 //+ENDPLUMEDOC
 class Debug:
@@ -52,6 +68,7 @@ class Debug:
   bool logRequestedAtoms;
   bool novirial;
   bool detailedTimers;
+  std::string timingReport;
 public:
   explicit Debug(const ActionOptions&ao);
 /// Register all the relevant keywords for the action
@@ -71,6 +88,7 @@ void Debug::registerKeywords( Keywords& keys ) {
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirety of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
+  keys.add("optional","TIMING_REPORT","switch on the per-action counters and write them on this file, which is overwritten every STRIDE steps");
 }
 
 Debug::Debug(const ActionOptions&ao):
@@ -91,6 +109,12 @@ Debug::Debug(const ActionOptions&ao):
     log.printf("  Detailed timing on\n");
     plumed.detailedTimers=true;
   }
+  parse("TIMING_REPORT",timingReport);
+  if(timingReport.length()>0) {
+    timingReport=FileBase::appendSuffix(timingReport,plumed.getSuffix());
+    log.printf("  writing per-action counters on file %s\n",timingReport.c_str());
+    plumed.actionCounters=true;
+  }
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
@@ -132,6 +156,16 @@ void Debug::apply() {
     ofile.printf("\n");
     plumed.cmd("clearFullList");
   }
+  if(timingReport.length()>0 && comm.Get_rank()==0) {
+    // write on a temporary file and rename it, so that readers never see a partial report
+    const std::string tmp=timingReport+".tmp";
+    {
+      std::ofstream ofs(tmp);
+      plumed_massert(ofs,"cannot open file "+tmp);
+      ofs<<plumed.getTimingReport();
+    }
+    plumed_massert(std::rename(tmp.c_str(),timingReport.c_str())==0,"cannot rename "+tmp+" to "+timingReport);
+  }
 
 }
 
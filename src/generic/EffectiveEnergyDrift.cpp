@@ -126,6 +126,7 @@ public:
   void calculate() override {};
   void apply() override {};
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(EffectiveEnergyDrift,"EFFECTIVE_ENERGY_DRIFT")
@@ -0,0 +1,96 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "core/Action.h"
+#include "core/ActionRegister.h"
+#include "core/PlumedMain.h"
+
+namespace PLMD {
+namespace generic {
+
+//+PLUMEDOC GENERIC EXCHANGE_ARGUMENTS
+/*
+Exchange the arguments of the biases rather than the positions in Hamiltonian replica exchange.
+
+In Hamiltonian replica exchange simulations (e.g. with the -hrex option of GROMACS) the bias of each replica
+has to be computed on the configuration of its partner at every exchange attempt. By default, the positions are
+sent to the partner and the whole input is calculated again. When the replicas only differ in their biases, the collective variables
+computed on the configuration of the partner are the same that the partner has already computed. With this directive,
+the arguments of the biases are sent instead of the positions, and only the biases (together with the functions of
+collective variables they depend on) are calculated again.
+
+At every exchange attempt, PLUMED checks that the input lines of the actions that compute the exchanged arguments
+are the same on the two replicas, and that all the biases only depend on scalar or vector arguments. When this is not the case, the positions
+are exchanged and the whole input is calculated as usual. Notice that files are not checked: if the same input line reads
+a different file on each replica (e.g. a reference structure with a replica suffix) this directive should not be used.
+
+\par Examples
+
+The two replicas below only differ in the position of the restraint, so that the torsions are not calculated again
+at the exchange attempts.
+
+Here is plumed.0.dat
+\plumedfile
+EXCHANGE_ARGUMENTS
+phi: TORSION ATOMS=5,7,9,15
+psi: TORSION ATOMS=7,9,15,17
+RESTRAINT ARG=phi,psi AT=-1.0,1.0 KAPPA=10,10
+\endplumedfile
+
+Here is plumed.1.dat
+\plumedfile
+EXCHANGE_ARGUMENTS
+phi: TORSION ATOMS=5,7,9,15
+psi: TORSION ATOMS=7,9,15,17
+RESTRAINT ARG=phi,psi AT=1.0,-1.0 KAPPA=10,10
+\endplumedfile
+
+\warning The directive should appear in the input files of every replica.
+
+*/
+//+ENDPLUMEDOC
+
+class ExchangeArguments:
+  public Action
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit ExchangeArguments(const ActionOptions&ao);
+  void calculate() override {}
+  void apply() override {}
+};
+
+PLUMED_REGISTER_ACTION(ExchangeArguments,"EXCHANGE_ARGUMENTS")
+
+void ExchangeArguments::registerKeywords( Keywords& keys ) {
+  Action::registerKeywords(keys);
+}
+
+ExchangeArguments::ExchangeArguments(const ActionOptions&ao):
+  Action(ao)
+{
+  checkRead();
+  plumed.setExchangeArguments(true);
+  log.printf("  exchanging the arguments of the biases in replica exchange when possible\n");
+}
+
+}
+}
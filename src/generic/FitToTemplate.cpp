@@ -196,6 +196,7 @@ public:
   static void registerKeywords( Keywords& keys );
   bool actionHasForces() override { return true; }
   void calculate() override;
+  bool checkModifiesSharedData() const override { return true; }
   void apply() override;
   unsigned getNumberOfDerivatives() override {plumed_merror("You should not call this function");};
 };
@@ -99,6 +99,7 @@ public:
   void apply() override {}
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   std::string getFilename() const;
   IFile* getFile();
   unsigned getNumberOfDerivatives() override;
@@ -103,6 +103,7 @@ public:
   explicit ResetCell(const ActionOptions&ao);
   static void registerKeywords( Keywords& keys );
   void calculate() override;
+  bool checkModifiesSharedData() const override { return true; }
   void apply() override;
 };
 
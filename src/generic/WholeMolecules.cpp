@@ -112,6 +112,7 @@ public:
   static void registerKeywords( Keywords& keys );
   bool actionHasForces() override { return false; }
   void calculate() override;
+  bool checkModifiesSharedData() const override { return true; }
   void apply() override {}
 };
 
@@ -279,6 +279,7 @@ public:
 // active methods:
   void prepare() override;
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return noise_!=2 || nregres_>0;}
 };
 
 inline
@@ -219,6 +219,7 @@ public:
 // active methods:
   void prepare() override;
   void calculate() override;
+  bool checkIsHistoryDependent()const override {return dbfact_>0;}
 };
 
 PLUMED_REGISTER_ACTION(EMMIVOX,"EMMIVOX")
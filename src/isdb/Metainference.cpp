@@ -278,6 +278,7 @@ public:
   ~Metainference();
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
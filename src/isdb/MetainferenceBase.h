@@ -198,6 +198,7 @@ public:
   double getMetaDer(const unsigned index);
   void writeStatus();
   void turnOnDerivatives() override;
+  bool checkIsHistoryDependent()const override {return doscore_;}
   unsigned getNumberOfDerivatives() override;
   void lockRequests() override;
   void unlockRequests() override;
@@ -155,6 +155,7 @@ public:
   explicit Rescale(const ActionOptions&);
   ~Rescale();
   void calculate();
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
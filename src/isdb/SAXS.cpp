@@ -38,6 +38,7 @@
 #include "tools/PDB.h"
 #include "tools/Tools.h"
 #include "tools/IFile.h"
+#include "tools/OpenMP.h"
 
 #include <map>
 #include <iterator>
@@ -114,6 +115,10 @@ the ATOMISTIC scheme and cannot be used with SCALE_EXPINT.
 
 By default SAXS is calculated using Debye on CPU, by adding the GPU flag it is possible to solve the equation on
 a GPU if the ARRAYFIRE libraries are installed and correctly linked.
+On CPU, the DEBYE_TABLE flag avoids the evaluation of \f$\sin(qr)/(qr)\f$ for each pair of atoms and each q value:
+the function and its derivative are tabulated for all the q values on a fine grid of distances, with spacing TABLE_STEP,
+and are interpolated with cubic Hermite polynomials. Intensities and derivatives are consistent, and the relative
+error is of the order of \f$(q_{max}\Delta r)^4/384\f$, that is smaller than \f$10^{-7}\f$ with the default spacing.
 \ref METAINFERENCE can be activated using DOSCORE and the other relevant keywords.
 
 \par Examples
@@ -310,6 +315,7 @@ private:
   bool gpu;
   bool onebead;
   bool resolution;
+  bool debye_table;
   bool isFirstStep;
   int  deviceid;
   unsigned nres;
@@ -352,6 +358,11 @@ private:
   std::vector<std::vector<double> > Rij;
   std::vector<double> sigma_res;
 
+  // tables of sin(qr)/(qr) and of its derivative with respect to r, for all the q values, on a grid of distances
+  double table_step;
+  std::vector<double> table_value;
+  std::vector<double> table_deriv;
+
   // Chebyshev polynomial coefficients for i0e(x) used for resolution function
   // values taken from cephes library
   const std::vector<double> A = {
@@ -416,6 +427,8 @@ private:
 
   void calculate_gpu(std::vector<Vector> &pos, std::vector<Vector> &deriv);
   void calculate_cpu(std::vector<Vector> &pos, std::vector<Vector> &deriv);
+  void calculate_table(std::vector<Vector> &pos, std::vector<Vector> &deriv, std::vector<double> &sum, unsigned rank, unsigned stride);
+  void setup_table(double rmax);
   void getMartiniFFparam(const std::vector<AtomNumber> &atoms, std::vector<std::vector<long double> > &parameter);
   void getOnebeadparam(const PDB &pdb, const std::vector<AtomNumber> &atoms, std::vector<std::vector<long double> > &parameter_vac, std::vector<std::vector<long double> > &parameter_mix, std::vector<std::vector<long double> > &parameter_solv, const std::vector<unsigned> & residue_atom);
   unsigned getOnebeadMapping(const PDB &pdb, const std::vector<AtomNumber> &atoms);
@@ -450,6 +463,8 @@ void SAXS::registerKeywords(Keywords& keys) {
   keys.addFlag("SERIAL",false,"Perform the calculation in serial - for debug purpose");
   keys.add("compulsory","DEVICEID","-1","Identifier of the GPU to be used");
   keys.addFlag("GPU",false,"Calculate SAXS using ARRAYFIRE on an accelerator device");
+  keys.addFlag("DEBYE_TABLE",false,"Calculate SAXS on CPU interpolating the Debye function from a table");
+  keys.add("optional","TABLE_STEP","Spacing in nm of the grid of distances used with DEBYE_TABLE. By default it is 0.05/q where q is the largest QVALUE in nm^-1");
   keys.addFlag("ABSOLUTE",false,"Absolute intensity: the intensities for each q-value are not normalised for the intensity at q=0.");
   keys.addFlag("ATOMISTIC",false,"Calculate SAXS for an atomistic model");
   keys.addFlag("MARTINI",false,"Calculate SAXS for a Martini model");
@@ -503,6 +518,14 @@ SAXS::SAXS(const ActionOptions&ao):
   if(gpu) error("To use the GPU mode PLUMED must be compiled with ARRAYFIRE");
 #endif
 
+  debye_table=false;
+  parseFlag("DEBYE_TABLE",debye_table);
+  if(gpu&&debye_table) error("DEBYE_TABLE cannot be used with GPU");
+  table_step=-1.;
+  parse("TABLE_STEP",table_step);
+  if(table_step!=-1.&&!debye_table) error("TABLE_STEP can only be used with DEBYE_TABLE");
+  if(debye_table&&table_step!=-1.&&table_step<=0.) error("TABLE_STEP must be greater than 0");
+
   parse("DEVICEID",deviceid);
 #ifdef  __PLUMED_HAS_ARRAYFIRE
   if(gpu&&comm.Get_rank()==0) {
@@ -978,6 +1001,11 @@ SAXS::SAXS(const ActionOptions&ao):
     if (resolution) sigma_res[i]=sigma_res[i]*10.0;
   }
 
+  if(debye_table) {
+    if(table_step<0.) table_step=0.05/q_list[numq-1];
+    log.printf("  using a table of the Debye function with spacing %lf nm\n",table_step);
+  }
+
   // compute resolution function after converting units
   if (resolution) {
     qj_list.resize(numq, std::vector<double>(Nj));
@@ -1222,41 +1250,40 @@ void SAXS::calculate_cpu(std::vector<Vector> &pos, std::vector<Vector> &deriv)
   }
   std::vector<double> sum(numq,0);
   unsigned nt=OpenMP::getNumThreads();
-  #pragma omp parallel num_threads(nt)
-  {
-    std::vector<Vector> omp_deriv(deriv.size());
-    std::vector<double> omp_sum(numq,0);
-    #pragma omp for nowait
-    for (unsigned i=rank; i<size-1; i+=stride) {
-      Vector posi = pos[i];
-      for (unsigned j=i+1; j<size ; ++j) {
-        Vector c_distances = delta(posi,pos[j]);
-        double m_distances = c_distances.modulo();
-        c_distances = c_distances/m_distances/m_distances;
-        for (unsigned k=0; k<numq; ++k) {
-          unsigned kdx=k*size;
-          double qdist = q_list[k]*m_distances;
-          double FFF = 2.*FF_value[i][k]*FF_value[j][k];
-          double tsq = std::sin(qdist)/qdist;
-          double tcq = std::cos(qdist);
-          double tmp = FFF*(tcq-tsq);
-          Vector dd  = c_distances*tmp;
-          if(nt>1) {
-            omp_deriv[kdx+i] -=dd;
-            omp_deriv[kdx+j] +=dd;
-            omp_sum[k] += FFF*tsq;
-          } else {
-            deriv[kdx+i] -= dd;
-            deriv[kdx+j] += dd;
-            sum[k] += FFF*tsq;
+  if(debye_table) calculate_table(pos, deriv, sum, rank, stride);
+  else {
+    OpenMP::ArrayReduction<Vector> omp_deriv(nt, deriv.size());
+    OpenMP::ArrayReduction<double> omp_sum(nt, numq);
+    #pragma omp parallel num_threads(nt)
+    {
+      std::vector<Vector> & my_deriv(nt>1 ? omp_deriv.getArray() : deriv);
+      std::vector<double> & my_sum(nt>1 ? omp_sum.getArray() : sum);
+      #pragma omp for
+      for (unsigned i=rank; i<size-1; i+=stride) {
+        Vector posi = pos[i];
+        for (unsigned j=i+1; j<size ; ++j) {
+          Vector c_distances = delta(posi,pos[j]);
+          double m_distances = c_distances.modulo();
+          c_distances = c_distances/m_distances/m_distances;
+          for (unsigned k=0; k<numq; ++k) {
+            unsigned kdx=k*size;
+            double qdist = q_list[k]*m_distances;
+            double FFF = 2.*FF_value[i][k]*FF_value[j][k];
+            double tsq = std::sin(qdist)/qdist;
+            double tcq = std::cos(qdist);
+            double tmp = FFF*(tcq-tsq);
+            Vector dd  = c_distances*tmp;
+            my_deriv[kdx+i] -= dd;
+            my_deriv[kdx+j] += dd;
+            my_sum[k] += FFF*tsq;
           }
         }
       }
-    }
-    #pragma omp critical
-    if(nt>1) {
-      for(unsigned i=0; i<deriv.size(); ++i) deriv[i]+=omp_deriv[i];
-      for(unsigned k=0; k<numq; ++k) sum[k]+=omp_sum[k];
+      // each thread sums a part of the copies, without critical sections
+      if(nt>1) {
+        omp_deriv.sum(deriv);
+        omp_sum.sum(sum);
+      }
     }
   }
 
@@ -1330,6 +1357,111 @@ void SAXS::calculate_cpu(std::vector<Vector> &pos, std::vector<Vector> &deriv)
   }
 }
 
+void SAXS::setup_table(double rmax)
+{
+  const unsigned numq = q_list.size();
+  // two extra points are needed for the interpolation of the largest distance
+  const unsigned npoints = static_cast<unsigned>(std::ceil(rmax/table_step))+2;
+  if(npoints*numq<=table_value.size()) return;
+  // the table is enlarged with some margin, so that it is not built again at every step
+  const unsigned nalloc = npoints+npoints/5;
+  table_value.resize(nalloc*numq);
+  table_deriv.resize(nalloc*numq);
+  for(unsigned b=0; b<nalloc; ++b) {
+    const double r = b*table_step;
+    for(unsigned k=0; k<numq; ++k) {
+      const double x = q_list[k]*r;
+      double sinc, dsinc;
+      if(x<1.e-2) {
+        // series expansion, to avoid cancellations at small distances
+        const double x2 = x*x;
+        sinc = 1. - x2/6. + x2*x2/120.;
+        dsinc = -x/3. + x*x2/30.;
+      } else {
+        sinc = std::sin(x)/x;
+        dsinc = (std::cos(x)-sinc)/x;
+      }
+      table_value[b*numq+k] = sinc;
+      table_deriv[b*numq+k] = q_list[k]*dsinc;
+    }
+  }
+}
+
+void SAXS::calculate_table(std::vector<Vector> &pos, std::vector<Vector> &deriv, std::vector<double> &sum, unsigned rank, unsigned stride)
+{
+  const unsigned size = pos.size();
+  const unsigned numq = q_list.size();
+
+  // the largest distance is bounded by the diagonal of the box enclosing the particles
+  Vector lower = pos[0];
+  Vector upper = pos[0];
+  for(unsigned i=1; i<size; ++i) {
+    for(unsigned l=0; l<3; ++l) {
+      lower[l] = std::min(lower[l],pos[i][l]);
+      upper[l] = std::max(upper[l],pos[i][l]);
+    }
+  }
+  setup_table((upper-lower).modulo());
+
+  const double inv_step = 1./table_step;
+  const unsigned nt = OpenMP::getNumThreads();
+  // the copies of the threads store the derivatives particle by particle, so that all the q values are contiguous
+  OpenMP::ArrayReduction<Vector> omp_deriv(nt, size*numq);
+  OpenMP::ArrayReduction<double> omp_sum(nt, numq);
+  std::vector<Vector> deriv_by_particle(size*numq);
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<Vector> & my_deriv(omp_deriv.getArray());
+    std::vector<double> & my_sum(omp_sum.getArray());
+    std::vector<double> dd(numq);
+    #pragma omp for schedule(dynamic)
+    for (unsigned i=rank; i<size-1; i+=stride) {
+      const Vector posi = pos[i];
+      const double* FFi = FF_value[i].data();
+      Vector* deriv_i = &my_deriv[i*numq];
+      for (unsigned j=i+1; j<size ; ++j) {
+        Vector c_distances = delta(posi,pos[j]);
+        const double m_distances = c_distances.modulo();
+        c_distances /= m_distances;
+        // cubic Hermite interpolation between the grid points b and b+1
+        const double t = m_distances*inv_step;
+        const unsigned b = static_cast<unsigned>(t);
+        const double u = t-b;
+        const double u2 = u*u;
+        const double h00 = 1.-3.*u2+2.*u2*u;
+        const double h01 = 1.-h00;
+        const double h10 = table_step*(u-2.*u2+u2*u);
+        const double h11 = table_step*(u2*u-u2);
+        const double g0 = 6.*(u2-u)*inv_step;
+        const double g10 = 1.-4.*u+3.*u2;
+        const double g11 = 3.*u2-2.*u;
+        const double* S0 = &table_value[b*numq];
+        const double* S1 = S0+numq;
+        const double* D0 = &table_deriv[b*numq];
+        const double* D1 = D0+numq;
+        const double* FFj = FF_value[j].data();
+        #pragma omp simd
+        for (unsigned k=0; k<numq; ++k) {
+          const double FFF = 2.*FFi[k]*FFj[k];
+          my_sum[k] += FFF*(h00*S0[k]+h01*S1[k]+h10*D0[k]+h11*D1[k]);
+          dd[k] = FFF*(g0*(S0[k]-S1[k])+g10*D0[k]+g11*D1[k]);
+        }
+        Vector* deriv_j = &my_deriv[j*numq];
+        for (unsigned k=0; k<numq; ++k) {
+          const Vector d = c_distances*dd[k];
+          deriv_i[k] -= d;
+          deriv_j[k] += d;
+        }
+      }
+    }
+    omp_deriv.sum(deriv_by_particle);
+    omp_sum.sum(sum);
+  }
+  for (unsigned i=0; i<size; ++i) {
+    for (unsigned k=0; k<numq; ++k) deriv[k*size+i] = deriv_by_particle[i*numq+k];
+  }
+}
+
 void SAXS::calculate()
 {
   if(pbc) makeWhole();
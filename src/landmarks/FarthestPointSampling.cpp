@@ -22,6 +22,7 @@
 #include "matrixtools/MatrixOperationBase.h"
 #include "core/ActionRegister.h"
 #include "tools/Random.h"
+#include "tools/OpenMP.h"
 
 //+PLUMEDOC LANDMARKS FARTHEST_POINT_SAMPLING
 /*
@@ -89,22 +90,34 @@ void FarthestPointSampling::calculate() {
   landmarks[0] = std::floor( npoints*rand ); myval->set( landmarks[0], 0 );
 
   // Now find distance to all other points (N.B. We can use squared distances here for speed)
-  Matrix<double> distances( nlandmarks, npoints ); Value* myarg = getPntrToArgument(0);
-  for(unsigned i=0; i<npoints; ++i) distances(0,i) = myarg->get( landmarks[0]*npoints + i );
+  // We only need to store the distance from each point to the closest of the landmarks that have been selected thus far
+  std::vector<double> mindist( npoints ); Value* myarg = getPntrToArgument(0);
+  for(unsigned i=0; i<npoints; ++i) mindist[i] = myarg->get( landmarks[0]*npoints + i );
 
+  unsigned nt=OpenMP::getNumThreads();
+  if( nt*10>npoints ) nt=npoints/10;
+  if( nt==0 ) nt=1;
   // Now find all other landmarks
   for(unsigned i=1; i<nlandmarks; ++i) {
     // Find point that has the largest minimum distance from the landmarks selected thus far
     double maxd=0;
-    for(unsigned j=0; j<npoints; ++j) {
-      double mind=distances(0,j);
-      for(unsigned k=1; k<i; ++k) {
-        if( distances(k,j)<mind ) { mind=distances(k,j); }
+    #pragma omp parallel num_threads(nt)
+    {
+      double t_maxd=0; unsigned t_land=npoints;
+      #pragma omp for nowait
+      for(unsigned j=0; j<npoints; ++j) {
+        if( mindist[j]>t_maxd ) { t_maxd=mindist[j]; t_land=j; }
       }
-      if( mind>maxd ) { maxd=mind; landmarks[i]=j; }
+      // Ties are resolved in favour of the point with the lowest index so the result does not depend on the number of threads
+      #pragma omp critical
+      if( t_land<npoints && ( t_maxd>maxd || (t_maxd==maxd && t_land<landmarks[i]) ) ) { maxd=t_maxd; landmarks[i]=t_land; }
     }
     myval->set( landmarks[i], 0 );
-    for(unsigned k=0; k<npoints; ++k) distances(i,k) = myarg->get( landmarks[i]*npoints + k );
+    #pragma omp parallel for num_threads(nt)
+    for(unsigned k=0; k<npoints; ++k) {
+      double dd = myarg->get( landmarks[i]*npoints + k );
+      if( dd<mindist[k] ) mindist[k] = dd;
+    }
   }
 }
 
@@ -67,6 +67,7 @@
 #ifdef __PLUMED_HAS_ASMJIT
     #include "asmjit/asmjit.h"
 #endif
+#include <algorithm>
 #include <utility>
 
 namespace PLMD {
@@ -106,10 +107,10 @@ AsmJitRuntimePtr::~AsmJitRuntimePtr()
 #endif
 }
 
-CompiledExpression::CompiledExpression() : jitCode(NULL) {
+CompiledExpression::CompiledExpression() : jitCode(NULL), batchJitCode(NULL) {
 }
 
-CompiledExpression::CompiledExpression(const ParsedExpression& expression) : jitCode(NULL) {
+CompiledExpression::CompiledExpression(const ParsedExpression& expression) : jitCode(NULL), batchJitCode(NULL) {
     ParsedExpression expr = expression.optimize(); // Just in case it wasn't already optimized.
     vector<pair<ExpressionTreeNode, int> > temps;
     compileExpression(expr.getRootNode(), temps);
@@ -129,7 +130,7 @@ CompiledExpression::~CompiledExpression() {
             delete operation[i];
 }
 
-CompiledExpression::CompiledExpression(const CompiledExpression& expression) : jitCode(NULL) {
+CompiledExpression::CompiledExpression(const CompiledExpression& expression) : jitCode(NULL), batchJitCode(NULL) {
     *this = expression;
 }
 
@@ -144,6 +145,14 @@ CompiledExpression& CompiledExpression::operator=(const CompiledExpression& expr
     for (int i = 0; i < (int) operation.size(); i++)
         operation[i] = expression.operation[i]->clone();
     setVariableLocations(variablePointers);
+    if (expression.batchVariables.size() > 0)
+        setBatchVariables(expression.batchVariables);
+    else {
+        batchVariables.clear();
+        batchIndices.clear();
+        batchConstants.clear();
+        batchJitCode = NULL;
+    }
     return *this;
 }
 
@@ -239,7 +248,10 @@ double CompiledExpression::evaluate() const {
 #endif
     for (int i = 0; i < variablesToCopy.size(); i++)
         *variablesToCopy[i].first = *variablesToCopy[i].second;
+    return evaluateOperations();
+}
 
+double CompiledExpression::evaluateOperations() const {
     // Loop over the operations and evaluate each one.
     
     for (int step = 0; step < operation.size(); step++) {
@@ -255,6 +267,40 @@ double CompiledExpression::evaluate() const {
     return workspace[workspace.size()-1];
 }
 
+void CompiledExpression::setBatchVariables(const vector<string>& names) {
+    batchVariables = names;
+    batchIndices.assign(names.size(), -1);
+    for (set<string>::const_iterator iter = variableNames.begin(); iter != variableNames.end(); ++iter) {
+        int k = find(names.begin(), names.end(), *iter)-names.begin();
+        if (k == (int) names.size())
+            throw Exception("setBatchVariables: Variable '"+*iter+"' is not in the list");
+        batchIndices[k] = variableIndices[*iter];
+    }
+    static const bool asmjit=useAsmJit();
+    if(asmjit) {
+#ifdef __PLUMED_HAS_ASMJIT
+    if (workspace.size() > 0)
+        generateBatchJitCode();
+#endif
+    }
+}
+
+void CompiledExpression::evaluateBatch(int n, const double* const* values, double* results) const {
+    static const bool asmjit=useAsmJit();
+#ifdef __PLUMED_HAS_ASMJIT
+    if(asmjit && batchJitCode) {
+        ((void (*)(const double* const*, double*, long)) batchJitCode)(values, results, n);
+        return;
+    }
+#endif
+    for (int j = 0; j < n; j++) {
+        for (int k = 0; k < (int) batchIndices.size(); k++)
+            if (batchIndices[k] >= 0)
+                workspace[batchIndices[k]] = values[k][j];
+        results[j] = evaluateOperations();
+    }
+}
+
 #ifdef __PLUMED_HAS_ASMJIT
 static double evaluateOperation(Operation* op, double* args) {
     static map<string, double> dummyVariables;
@@ -488,6 +534,322 @@ void CompiledExpression::generateJitCode() {
     runtime.add(&jitCode, &code);
 }
 
+// Copy the upper lane of a packed register to a register holding a single value.
+
+static void generateUpperLane(X86Compiler& c, X86Xmm& dest, X86Xmm& arg) {
+    X86Xmm upper = c.newXmmPd();
+    c.movapd(upper, arg);
+    c.unpckhpd(upper, upper);
+    c.movsd(dest, upper);
+}
+
+// Call a scalar function on both lanes of a packed register.
+
+static void generatePackedSingleArgCall(X86Compiler& c, X86Xmm& dest, X86Xmm& arg, double (*function)(double)) {
+    X86Xmm low = c.newXmmSd(), high = c.newXmmSd(), arg0 = c.newXmmSd(), arg1 = c.newXmmSd();
+    c.movsd(arg0, arg);
+    generateUpperLane(c, arg1, arg);
+    generateSingleArgCall(c, low, arg0, function);
+    generateSingleArgCall(c, high, arg1, function);
+    c.movapd(dest, low);
+    c.unpcklpd(dest, high);
+}
+
+static void generatePackedTwoArgCall(X86Compiler& c, X86Xmm& dest, X86Xmm& arg1, X86Xmm& arg2, double (*function)(double, double)) {
+    X86Xmm low = c.newXmmSd(), high = c.newXmmSd();
+    X86Xmm arg10 = c.newXmmSd(), arg11 = c.newXmmSd(), arg20 = c.newXmmSd(), arg21 = c.newXmmSd();
+    c.movsd(arg10, arg1);
+    generateUpperLane(c, arg11, arg1);
+    c.movsd(arg20, arg2);
+    generateUpperLane(c, arg21, arg2);
+    generateTwoArgCall(c, low, arg10, arg20, function);
+    generateTwoArgCall(c, high, arg11, arg21, function);
+    c.movapd(dest, low);
+    c.unpcklpd(dest, high);
+}
+
+// Generate the instructions for all the operations, acting either on the lower lane of the registers (scalar)
+// or on both lanes (packed).  Constants are stored in both lanes of constantVar.
+
+static void generateOperations(X86Compiler& c, bool packed, const vector<Operation*>& operation, const vector<vector<int> >& arguments,
+        const vector<int>& target, const vector<int>& operationConstantIndex, vector<X86Xmm>& workspaceVar,
+        vector<X86Xmm>& constantVar, X86Gp& argsPointer, double* argValues) {
+    for (int step = 0; step < (int) operation.size(); step++) {
+        Operation& op = *operation[step];
+        vector<int> args = arguments[step];
+        if (args.size() == 1) {
+            for (int i = 1; i < op.getNumArguments(); i++)
+                args.push_back(args[0]+i);
+        }
+        X86Xmm& dest = workspaceVar[target[step]];
+        // Registers holding a single value are copied with movsd, like in generateJitCode().
+        auto copy = [&](X86Xmm& to, X86Xmm& from) {
+            if (packed) c.movapd(to, from);
+            else c.movsd(to, from);
+        };
+        double (*singleArg)(double) = NULL;
+        switch (op.getId()) {
+            case Operation::EXP: singleArg = exp; break;
+            case Operation::LOG: singleArg = log; break;
+            case Operation::SIN: singleArg = sin; break;
+            case Operation::COS: singleArg = cos; break;
+            case Operation::TAN: singleArg = tan; break;
+            case Operation::ASIN: singleArg = asin; break;
+            case Operation::ACOS: singleArg = acos; break;
+            case Operation::ATAN: singleArg = atan; break;
+            case Operation::SINH: singleArg = sinh; break;
+            case Operation::COSH: singleArg = cosh; break;
+            case Operation::TANH: singleArg = tanh; break;
+            case Operation::ASINH: singleArg = asinh; break;
+            case Operation::ACOSH: singleArg = acosh; break;
+            case Operation::ATANH: singleArg = atanh; break;
+            case Operation::ABS: singleArg = fabs; break;
+            case Operation::FLOOR: singleArg = floor; break;
+            case Operation::CEIL: singleArg = ceil; break;
+            default: break;
+        }
+        if (singleArg != NULL) {
+            if (packed)
+                generatePackedSingleArgCall(c, dest, workspaceVar[args[0]], singleArg);
+            else
+                generateSingleArgCall(c, dest, workspaceVar[args[0]], singleArg);
+            continue;
+        }
+        switch (op.getId()) {
+            case Operation::CONSTANT:
+                copy(dest, constantVar[operationConstantIndex[step]]);
+                break;
+            case Operation::ADD:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.addpd(dest, workspaceVar[args[1]]);
+                else c.addsd(dest, workspaceVar[args[1]]);
+                break;
+            case Operation::SUBTRACT:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.subpd(dest, workspaceVar[args[1]]);
+                else c.subsd(dest, workspaceVar[args[1]]);
+                break;
+            case Operation::MULTIPLY:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.mulpd(dest, workspaceVar[args[1]]);
+                else c.mulsd(dest, workspaceVar[args[1]]);
+                break;
+            case Operation::DIVIDE:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.divpd(dest, workspaceVar[args[1]]);
+                else c.divsd(dest, workspaceVar[args[1]]);
+                break;
+            case Operation::POWER:
+                if (packed)
+                    generatePackedTwoArgCall(c, dest, workspaceVar[args[0]], workspaceVar[args[1]], pow);
+                else
+                    generateTwoArgCall(c, dest, workspaceVar[args[0]], workspaceVar[args[1]], pow);
+                break;
+            case Operation::ATAN2:
+                if (packed)
+                    generatePackedTwoArgCall(c, dest, workspaceVar[args[0]], workspaceVar[args[1]], atan2);
+                else
+                    generateTwoArgCall(c, dest, workspaceVar[args[0]], workspaceVar[args[1]], atan2);
+                break;
+            case Operation::NEGATE:
+                c.xorpd(dest, dest);
+                if (packed) c.subpd(dest, workspaceVar[args[0]]);
+                else c.subsd(dest, workspaceVar[args[0]]);
+                break;
+            case Operation::SQRT:
+                if (packed) c.sqrtpd(dest, workspaceVar[args[0]]);
+                else c.sqrtsd(dest, workspaceVar[args[0]]);
+                break;
+            case Operation::STEP:
+                c.xorpd(dest, dest);
+                if (packed) c.cmppd(dest, workspaceVar[args[0]], imm(2)); // Comparison mode is LE
+                else c.cmpsd(dest, workspaceVar[args[0]], imm(2));
+                c.andpd(dest, constantVar[operationConstantIndex[step]]);
+                break;
+            case Operation::DELTA:
+            case Operation::NANDELTA:
+                c.xorpd(dest, dest);
+                if (packed) c.cmppd(dest, workspaceVar[args[0]], imm(0)); // Comparison mode is EQ
+                else c.cmpsd(dest, workspaceVar[args[0]], imm(0));
+                c.andpd(dest, constantVar[operationConstantIndex[step]]);
+                break;
+            case Operation::SQUARE:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.mulpd(dest, workspaceVar[args[0]]);
+                else c.mulsd(dest, workspaceVar[args[0]]);
+                break;
+            case Operation::CUBE:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) {
+                    c.mulpd(dest, workspaceVar[args[0]]);
+                    c.mulpd(dest, workspaceVar[args[0]]);
+                }
+                else {
+                    c.mulsd(dest, workspaceVar[args[0]]);
+                    c.mulsd(dest, workspaceVar[args[0]]);
+                }
+                break;
+            case Operation::RECIPROCAL:
+                copy(dest, constantVar[operationConstantIndex[step]]);
+                if (packed) c.divpd(dest, workspaceVar[args[0]]);
+                else c.divsd(dest, workspaceVar[args[0]]);
+                break;
+            case Operation::ADD_CONSTANT:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.addpd(dest, constantVar[operationConstantIndex[step]]);
+                else c.addsd(dest, constantVar[operationConstantIndex[step]]);
+                break;
+            case Operation::MULTIPLY_CONSTANT:
+                copy(dest, workspaceVar[args[0]]);
+                if (packed) c.mulpd(dest, constantVar[operationConstantIndex[step]]);
+                else c.mulsd(dest, constantVar[operationConstantIndex[step]]);
+                break;
+            default: {
+                // Just invoke evaluateOperation(), one lane at a time.
+                
+                int lanes = (packed ? 2 : 1);
+                vector<X86Xmm> result(lanes);
+                for (int lane = 0; lane < lanes; lane++) {
+                    for (int i = 0; i < (int) args.size(); i++) {
+                        X86Xmm value = c.newXmmSd();
+                        if (lane == 1)
+                            generateUpperLane(c, value, workspaceVar[args[i]]);
+                        else
+                            c.movsd(value, workspaceVar[args[i]]);
+                        c.movsd(x86::ptr(argsPointer, 8*i, 0), value);
+                    }
+                    result[lane] = c.newXmmSd();
+                    X86Gp fn = c.newIntPtr();
+                    c.mov(fn, imm_ptr((void*) evaluateOperation));
+                    CCFuncCall* call = c.call(fn, FuncSignature2<double, Operation*, double*>());
+                    call->setArg(0, imm_ptr(&op));
+                    call->setArg(1, imm_ptr(argValues));
+                    call->setRet(0, result[lane]);
+                }
+                copy(dest, result[0]);
+                if (packed)
+                    c.unpcklpd(dest, result[1]);
+            }
+        }
+    }
+}
+
+void CompiledExpression::generateBatchJitCode() {
+    CodeHolder code;
+    auto & runtime(*static_cast<asmjit::JitRuntime*>(runtimeptr.get()));
+    code.init(runtime.getCodeInfo());
+    X86Compiler c(&code);
+    c.addFunc(FuncSignature3<void, const double* const*, double*, long>());
+    X86Gp valuesPointer = c.newIntPtr();
+    X86Gp resultsPointer = c.newIntPtr();
+    X86Gp count = c.newIntPtr();
+    c.setArg(0, valuesPointer);
+    c.setArg(1, resultsPointer);
+    c.setArg(2, count);
+    X86Gp argsPointer = c.newIntPtr();
+    c.mov(argsPointer, imm_ptr(&argValues[0]));
+
+    // Load the pointers to the values of the variables.
+
+    vector<X86Gp> variablePointer(batchIndices.size());
+    for (int k = 0; k < (int) batchIndices.size(); k++) {
+        if (batchIndices[k] < 0)
+            continue;
+        variablePointer[k] = c.newIntPtr();
+        c.mov(variablePointer[k], x86::ptr(valuesPointer, 8*k, 0));
+    }
+
+    // Collect the constants, in the same way as generateJitCode().
+
+    batchConstants.clear();
+    vector<int> operationConstantIndex(operation.size(), -1);
+    for (int step = 0; step < (int) operation.size(); step++) {
+        Operation& op = *operation[step];
+        double value;
+        if (op.getId() == Operation::CONSTANT)
+            value = dynamic_cast<Operation::Constant&>(op).getValue();
+        else if (op.getId() == Operation::ADD_CONSTANT)
+            value = dynamic_cast<Operation::AddConstant&>(op).getValue();
+        else if (op.getId() == Operation::MULTIPLY_CONSTANT)
+            value = dynamic_cast<Operation::MultiplyConstant&>(op).getValue();
+        else if (op.getId() == Operation::RECIPROCAL)
+            value = 1.0;
+        else if (op.getId() == Operation::STEP)
+            value = 1.0;
+        else if (op.getId() == Operation::DELTA)
+            value = 1.0/0.0;
+        else if (op.getId() == Operation::NANDELTA)
+            value = std::numeric_limits<double>::quiet_NaN();
+        else
+            continue;
+        for (int i = 0; i < (int) batchConstants.size(); i++)
+            if (value == batchConstants[i]) {
+                operationConstantIndex[step] = i;
+                break;
+            }
+        if (operationConstantIndex[step] == -1) {
+            operationConstantIndex[step] = batchConstants.size();
+            batchConstants.push_back(value);
+        }
+    }
+
+    // Load the constants in both lanes.
+
+    vector<X86Xmm> constantVar(batchConstants.size());
+    if (batchConstants.size() > 0) {
+        X86Gp constantsPointer = c.newIntPtr();
+        c.mov(constantsPointer, imm_ptr(&batchConstants[0]));
+        for (int i = 0; i < (int) batchConstants.size(); i++) {
+            constantVar[i] = c.newXmmPd();
+            c.movsd(constantVar[i], x86::ptr(constantsPointer, 8*i, 0));
+            c.unpcklpd(constantVar[i], constantVar[i]);
+        }
+    }
+
+    // Loop over pairs of points, then do the last point if n is odd.
+
+    X86Gp index = c.newIntPtr();
+    X86Gp next = c.newIntPtr();
+    Label pairLoop = c.newLabel();
+    Label lastPoint = c.newLabel();
+    Label done = c.newLabel();
+    c.xor_(index, index);
+    c.bind(pairLoop);
+    c.mov(next, index);
+    c.add(next, 2);
+    c.cmp(next, count);
+    c.jg(lastPoint);
+    {
+        vector<X86Xmm> workspaceVar(workspace.size());
+        for (int i = 0; i < (int) workspaceVar.size(); i++)
+            workspaceVar[i] = c.newXmmPd();
+        for (int k = 0; k < (int) batchIndices.size(); k++)
+            if (batchIndices[k] >= 0)
+                c.movupd(workspaceVar[batchIndices[k]], x86::ptr(variablePointer[k], index, 3));
+        generateOperations(c, true, operation, arguments, target, operationConstantIndex, workspaceVar, constantVar, argsPointer, &argValues[0]);
+        c.movupd(x86::ptr(resultsPointer, index, 3), workspaceVar[workspace.size()-1]);
+    }
+    c.mov(index, next);
+    c.jmp(pairLoop);
+    c.bind(lastPoint);
+    c.cmp(index, count);
+    c.jge(done);
+    {
+        vector<X86Xmm> workspaceVar(workspace.size());
+        for (int i = 0; i < (int) workspaceVar.size(); i++)
+            workspaceVar[i] = c.newXmmSd();
+        for (int k = 0; k < (int) batchIndices.size(); k++)
+            if (batchIndices[k] >= 0)
+                c.movsd(workspaceVar[batchIndices[k]], x86::ptr(variablePointer[k], index, 3));
+        generateOperations(c, false, operation, arguments, target, operationConstantIndex, workspaceVar, constantVar, argsPointer, &argValues[0]);
+        c.movsd(x86::ptr(resultsPointer, index, 3), workspaceVar[workspace.size()-1]);
+    }
+    c.bind(done);
+    c.endFunc();
+    c.finalize();
+    runtime.add(&batchJitCode, &code);
+}
+
 void generateSingleArgCall(X86Compiler& c, X86Xmm& dest, X86Xmm& arg, double (*function)(double)) {
     X86Gp fn = c.newIntPtr();
     c.mov(fn, imm_ptr((void*) function));
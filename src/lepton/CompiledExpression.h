@@ -137,6 +137,19 @@ public:
      * Evaluate the expression.  The values of all variables should have been set before calling this.
      */
     double evaluate() const;
+    /**
+     * Set the variables whose values are passed to evaluateBatch(), in the order in which they are passed.
+     * Names that are not used by the expression are allowed and ignored, but every variable used by the
+     * expression must be in the list.
+     */
+    void setBatchVariables(const std::vector<std::string>& names);
+    /**
+     * Evaluate the expression at n points.  values[i] points to the n values of the i-th variable passed to
+     * setBatchVariables(), and the n results are stored in results.  Memory locations set with
+     * setVariableLocations() are not used.  When asmjit is used the points are evaluated two at a time
+     * with packed SSE2 instructions.
+     */
+    void evaluateBatch(int n, const double* const* values, double* results) const;
 private:
     friend class ParsedExpression;
     CompiledExpression(const ParsedExpression& expression);
@@ -155,6 +168,12 @@ private:
     void* jitCode;
     void generateJitCode();
     std::vector<double> constants;
+    double evaluateOperations() const;
+    std::vector<std::string> batchVariables;
+    std::vector<int> batchIndices;
+    void* batchJitCode;
+    void generateBatchJitCode();
+    std::vector<double> batchConstants;
     AsmJitRuntimePtr runtimeptr;
 };
 
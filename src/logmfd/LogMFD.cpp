@@ -439,6 +439,7 @@ public:
   explicit LogMFD(const ActionOptions&);
   void calculate();
   void update();
+  bool checkIsHistoryDependent()const override {return true;}
   void updateNVE();
   void updateNVT();
   void updateVS();
@@ -54,6 +54,7 @@ public:
   void calculate() {}
   void apply() {}
   void update();
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(PathDisplacements,"AVERAGE_PATH_DISPLACEMENT")
@@ -68,6 +68,7 @@ public:
   void calculate() {}
   void apply() {}
   void update();
+  bool checkIsHistoryDependent()const override {return true;}
 };
 
 PLUMED_REGISTER_ACTION(PathReparameterization,"REPARAMETERIZE_PATH")
@@ -92,6 +92,11 @@ public:
    */
   void calculate();
 
+  /**
+   * The optimal direction depends on the previous optimization steps.
+   */
+  bool checkIsHistoryDependent() const override {return true;}
+
   /**
    * Prepare the neighbor list.
    */
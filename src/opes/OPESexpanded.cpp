@@ -173,6 +173,7 @@ public:
   explicit OPESexpanded(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
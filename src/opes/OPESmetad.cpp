@@ -22,6 +22,8 @@
 #include "tools/Communicator.h"
 #include "tools/File.h"
 #include "tools/OpenMP.h"
+#include "tools/CellHash.h"
+#include "tools/BinaryFieldsFile.h"
 
 namespace PLMD {
 namespace opes {
@@ -81,6 +83,8 @@ Restart can be done from a KERNELS file, but it might be not perfect (due to lim
 For an exact restart you must use STATE_RFILE to read a checkpoint with all the needed info.
 To save such checkpoints, define a STATE_WFILE and choose how often to print them with STATE_WSTRIDE.
 By default this file is overwritten, but you can instead append to it using the flag STORE_STATES.
+With the flag STATE_BINARY the STATE_WFILE is written in a binary format, that is faster to write and to read when there are many kernels and that keeps all the digits of the stored numbers.
+Binary files are automatically recognized when given as STATE_RFILE, and can be converted to and from the usual text format with \ref convert_fields.
 
 Multiple walkers are supported only with MPI communication, via the keyword WALKERS_MPI.
 
@@ -214,6 +218,10 @@ private:
   double evaluateKernel(const kernel&,const std::vector<double>&,std::vector<double>&,std::vector<double>&);
   std::vector<kernel> kernels_; //all compressed kernels
   OFile kernelsOfile_;
+//spatial index of the kernel centers, used to find the kernels that are close to a point
+  CellHash kernels_index_;
+  std::vector<double> kernels_max_sigma_; //largest sigma of all the kernels ever indexed, it bounds the searches
+  std::vector<double> period_; //zero if not periodic
 //neighbour list stuff
   bool nlist_;
   double nlist_param_[2];
@@ -235,18 +243,25 @@ private:
   OFile stateOfile_;
   int wStateStride_;
   bool storeOldStates_;
+  bool binaryState_;
+  std::string binaryStateFileName_;
 
   double getProbAndDerivatives(const std::vector<double>&,std::vector<double>&);
   void addKernel(const double,const std::vector<double>&,const std::vector<double>&);
   void addKernel(const double,const std::vector<double>&,const std::vector<double>&,const double); //also print to file
   unsigned getMergeableKernel(const std::vector<double>&,const unsigned);
+  void indexKernel(const unsigned);
+  void rebuildKernelsIndex();
+  void getCloseKernels(const std::vector<double>&,const double,std::vector<unsigned>&) const; //sorted kernels that might be closer than the given number of sigmas
   void updateNlist(const std::vector<double>&);
   void dumpStateToFile();
+  void dumpStateToBinaryFile(const std::vector<double>&,const std::vector<double>&,const std::vector<double>&);
 
 public:
   explicit OPESmetad(const ActionOptions&);
   void calculate() override;
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
@@ -336,6 +351,7 @@ void OPESmetad<mode>::registerKeywords(Keywords& keys)
   keys.add("optional","STATE_WFILE","write to this file the compressed kernels and all the info needed to RESTART the simulation");
   keys.add("optional","STATE_WSTRIDE","number of MD steps between writing the STATE_WFILE. Default is only on CPT events (but not all MD codes set them)");
   keys.addFlag("STORE_STATES",false,"append to STATE_WFILE instead of ovewriting it each time");
+  keys.addFlag("STATE_BINARY",false,"write the STATE_WFILE in binary format");
 //miscellaneous
   keys.add("optional","EXCLUDED_REGION","kernels are not deposited when the action provided here has a nonzero value, see example above");
   if(!mode::explore)
@@ -370,6 +386,17 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
   std::string error_in_input1("Error in input in action "+getName()+" with label "+getLabel()+": the keyword ");
   std::string error_in_input2(" could not be read correctly");
 
+  period_.assign(ncv_,0.0);
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    if(getPntrToArgument(i)->isPeriodic())
+    {
+      double min,max;
+      getPntrToArgument(i)->getDomain(min,max);
+      period_[i]=max-min;
+    }
+  }
+
 //set kbt_
   const double kB=getKBoltzmann();
   kbt_=getkBT();
@@ -536,6 +563,13 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
   parse("STATE_WSTRIDE",wStateStride_);
   storeOldStates_=false;
   parseFlag("STORE_STATES",storeOldStates_);
+  binaryState_=false;
+  parseFlag("STATE_BINARY",binaryState_);
+  if(binaryState_)
+  {
+    plumed_massert(stateFileName.length()>0,"filename for storing simulation status not specified, use STATE_WFILE");
+    plumed_massert(!storeOldStates_,"STORE_STATES cannot be used with STATE_BINARY");
+  }
   if(wStateStride_!=0 || storeOldStates_)
     plumed_massert(stateFileName.length()>0,"filename for storing simulation status not specified, use STATE_WFILE");
   if(wStateStride_>0)
@@ -593,11 +627,23 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
     }
     IFile ifile;
     ifile.link(*this);
+    BinaryFieldsFile bfile;
     if(ifile.FileExist(restartFileName))
     {
       bool tmp_nlist=nlist_;
       nlist_=false; // NLIST is not needed while restarting
-      ifile.open(restartFileName);
+      const bool binaryRestart=stateRestart && BinaryFieldsFile::isBinary(ifile.getPath());
+      if(binaryRestart)
+        bfile.read(ifile.getPath());
+      else
+        ifile.open(restartFileName);
+      auto scanConstant=[&](const std::string& name,auto& value)
+      {
+        if(binaryRestart)
+          bfile.getConstant(name,value);
+        else
+          ifile.scanField(name,value);
+      };
       log.printf("  RESTART - make sure all used options are compatible\n");
       log.printf("    restarting from: %s\n",restartFileName.c_str());
       std::string action_name=getName();
@@ -612,10 +658,10 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
         action_name+="_kernels";
       }
       std::string old_action_name;
-      ifile.scanField("action",old_action_name);
+      scanConstant("action",old_action_name);
       plumed_massert(action_name==old_action_name,"RESTART - mismatch between old and new action name. Expected '"+action_name+"', but found '"+old_action_name+"'");
       std::string old_biasfactor_str;
-      ifile.scanField("biasfactor",old_biasfactor_str);
+      scanConstant("biasfactor",old_biasfactor_str);
       if(old_biasfactor_str=="inf" || old_biasfactor_str=="INF")
       {
         if(!std::isinf(biasfactor_))
@@ -624,39 +670,39 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
       else
       {
         double old_biasfactor;
-        ifile.scanField("biasfactor",old_biasfactor);
+        scanConstant("biasfactor",old_biasfactor);
         if(std::abs(biasfactor_-old_biasfactor)>1e-6*biasfactor_)
           log.printf(" +++ WARNING +++ previous bias factor was %g while now it is %g. diff = %g\n",old_biasfactor,biasfactor_,biasfactor_-old_biasfactor);
       }
       double old_epsilon;
-      ifile.scanField("epsilon",old_epsilon);
+      scanConstant("epsilon",old_epsilon);
       if(std::abs(epsilon_-old_epsilon)>1e-6*epsilon_)
         log.printf(" +++ WARNING +++ previous epsilon was %g while now it is %g. diff = %g\n",old_epsilon,epsilon_,epsilon_-old_epsilon);
       double old_cutoff;
-      ifile.scanField("kernel_cutoff",old_cutoff);
+      scanConstant("kernel_cutoff",old_cutoff);
       if(std::abs(cutoff-old_cutoff)>1e-6*cutoff)
         log.printf(" +++ WARNING +++ previous kernel_cutoff was %g while now it is %g. diff = %g\n",old_cutoff,cutoff,cutoff-old_cutoff);
       double old_threshold;
       const double threshold=sqrt(threshold2_);
-      ifile.scanField("compression_threshold",old_threshold);
+      scanConstant("compression_threshold",old_threshold);
       if(std::abs(threshold-old_threshold)>1e-6*threshold)
         log.printf(" +++ WARNING +++ previous compression_threshold was %g while now it is %g. diff = %g\n",old_threshold,threshold,threshold-old_threshold);
       if(stateRestart)
       {
-        ifile.scanField("zed",Zed_);
-        ifile.scanField("sum_weights",sum_weights_);
-        ifile.scanField("sum_weights2",sum_weights2_);
-        ifile.scanField("counter",counter_);
+        scanConstant("zed",Zed_);
+        scanConstant("sum_weights",sum_weights_);
+        scanConstant("sum_weights2",sum_weights2_);
+        scanConstant("counter",counter_);
         if(adaptive_sigma_)
         {
-          ifile.scanField("adaptive_counter",adaptive_counter_);
+          scanConstant("adaptive_counter",adaptive_counter_);
           if(NumWalkers_==1)
           {
             for(unsigned i=0; i<ncv_; i++)
             {
-              ifile.scanField("sigma0_"+getPntrToArgument(i)->getName(),sigma0_[i]);
-              ifile.scanField("av_cv_"+getPntrToArgument(i)->getName(),av_cv_[i]);
-              ifile.scanField("av_M2_"+getPntrToArgument(i)->getName(),av_M2_[i]);
+              scanConstant("sigma0_"+getPntrToArgument(i)->getName(),sigma0_[i]);
+              scanConstant("av_cv_"+getPntrToArgument(i)->getName(),av_cv_[i]);
+              scanConstant("av_M2_"+getPntrToArgument(i)->getName(),av_M2_[i]);
             }
           }
           else
@@ -666,9 +712,9 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
               {
                 double tmp0,tmp1,tmp2;
                 const std::string arg_iw=getPntrToArgument(i)->getName()+"_"+std::to_string(w);
-                ifile.scanField("sigma0_"+arg_iw,tmp0);
-                ifile.scanField("av_cv_"+arg_iw,tmp1);
-                ifile.scanField("av_M2_"+arg_iw,tmp2);
+                scanConstant("sigma0_"+arg_iw,tmp0);
+                scanConstant("av_cv_"+arg_iw,tmp1);
+                scanConstant("av_M2_"+arg_iw,tmp2);
                 if(w==walker_rank_)
                 {
                   sigma0_[i]=tmp0;
@@ -686,13 +732,38 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
           std::string arg_min,arg_max;
           getPntrToArgument(i)->getDomain(arg_min,arg_max);
           std::string file_min,file_max;
-          ifile.scanField("min_"+getPntrToArgument(i)->getName(),file_min);
-          ifile.scanField("max_"+getPntrToArgument(i)->getName(),file_max);
+          scanConstant("min_"+getPntrToArgument(i)->getName(),file_min);
+          scanConstant("max_"+getPntrToArgument(i)->getName(),file_max);
           plumed_massert(file_min==arg_min,"RESTART - mismatch between old and new ARG periodicity");
           plumed_massert(file_max==arg_max,"RESTART - mismatch between old and new ARG periodicity");
         }
       }
-      if(stateRestart)
+      if(binaryRestart)
+      {
+        std::vector<const double*> centers(ncv_);
+        std::vector<const double*> sigmas(ncv_);
+        for(unsigned i=0; i<ncv_; i++)
+        {
+          centers[i]=bfile.getColumn(getPntrToArgument(i)->getName());
+          sigmas[i]=bfile.getColumn("sigma_"+getPntrToArgument(i)->getName());
+        }
+        const double* heights=bfile.getColumn("height");
+        kernels_.reserve(bfile.getNumberOfRows());
+        for(unsigned k=0; k<bfile.getNumberOfRows(); k++)
+        {
+          std::vector<double> center(ncv_);
+          std::vector<double> sigma(ncv_);
+          for(unsigned i=0; i<ncv_; i++)
+          {
+            center[i]=centers[i][k];
+            sigma[i]=sigmas[i][k];
+          }
+          kernels_.emplace_back(heights[k],center,sigma);
+          indexKernel(kernels_.size()-1);
+        }
+        log.printf("    a total of %lu kernels where read from a binary file\n",kernels_.size());
+      }
+      else if(stateRestart)
       {
         double time;
         while(ifile.scanField("time",time))
@@ -707,6 +778,7 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
           ifile.scanField("height",height);
           ifile.scanField();
           kernels_.emplace_back(height,center,sigma);
+          indexKernel(kernels_.size()-1);
         }
         log.printf("    a total of %lu kernels where read\n",kernels_.size());
       }
@@ -739,9 +811,13 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
         if(!no_Zed_)
         {
           double sum_uprob=0;
+          std::vector<unsigned> close_kernels;
           for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
-            for(unsigned kk=0; kk<kernels_.size(); kk++)
+          {
+            getCloseKernels(kernels_[k].center,sqrt(cutoff2_),close_kernels);
+            for(const auto kk : close_kernels)
               sum_uprob+=evaluateKernel(kernels_[kk],kernels_[k].center);
+          }
           if(NumParallel_>1)
             comm.Sum(sum_uprob);
           Zed_=sum_uprob/KDEnorm_/kernels_.size();
@@ -749,8 +825,11 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
         log.printf("    a total of %llu kernels where read, and compressed to %lu\n",counter_-1,kernels_.size());
         convertKernelsToState=true;
       }
-      ifile.reset(false);
-      ifile.close();
+      if(!binaryRestart)
+      {
+        ifile.reset(false);
+        ifile.close();
+      }
       nlist_=tmp_nlist;
     }
     else //same behaviour as METAD
@@ -814,6 +893,11 @@ OPESmetad<mode>::OPESmetad(const ActionOptions& ao)
       stateOfile_.enforceSuffix("");
     }
     stateOfile_.open(stateFileName);
+    if(binaryState_)
+    { //the file is only opened to take care of backups and suffixes, and then replaced each time
+      binaryStateFileName_=stateOfile_.getPath();
+      stateOfile_.close();
+    }
     if(fmt.length()>0)
       stateOfile_.fmtField(" "+fmt);
     if(convertKernelsToState)
@@ -1180,10 +1264,14 @@ void OPESmetad<mode>::update()
       {
         #pragma omp parallel num_threads(NumOMP_)
         {
+          std::vector<unsigned> close_kernels;
           #pragma omp for reduction(+:sum_uprob) nowait
           for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
-            for(unsigned kk=0; kk<kernels_.size(); kk++)
+          {
+            getCloseKernels(kernels_[k].center,sqrt(cutoff2_),close_kernels);
+            for(const auto kk : close_kernels)
               sum_uprob+=evaluateKernel(kernels_[kk],kernels_[k].center);
+          }
         }
         if(NumParallel_>1)
           comm.Sum(sum_uprob);
@@ -1195,17 +1283,17 @@ void OPESmetad<mode>::update()
         // and we also need to consider that in the new sum there are some novel centers and some disappeared ones
         double delta_sum_uprob=0;
         if(!nlist_)
-        {
-          #pragma omp parallel num_threads(NumOMP_)
+        { //only the kernels within the cutoff of a delta kernel contribute
+          for(unsigned d=0; d<delta_kernels_.size(); d++)
           {
-            #pragma omp for reduction(+:delta_sum_uprob) nowait
-            for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
+            const double sign=delta_kernels_[d].height<0?-1:1; //take away contribution from kernels that are gone, and add the one from new ones
+            std::vector<unsigned> close_kernels;
+            getCloseKernels(delta_kernels_[d].center,sqrt(cutoff2_),close_kernels);
+            #pragma omp parallel for num_threads(NumOMP_) reduction(+:delta_sum_uprob)
+            for(unsigned nk=rank_; nk<close_kernels.size(); nk+=NumParallel_)
             {
-              for(unsigned d=0; d<delta_kernels_.size(); d++)
-              {
-                const double sign=delta_kernels_[d].height<0?-1:1; //take away contribution from kernels that are gone, and add the one from new ones
-                delta_sum_uprob+=evaluateKernel(delta_kernels_[d],kernels_[k].center)+sign*evaluateKernel(kernels_[k],delta_kernels_[d].center);
-              }
+              const unsigned k=close_kernels[nk];
+              delta_sum_uprob+=evaluateKernel(delta_kernels_[d],kernels_[k].center)+sign*evaluateKernel(kernels_[k],delta_kernels_[d].center);
             }
           }
         }
@@ -1339,7 +1427,9 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
     {
       no_match=false;
       delta_kernels_.emplace_back(-1*kernels_[taker_k].height,kernels_[taker_k].center,kernels_[taker_k].sigma);
+      kernels_index_.remove(taker_k,kernels_[taker_k].center);
       mergeKernels(kernels_[taker_k],kernel(height,center,sigma));
+      indexKernel(taker_k);
       delta_kernels_.push_back(kernels_[taker_k]);
       if(recursive_merge_) //the overhead is worth it if it keeps low the total number of kernels
       {
@@ -1354,6 +1444,7 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
           mergeKernels(kernels_[taker_k],kernels_[giver_k]);
           delta_kernels_.push_back(kernels_[taker_k]);
           kernels_.erase(kernels_.begin()+giver_k);
+          rebuildKernelsIndex(); //all the indexes after giver_k are shifted
           if(nlist_)
           {
             unsigned giver_nk=0;
@@ -1380,6 +1471,7 @@ void OPESmetad<mode>::addKernel(const double height,const std::vector<double>& c
   if(no_match)
   {
     kernels_.emplace_back(height,center,sigma);
+    indexKernel(kernels_.size()-1);
     delta_kernels_.emplace_back(height,center,sigma);
     if(nlist_)
       nlist_index_.push_back(kernels_.size()-1);
@@ -1407,14 +1499,17 @@ unsigned OPESmetad<mode>::getMergeableKernel(const std::vector<double>& giver_ce
   unsigned min_k=kernels_.size();
   double min_norm2=threshold2_;
   if(!nlist_)
-  {
+  { //only the kernels that are in the cells close to the giver are candidates
+    std::vector<unsigned> close_kernels;
+    getCloseKernels(giver_center,sqrt(threshold2_),close_kernels);
     #pragma omp parallel num_threads(NumOMP_)
     {
       unsigned min_k_omp = min_k;
       double min_norm2_omp = threshold2_;
       #pragma omp for nowait
-      for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
+      for(unsigned nk=rank_; nk<close_kernels.size(); nk+=NumParallel_)
       {
+        const unsigned k=close_kernels[nk];
         if(k==giver_k) //a kernel should not be merged with itself
           continue;
         double norm2=0;
@@ -1497,11 +1592,15 @@ void OPESmetad<mode>::updateNlist(const std::vector<double>& new_center)
 
   nlist_center_=new_center;
   nlist_index_.clear();
+  //only the kernels in the cells close to the new center are candidates
+  std::vector<unsigned> close_kernels;
+  getCloseKernels(nlist_center_,sqrt(nlist_param_[0]*cutoff2_),close_kernels);
   //first we gather all the nlist_index
-  if(NumOMP_==1 || (unsigned)kernels_.size()<2*NumOMP_*NumParallel_)
+  if(NumOMP_==1 || (unsigned)close_kernels.size()<2*NumOMP_*NumParallel_)
   {
-    for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
+    for(unsigned nk=rank_; nk<close_kernels.size(); nk+=NumParallel_)
     {
+      const unsigned k=close_kernels[nk];
       double norm2_k=0;
       for(unsigned i=0; i<ncv_; i++)
       {
@@ -1518,8 +1617,9 @@ void OPESmetad<mode>::updateNlist(const std::vector<double>& new_center)
     {
       std::vector<unsigned> private_nlist_index;
       #pragma omp for nowait
-      for(unsigned k=rank_; k<kernels_.size(); k+=NumParallel_)
+      for(unsigned nk=rank_; nk<close_kernels.size(); nk+=NumParallel_)
       {
+        const unsigned k=close_kernels[nk];
         double norm2_k=0;
         for(unsigned i=0; i<ncv_; i++)
         {
@@ -1603,6 +1703,11 @@ void OPESmetad<mode>::dumpStateToFile()
     comm.Bcast(all_av_cv,0);
     comm.Bcast(all_av_M2,0);
   }
+  if(binaryState_)
+  {
+    dumpStateToBinaryFile(all_sigma0,all_av_cv,all_av_M2);
+    return;
+  }
 
 //rewrite header or rewind file
   if(storeOldStates_)
@@ -1695,6 +1800,76 @@ void OPESmetad<mode>::dumpStateToFile()
     stateOfile_.flush();
 }
 
+template <class mode>
+void OPESmetad<mode>::dumpStateToBinaryFile(const std::vector<double>& all_sigma0,const std::vector<double>& all_av_cv,const std::vector<double>& all_av_M2)
+{ //same fields as dumpStateToFile, kernels are stored column by column
+  if(comm.Get_rank()!=0 || walker_rank_!=0)
+    return;
+  BinaryFieldsFile bfile;
+  bfile.setConstant("action",getName()+"_state");
+  bfile.setConstant("biasfactor",biasfactor_);
+  bfile.setConstant("epsilon",epsilon_);
+  bfile.setConstant("kernel_cutoff",sqrt(cutoff2_));
+  bfile.setConstant("compression_threshold",sqrt(threshold2_));
+  bfile.setConstant("zed",Zed_);
+  bfile.setConstant("sum_weights",sum_weights_);
+  bfile.setConstant("sum_weights2",sum_weights2_);
+  bfile.setConstant("counter",counter_);
+  if(adaptive_sigma_)
+  {
+    bfile.setConstant("adaptive_counter",adaptive_counter_);
+    if(NumWalkers_==1)
+    {
+      for(unsigned i=0; i<ncv_; i++)
+      {
+        bfile.setConstant("sigma0_"+getPntrToArgument(i)->getName(),sigma0_[i]);
+        bfile.setConstant("av_cv_"+getPntrToArgument(i)->getName(),av_cv_[i]);
+        bfile.setConstant("av_M2_"+getPntrToArgument(i)->getName(),av_M2_[i]);
+      }
+    }
+    else
+    {
+      for(unsigned w=0; w<NumWalkers_; w++)
+        for(unsigned i=0; i<ncv_; i++)
+        {
+          const std::string arg_iw=getPntrToArgument(i)->getName()+"_"+std::to_string(w);
+          bfile.setConstant("sigma0_"+arg_iw,all_sigma0[w*ncv_+i]);
+          bfile.setConstant("av_cv_"+arg_iw,all_av_cv[w*ncv_+i]);
+          bfile.setConstant("av_M2_"+arg_iw,all_av_M2[w*ncv_+i]);
+        }
+    }
+  }
+  for(unsigned i=0; i<ncv_; i++)
+  { //periodicity of CVs
+    if(getPntrToArgument(i)->isPeriodic())
+    {
+      std::string arg_min,arg_max;
+      getPntrToArgument(i)->getDomain(arg_min,arg_max);
+      bfile.setConstant("min_"+getPntrToArgument(i)->getName(),arg_min);
+      bfile.setConstant("max_"+getPntrToArgument(i)->getName(),arg_max);
+    }
+  }
+  bfile.setNumberOfRows(kernels_.size());
+  double* time=bfile.addColumn("time");
+  std::fill(time,time+kernels_.size(),getTime()); //this is not very usefull
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    double* center=bfile.addColumn(getPntrToArgument(i)->getName());
+    for(unsigned k=0; k<kernels_.size(); k++)
+      center[k]=kernels_[k].center[i];
+  }
+  for(unsigned i=0; i<ncv_; i++)
+  {
+    double* sigma=bfile.addColumn("sigma_"+getPntrToArgument(i)->getName());
+    for(unsigned k=0; k<kernels_.size(); k++)
+      sigma[k]=kernels_[k].sigma[i];
+  }
+  double* height=bfile.addColumn("height");
+  for(unsigned k=0; k<kernels_.size(); k++)
+    height[k]=kernels_[k].height;
+  bfile.write(binaryStateFileName_);
+}
+
 template <class mode>
 inline double OPESmetad<mode>::evaluateKernel(const kernel& G,const std::vector<double>& x) const
 { //NB: cannot be a method of kernel class, because uses external variables (for cutoff)
@@ -1726,6 +1901,43 @@ inline double OPESmetad<mode>::evaluateKernel(const kernel& G,const std::vector<
   return val;
 }
 
+template <class mode>
+void OPESmetad<mode>::indexKernel(const unsigned k)
+{
+  if(!kernels_index_.enabled())
+  { //cells are sized from the first kernel, so that a cell is about as large as the kernel cutoff
+    std::vector<double> cellsize(ncv_);
+    for(unsigned i=0; i<ncv_; i++)
+      cellsize[i]=sqrt(cutoff2_)*kernels_[k].sigma[i];
+    kernels_index_.setup(cellsize,period_);
+    kernels_max_sigma_.assign(ncv_,0.);
+  }
+  for(unsigned i=0; i<ncv_; i++)
+    kernels_max_sigma_[i]=std::max(kernels_max_sigma_[i],kernels_[k].sigma[i]);
+  kernels_index_.insert(k,kernels_[k].center);
+}
+
+template <class mode>
+void OPESmetad<mode>::rebuildKernelsIndex()
+{
+  kernels_index_.clear();
+  for(unsigned k=0; k<kernels_.size(); k++)
+    indexKernel(k);
+}
+
+template <class mode>
+void OPESmetad<mode>::getCloseKernels(const std::vector<double>& center,const double max_norm,std::vector<unsigned>& close_kernels) const
+{ //a kernel k is closer than max_norm only if |center_i-kernels_[k].center_i|<max_norm*sigma_i for all i
+  close_kernels.clear();
+  if(kernels_.size()==0)
+    return;
+  std::vector<double> range(ncv_);
+  for(unsigned i=0; i<ncv_; i++)
+    range[i]=max_norm*kernels_max_sigma_[i];
+  kernels_index_.query(center,range,close_kernels);
+  std::sort(close_kernels.begin(),close_kernels.end()); //same order as kernels_, so sums are done in the same order
+}
+
 template <class mode>
 inline void OPESmetad<mode>::mergeKernels(kernel& k1,const kernel& k2)
 {
@@ -0,0 +1,93 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "core/ActionSetup.h"
+#include "core/ActionRegister.h"
+#include "core/PlumedMain.h"
+#include "tools/AsyncWriter.h"
+
+namespace PLMD {
+namespace setup {
+
+//+PLUMEDOC GENERIC ASYNC_OUTPUT
+/*
+Write the output files on a background thread.
+
+This is a Setup directive and, as such, should appear
+at the beginning of the input file. All the files that are opened for writing
+after it (e.g. by \ref PRINT, \ref METAD or \ref DUMPATOMS) are written on disk
+by a separate thread, so that the calculation does not wait for the file system.
+This can be useful on parallel file systems, when files are written very often.
+
+Data is collected in memory and passed to the background thread in chunks.
+At most BUFFER megabytes are kept in memory: if the disk cannot keep up, writing
+a file waits until some space is available. Data is written in the
+same order it was produced, and it is guaranteed to be on the file whenever a file is flushed
+(e.g. with \ref FLUSH), rewound or closed. Backups and restarts work as usual.
+
+Notice that the log file is always written directly. Also notice that files written with
+the xdrfile library (xtc and trr files in \ref DUMPATOMS) are not affected.
+
+\par Examples
+
+In the following input, the distance is written at every step without waiting for the disk,
+and the file is guaranteed to be complete every 1000 steps:
+\plumedfile
+ASYNC_OUTPUT
+d: DISTANCE ATOMS=1,2
+PRINT ARG=d FILE=colvar
+FLUSH STRIDE=1000
+\endplumedfile
+
+*/
+//+ENDPLUMEDOC
+
+class AsyncOutput :
+  public virtual ActionSetup
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit AsyncOutput(const ActionOptions&ao);
+};
+
+PLUMED_REGISTER_ACTION(AsyncOutput,"ASYNC_OUTPUT")
+
+void AsyncOutput::registerKeywords( Keywords& keys ) {
+  ActionSetup::registerKeywords(keys);
+  keys.add("compulsory","BUFFER","64","the maximum amount of data (in megabytes) that is kept in memory waiting to be written");
+}
+
+AsyncOutput::AsyncOutput(const ActionOptions&ao):
+  Action(ao),
+  ActionSetup(ao)
+{
+  double buffer;
+  parse("BUFFER",buffer);
+  if(buffer<=0) error("BUFFER should be positive");
+  checkRead();
+  AsyncWriter::get().setMaxBytes(static_cast<std::size_t>(buffer*1024*1024));
+  plumed.setAsyncOutput(true);
+  log.printf("  files opened from now on are written on a background thread\n");
+  log.printf("  keeping at most %f megabytes in memory\n",buffer);
+}
+
+}
+}
@@ -24,8 +24,6 @@
 #include "function/FunctionOfMatrix.h"
 #include "core/ActionRegister.h"
 
-#include <complex>
-
 namespace PLMD {
 namespace symfunc {
 
@@ -54,9 +52,12 @@ private:
   int tmom;
   std::vector<double> coeff_poly;
   std::vector<double> normaliz;
+/// The coefficients of the normalised m-th derivatives of the Legendre polynomial
+  std::vector<double> deriv_coeff;
   unsigned factorial( const unsigned& n ) const ;
-  double deriv_poly( const unsigned& m, const double& val, double& df ) const ;
-  void addVectorDerivatives( const unsigned& ival, const Vector& der, Matrix<double>& derivatives ) const ;
+/// Calculate the spherical harmonics.  L is the angular momentum if it is known at compile time or zero otherwise
+  template<int L>
+  void calcHarmonics( const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const ;
 public:
   void registerKeywords( Keywords& keys ) override;
   void read( ActionWithArguments* action ) override;
@@ -122,6 +123,17 @@ void SphericalHarmonic::read( ActionWithArguments* action ) {
   } else {
     action->error("Insert Legendre polynomial coefficients into SphericalHarmonics code");
   }
+
+  // The m-th derivative of the Legendre polynomial is sum_k deriv_coeff[m*(tmom+1)+k] x^k.  The coefficients are computed once here
+  // so the polynomials and their derivatives can be evaluated using Horner's method for each bond
+  deriv_coeff.assign( (tmom+1)*(tmom+1), 0.0 );
+  for(unsigned m=0; m<=tmom; ++m) {
+    for(unsigned k=0; k<=tmom-m; ++k) {
+      double fact=1.0;
+      for(unsigned j=k+1; j<=m+k; ++j) fact=fact*j;
+      deriv_coeff[m*(tmom+1)+k] = normaliz[m]*coeff_poly[m+k]*fact;
+    }
+  }
 }
 
 std::vector<std::string> SphericalHarmonic::getComponentsPerLabel() const {
@@ -141,95 +153,81 @@ void SphericalHarmonic::setPeriodicityForOutputs( ActionWithValue* action ) {
 }
 
 void SphericalHarmonic::calc( const ActionWithArguments* action, const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const {
+  // The most commonly used values of l get versions of the loops that the compiler can unroll
+  if( tmom==6 ) calcHarmonics<6>( args, vals, derivatives );
+  else if( tmom==4 ) calcHarmonics<4>( args, vals, derivatives );
+  else if( tmom==3 ) calcHarmonics<3>( args, vals, derivatives );
+  else calcHarmonics<0>( args, vals, derivatives );
+}
+
+template<int L>
+void SphericalHarmonic::calcHarmonics( const std::vector<double>& args, std::vector<double>& vals, Matrix<double>& derivatives ) const {
+  const int l = L>0 ? L : tmom;
   double weight=1; if( args.size()==4 ) weight = args[3];
   if( weight<epsilon ) return;
 
-  double dlen2 = args[0]*args[0]+args[1]*args[1]+args[2]*args[2];
-  double dlen = sqrt( dlen2 ); double dlen3 = dlen2*dlen;
-  double dpoly_ass, poly_ass=deriv_poly( 0, args[2]/dlen, dpoly_ass );
+  const double x=args[0], y=args[1], z=args[2];
+  const double dlen2 = x*x+y*y+z*z, idlen = 1.0 / sqrt( dlen2 ), idlen3 = idlen / dlen2;
+  const double costh = z*idlen;
   // Derivatives of z/r wrt x, y, z
-  Vector dz;
-  dz[0] = -( args[2] / dlen3 )*args[0];
-  dz[1] = -( args[2] / dlen3 )*args[1];
-  dz[2] = -( args[2] / dlen3 )*args[2] + (1.0 / dlen);
-  // Accumulate for m=0
-  vals[tmom] = weight*poly_ass;
-  addVectorDerivatives( tmom, weight*dpoly_ass*dz, derivatives );
-  if( args.size()==4 ) derivatives(tmom, 3) = poly_ass;
-
-  // The complex number of which we have to take powers
-  std::complex<double> com1( args[0]/dlen,args[1]/dlen ), dp_x, dp_y, dp_z;
-  std::complex<double> powered = std::complex<double>(1.0,0.0); std::complex<double> ii( 0.0, 1.0 );
-  Vector myrealvec, myimagvec, real_dz, imag_dz;
-  // Do stuff for all other m values
-  for(unsigned m=1; m<=tmom; ++m) {
-    // Calculate Legendre Polynomial
-    poly_ass=deriv_poly( m, args[2]/dlen, dpoly_ass );
-    // Real and imaginary parts of z
-    double real_z = real(com1*powered), imag_z = imag(com1*powered);
-
+  const double dzx = -z*idlen3*x, dzy = -z*idlen3*y, dzz = -z*idlen3*z + idlen;
+  // The real and imaginary parts of (x+iy)/r and their derivatives wrt x, y, z
+  const double re1 = x*idlen, im1 = y*idlen;
+  const double redx = idlen - x*x*idlen3, imdx = -x*y*idlen3;
+  const double redy = -x*y*idlen3, imdy = idlen - y*y*idlen3;
+  const double redz = -x*z*idlen3, imdz = -y*z*idlen3;
+  // The real and imaginary parts of ((x+iy)/r)^(m-1)
+  double repow=1.0, impow=0.0;
+  for(int m=0; m<=l; ++m) {
+    // Calculate the derivative of the Legendre polynomial and its derivative using Horner's method
+    const double* coeff = deriv_coeff.data() + m*(l+1);
+    double poly_ass=coeff[l-m], dpoly_ass=0;
+    for(int k=l-m-1; k>=0; --k) { dpoly_ass = dpoly_ass*costh + poly_ass; poly_ass = poly_ass*costh + coeff[k]; }
+
+    if( m==0 ) {
+      // Accumulate for m=0
+      vals[l] = weight*poly_ass;
+      derivatives(l,0) = weight*dpoly_ass*dzx; derivatives(l,1) = weight*dpoly_ass*dzy; derivatives(l,2) = weight*dpoly_ass*dzz;
+      if( args.size()==4 ) derivatives(l,3) = poly_ass;
+      continue;
+    }
+    // Real and imaginary parts of ((x+iy)/r)^m
+    const double real_z = re1*repow - im1*impow, imag_z = re1*impow + im1*repow;
     // Calculate steinhardt parameter
-    double tq6=poly_ass*real_z;   // Real part of steinhardt parameter
-    double itq6=poly_ass*imag_z;  // Imaginary part of steinhardt parameter
-
-    // Derivatives wrt ( x/r + iy )^m
-    double md=static_cast<double>(m);
-    dp_x = md*powered*( (1.0/dlen)-(args[0]*args[0])/dlen3-ii*(args[0]*args[1])/dlen3 );
-    dp_y = md*powered*( ii*(1.0/dlen)-(args[0]*args[1])/dlen3-ii*(args[1]*args[1])/dlen3 );
-    dp_z = md*powered*( -(args[0]*args[2])/dlen3-ii*(args[1]*args[2])/dlen3 );
-
-    // Derivatives of real and imaginary parts of above
-    real_dz[0] = real( dp_x ); real_dz[1] = real( dp_y ); real_dz[2] = real( dp_z );
-    imag_dz[0] = imag( dp_x ); imag_dz[1] = imag( dp_y ); imag_dz[2] = imag( dp_z );
-
+    const double tq6=poly_ass*real_z;   // Real part of steinhardt parameter
+    const double itq6=poly_ass*imag_z;  // Imaginary part of steinhardt parameter
+    // Derivatives of real and imaginary parts of ((x+iy)/r)^m
+    const double md=static_cast<double>(m);
+    const double real_dx = md*( repow*redx - impow*imdx ), imag_dx = md*( repow*imdx + impow*redx );
+    const double real_dy = md*( repow*redy - impow*imdy ), imag_dy = md*( repow*imdy + impow*redy );
+    const double real_dz = md*( repow*redz - impow*imdz ), imag_dz = md*( repow*imdz + impow*redz );
     // Complete derivative of steinhardt parameter
-    myrealvec = weight*dpoly_ass*real_z*dz + weight*poly_ass*real_dz;
-    myimagvec = weight*dpoly_ass*imag_z*dz + weight*poly_ass*imag_dz;
+    const double rx = weight*( dpoly_ass*real_z*dzx + poly_ass*real_dx ), ix = weight*( dpoly_ass*imag_z*dzx + poly_ass*imag_dx );
+    const double ry = weight*( dpoly_ass*real_z*dzy + poly_ass*real_dy ), iy = weight*( dpoly_ass*imag_z*dzy + poly_ass*imag_dy );
+    const double rz = weight*( dpoly_ass*real_z*dzz + poly_ass*real_dz ), iz = weight*( dpoly_ass*imag_z*dzz + poly_ass*imag_dz );
 
     // Real part
-    vals[tmom+m] = weight*tq6;
-    addVectorDerivatives( tmom+m, myrealvec, derivatives );
+    vals[l+m] = weight*tq6;
+    derivatives(l+m,0) = rx; derivatives(l+m,1) = ry; derivatives(l+m,2) = rz;
     // Imaginary part
-    vals[3*tmom+1+m] = weight*itq6;
-    addVectorDerivatives( 3*tmom+1+m, myimagvec, derivatives );
-    // Store -m part of vector
-    double pref=pow(-1.0,m);
+    vals[3*l+1+m] = weight*itq6;
+    derivatives(3*l+1+m,0) = ix; derivatives(3*l+1+m,1) = iy; derivatives(3*l+1+m,2) = iz;
     // -m part of vector is just +m part multiplied by (-1.0)**m and multiplied by complex
     // conjugate of Legendre polynomial
+    const double pref = (m%2==0) ? 1.0 : -1.0;
     // Real part
-    vals[tmom-m] = pref*weight*tq6;
-    addVectorDerivatives( tmom-m, pref*myrealvec, derivatives );
+    vals[l-m] = pref*weight*tq6;
+    derivatives(l-m,0) = pref*rx; derivatives(l-m,1) = pref*ry; derivatives(l-m,2) = pref*rz;
     // Imaginary part
-    vals[3*tmom+1-m] = -pref*weight*itq6;
-    addVectorDerivatives( 3*tmom+1-m, -pref*myimagvec, derivatives );
+    vals[3*l+1-m] = -pref*weight*itq6;
+    derivatives(3*l+1-m,0) = -pref*ix; derivatives(3*l+1-m,1) = -pref*iy; derivatives(3*l+1-m,2) = -pref*iz;
     if( args.size()==4 ) {
-      derivatives(tmom+m,3)=tq6; derivatives(3*tmom+1+m, 3)=itq6;
-      derivatives(tmom-m,3)=pref*tq6; derivatives(3*tmom+1-m, 3)=-pref*itq6;
+      derivatives(l+m,3)=tq6; derivatives(3*l+1+m, 3)=itq6;
+      derivatives(l-m,3)=pref*tq6; derivatives(3*l+1-m, 3)=-pref*itq6;
     }
-    // Calculate next power of complex number
-    powered *= com1;
-  }
-}
-
-double SphericalHarmonic::deriv_poly( const unsigned& m, const double& val, double& df ) const {
-  double fact=1.0;
-  for(unsigned j=1; j<=m; ++j) fact=fact*j;
-  double res=coeff_poly[m]*fact;
-
-  double pow=1.0, xi=val, dxi=1.0; df=0.0;
-  for(int i=m+1; i<=tmom; ++i) {
-    fact=1.0;
-    for(unsigned j=i-m+1; j<=i; ++j) fact=fact*j;
-    res=res+coeff_poly[i]*fact*xi;
-    df = df + pow*coeff_poly[i]*fact*dxi;
-    xi=xi*val; dxi=dxi*val; pow+=1.0;
+    // Store the next power of (x+iy)/r
+    repow = real_z; impow = imag_z;
   }
-  df = df*normaliz[m];
-  return normaliz[m]*res;
-}
-
-void SphericalHarmonic::addVectorDerivatives( const unsigned& ival, const Vector& der, Matrix<double>& derivatives ) const {
-  for(unsigned j=0; j<3; ++j) derivatives(ival,j) = der[j];
 }
 
 }
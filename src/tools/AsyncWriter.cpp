@@ -0,0 +1,103 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "AsyncWriter.h"
+
+namespace PLMD {
+
+AsyncWriter::AsyncWriter(std::size_t maxBytes):
+  maxBytes(maxBytes)
+{
+  worker=std::thread([this]() { run(); });
+}
+
+AsyncWriter::~AsyncWriter() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    stop=true;
+  }
+  cvWork.notify_all();
+  worker.join();
+}
+
+AsyncWriter& AsyncWriter::get() {
+// 64 MB unless differently specified with ASYNC_OUTPUT
+  static AsyncWriter writer(64*1024*1024);
+  return writer;
+}
+
+void AsyncWriter::setMaxBytes(std::size_t n) {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    maxBytes=n;
+  }
+  cvDone.notify_all();
+}
+
+void AsyncWriter::run() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while(true) {
+// pending jobs are completed before stopping
+    cvWork.wait(lock,[this]() { return stop || !queue.empty(); });
+    if(queue.empty()) return;
+    auto job=std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+    try {
+      job.run();
+    } catch(...) {
+      lock.lock();
+      auto & error(errors[job.owner]);
+      if(!error) error=std::current_exception();
+      lock.unlock();
+    }
+    lock.lock();
+    queuedBytes-=job.nbytes;
+    ncompleted++;
+    cvDone.notify_all();
+  }
+}
+
+std::uint64_t AsyncWriter::submit(std::size_t nbytes,std::function<void()> job,const void* owner) {
+  std::uint64_t ticket;
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    cvDone.wait(lock,[&]() { return queuedBytes==0 || queuedBytes+nbytes<=maxBytes; });
+    queue.push_back(Job{nbytes,std::move(job),owner});
+    queuedBytes+=nbytes;
+    ticket=++nsubmitted;
+  }
+  cvWork.notify_one();
+  return ticket;
+}
+
+void AsyncWriter::wait(std::uint64_t ticket,const void* owner) {
+  std::unique_lock<std::mutex> lock(mtx);
+  cvDone.wait(lock,[&]() { return ncompleted>=ticket; });
+  auto it=errors.find(owner);
+  if(it!=errors.end()) {
+    auto e=it->second;
+    errors.erase(it);
+    std::rethrow_exception(e);
+  }
+}
+
+}
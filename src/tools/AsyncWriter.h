@@ -0,0 +1,94 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_AsyncWriter_h
+#define __PLUMED_tools_AsyncWriter_h
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// A background thread running write operations in the order they are submitted.
+/// It is used by OFile in asynchronous mode (see \ref ASYNC_OUTPUT), so that writing
+/// on disk does not block the calculation.
+/// Memory is bounded: submit() waits if the data already in the queue would exceed the limit.
+///
+/// \verbatim
+/// auto ticket=AsyncWriter::get().submit(data.size(),[data=std::move(data),fp]() { std::fwrite(data.data(),1,data.size(),fp); },fp);
+/// // ...
+/// AsyncWriter::get().wait(ticket,fp); // data has been written
+/// \endverbatim
+class AsyncWriter {
+  std::mutex mtx;
+/// Signals the worker that a job was submitted or that the writer is being destroyed
+  std::condition_variable cvWork;
+/// Signals the submitting threads that a job was completed
+  std::condition_variable cvDone;
+/// A job in the queue
+  struct Job {
+    std::size_t nbytes;
+    std::function<void()> run;
+    const void* owner;
+  };
+  std::deque<Job> queue;
+/// Number of bytes in the queue
+  std::size_t queuedBytes=0;
+  std::size_t maxBytes;
+  std::uint64_t nsubmitted=0;
+  std::uint64_t ncompleted=0;
+/// First exception thrown by the jobs of each owner and not reported yet
+  std::map<const void*,std::exception_ptr> errors;
+  bool stop=false;
+  std::thread worker;
+/// Loop run by the worker
+  void run();
+public:
+/// Create a writer keeping at most maxBytes bytes in its queue
+  explicit AsyncWriter(std::size_t maxBytes);
+  ~AsyncWriter();
+  AsyncWriter(const AsyncWriter&)=delete;
+  AsyncWriter& operator=(const AsyncWriter&)=delete;
+/// Writer shared by all the files
+  static AsyncWriter& get();
+/// Change the maximum number of bytes in the queue
+  void setMaxBytes(std::size_t n);
+/// Queue a job writing nbytes bytes and return its ticket.
+/// A job larger than the limit is accepted when the queue is empty.
+/// owner identifies who should be notified if the job throws (e.g. the file it writes to).
+  std::uint64_t submit(std::size_t nbytes,std::function<void()> job,const void* owner);
+/// Wait until the job with the given ticket and all the ones submitted before are completed.
+/// Exceptions thrown by the jobs of the same owner are rethrown here.
+  void wait(std::uint64_t ticket,const void* owner);
+};
+
+}
+
+#endif
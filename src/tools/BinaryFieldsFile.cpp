@@ -0,0 +1,290 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "BinaryFieldsFile.h"
+#include "Exception.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(__has_include)
+#if __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#define __PLUMED_BINARYFIELDSFILE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace PLMD {
+
+namespace {
+
+const char signature[8]= {'P','L','U','M','E','D','B','F'};
+
+const std::uint32_t endianness=0x01020304;
+
+/// Size of the header: signature, version, endianness, size and checksum of the payload
+const std::size_t headersize=8+4+4+8+8;
+
+/// 64 bits FNV-1a hash
+std::uint64_t checksum(const char* p,std::size_t n) {
+  std::uint64_t h=14695981039346656037ULL;
+  for(std::size_t i=0; i<n; i++) {
+    h^=static_cast<unsigned char>(p[i]);
+    h*=1099511628211ULL;
+  }
+  return h;
+}
+
+template<typename T>
+void put(std::string& buffer,const T& x) {
+  buffer.append(reinterpret_cast<const char*>(&x),sizeof(T));
+}
+
+void putString(std::string& buffer,const std::string& s) {
+  put(buffer,std::uint64_t(s.length()));
+  buffer.append(s);
+}
+
+/// Sequential reader of a payload, checking that nothing is read past its end
+class Cursor {
+  const char* p;
+  std::size_t n;
+  std::size_t pos=0;
+  const std::string& path;
+public:
+  Cursor(const char* p,std::size_t n,const std::string& path): p(p), n(n), path(path) {}
+  const char* skip(std::size_t m) {
+    plumed_massert(m<=n-pos,"binary file " + path + " is truncated");
+    const char* r=p+pos;
+    pos+=m;
+    return r;
+  }
+  template<typename T>
+  T get() {
+    T x;
+    std::memcpy(&x,skip(sizeof(T)),sizeof(T));
+    return x;
+  }
+  std::string getString() {
+    std::uint64_t l=get<std::uint64_t>();
+    plumed_massert(l<=n-pos,"binary file " + path + " is truncated");
+    return std::string(skip(l),l);
+  }
+  void align() {
+    skip((8-pos%8)%8);
+  }
+  std::size_t remaining() const {
+    return n-pos;
+  }
+};
+
+}
+
+class BinaryFieldsFile::Mapping {
+public:
+  const char* data=nullptr;
+  std::size_t size=0;
+#ifdef __PLUMED_BINARYFIELDSFILE_MMAP
+  void* addr=MAP_FAILED;
+#endif
+/// Used when memory mapping is not available or fails
+  std::vector<double> buffer;
+  explicit Mapping(const std::string& path) {
+#ifdef __PLUMED_BINARYFIELDSFILE_MMAP
+    int fd=::open(path.c_str(),O_RDONLY);
+    plumed_massert(fd>=0,"cannot open file " + path);
+    struct stat st;
+    if(::fstat(fd,&st)==0 && st.st_size>0) {
+      size=st.st_size;
+      addr=::mmap(nullptr,size,PROT_READ,MAP_PRIVATE,fd,0);
+    }
+    ::close(fd);
+    if(addr!=MAP_FAILED) {
+      data=static_cast<const char*>(addr);
+      return;
+    }
+#endif
+    std::ifstream ifs(path,std::ios::binary);
+    plumed_massert(ifs,"cannot open file " + path);
+    ifs.seekg(0,std::ios::end);
+    size=ifs.tellg();
+    ifs.seekg(0,std::ios::beg);
+// a vector of doubles, so that columns are aligned
+    buffer.resize((size+sizeof(double)-1)/sizeof(double));
+    ifs.read(reinterpret_cast<char*>(buffer.data()),size);
+    plumed_massert(ifs,"cannot read file " + path);
+    data=reinterpret_cast<const char*>(buffer.data());
+  }
+  ~Mapping() {
+#ifdef __PLUMED_BINARYFIELDSFILE_MMAP
+    if(addr!=MAP_FAILED) ::munmap(addr,size);
+#endif
+  }
+  Mapping(const Mapping&)=delete;
+  Mapping& operator=(const Mapping&)=delete;
+};
+
+const std::uint32_t BinaryFieldsFile::version=1;
+
+BinaryFieldsFile::BinaryFieldsFile():
+  nrows(0),
+  first(nullptr)
+{}
+
+BinaryFieldsFile::~BinaryFieldsFile() {}
+
+bool BinaryFieldsFile::isBinary(const std::string& path) {
+  std::ifstream ifs(path,std::ios::binary);
+  if(!ifs) return false;
+  char s[sizeof(signature)];
+  ifs.read(s,sizeof(s));
+  return ifs && std::memcmp(s,signature,sizeof(s))==0;
+}
+
+void BinaryFieldsFile::clear() {
+  mapping.reset();
+  constants.clear();
+  columns.clear();
+  nrows=0;
+  data.clear();
+  first=nullptr;
+}
+
+void BinaryFieldsFile::setConstant(const std::string& name,const std::string& value) {
+  for(auto & c : constants) if(c.first==name) {
+      c.second=value;
+      return;
+    }
+  constants.emplace_back(name,value);
+}
+
+void BinaryFieldsFile::setConstant(const std::string& name,double value) {
+  char buf[64];
+  std::snprintf(buf,sizeof(buf),"%.17g",value);
+  setConstant(name,std::string(buf));
+}
+
+bool BinaryFieldsFile::hasConstant(const std::string& name) const {
+  for(const auto & c : constants) if(c.first==name) return true;
+  return false;
+}
+
+const std::string& BinaryFieldsFile::getConstant(const std::string& name) const {
+  for(const auto & c : constants) if(c.first==name) return c.second;
+  plumed_merror("field " + name + " is not present");
+}
+
+void BinaryFieldsFile::setNumberOfRows(std::size_t n) {
+  plumed_massert(columns.empty(),"the number of rows should be set before adding columns");
+  nrows=n;
+}
+
+double* BinaryFieldsFile::addColumn(const std::string& name) {
+  plumed_massert(!mapping,"columns cannot be added to a file that has been read");
+  plumed_massert(!hasColumn(name),"column " + name + " is already present");
+  columns.push_back(name);
+  data.resize(columns.size()*nrows,0.0);
+  first=data.data();
+  return data.data()+(columns.size()-1)*nrows;
+}
+
+bool BinaryFieldsFile::hasColumn(const std::string& name) const {
+  return std::find(columns.begin(),columns.end(),name)!=columns.end();
+}
+
+const double* BinaryFieldsFile::getColumn(const std::string& name) const {
+  auto it=std::find(columns.begin(),columns.end(),name);
+  plumed_massert(it!=columns.end(),"column " + name + " is not present");
+  return first+(it-columns.begin())*nrows;
+}
+
+void BinaryFieldsFile::write(const std::string& path) const {
+  std::string payload;
+  put(payload,std::uint64_t(constants.size()));
+  for(const auto & c : constants) {
+    putString(payload,c.first);
+    putString(payload,c.second);
+  }
+  put(payload,std::uint64_t(columns.size()));
+  put(payload,std::uint64_t(nrows));
+  for(const auto & c : columns) putString(payload,c);
+// columns are aligned to 8 bytes, the header being 8 bytes aligned as well
+  payload.append((8-payload.length()%8)%8,'\0');
+  payload.append(reinterpret_cast<const char*>(first),columns.size()*nrows*sizeof(double));
+
+  std::string header;
+  header.append(signature,sizeof(signature));
+  put(header,version);
+  put(header,endianness);
+  put(header,std::uint64_t(payload.length()));
+  put(header,checksum(payload.data(),payload.length()));
+  plumed_assert(header.length()==headersize);
+
+// write on a temporary file and rename it, so that readers never see a partial file
+  const std::string tmp=path+".tmp";
+  {
+    std::ofstream ofs(tmp,std::ios::binary);
+    plumed_massert(ofs,"cannot open file "+tmp);
+    ofs.write(header.data(),header.length());
+    ofs.write(payload.data(),payload.length());
+    ofs.close();
+    plumed_massert(ofs,"cannot write file "+tmp);
+  }
+  plumed_massert(std::rename(tmp.c_str(),path.c_str())==0,"cannot rename "+tmp+" to "+path);
+}
+
+void BinaryFieldsFile::read(const std::string& path) {
+  clear();
+  auto m=std::make_unique<Mapping>(path);
+  plumed_massert(m->size>=headersize && std::memcmp(m->data,signature,sizeof(signature))==0,
+                 "file " + path + " is not a binary fields file");
+  Cursor header(m->data+sizeof(signature),headersize-sizeof(signature),path);
+  auto v=header.get<std::uint32_t>();
+  plumed_massert(v==version,"binary file " + path + " was written with an unsupported version of the format");
+  plumed_massert(header.get<std::uint32_t>()==endianness,"binary file " + path + " was written on a machine with a different endianness");
+  auto size=header.get<std::uint64_t>();
+  plumed_massert(size==m->size-headersize,"binary file " + path + " is truncated");
+  auto sum=header.get<std::uint64_t>();
+  const char* payload=m->data+headersize;
+  plumed_massert(sum==checksum(payload,size),"binary file " + path + " is corrupted (wrong checksum)");
+
+  Cursor c(payload,size,path);
+  auto nconstants=c.get<std::uint64_t>();
+  for(std::uint64_t i=0; i<nconstants; i++) {
+    std::string name=c.getString();
+    constants.emplace_back(name,c.getString());
+  }
+  auto ncolumns=c.get<std::uint64_t>();
+  nrows=c.get<std::uint64_t>();
+  for(std::uint64_t i=0; i<ncolumns; i++) columns.push_back(c.getString());
+  c.align();
+  plumed_massert(nrows<=std::numeric_limits<std::size_t>::max()/sizeof(double)/std::max<std::uint64_t>(ncolumns,1)
+                 && c.remaining()==ncolumns*nrows*sizeof(double),"binary file " + path + " is truncated");
+  first=reinterpret_cast<const double*>(c.skip(c.remaining()));
+  mapping=std::move(m);
+}
+
+}
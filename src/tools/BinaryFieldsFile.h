@@ -0,0 +1,145 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_BinaryFieldsFile_h
+#define __PLUMED_tools_BinaryFieldsFile_h
+
+#include "Tools.h"
+#include "Exception.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// Binary version of the files with fields that are written by OFile and read by IFile.
+/// A file contains a set of constant fields, stored as strings, and a set of columns
+/// of numbers with the same number of rows, stored as doubles.
+///
+/// The file starts with a signature, a version number, a marker used to detect
+/// files written on machines with a different endianness and a checksum of the rest of the file.
+/// Columns are stored contiguously and aligned to 8 bytes, so that when a file is read
+/// they are used directly from the memory mapped file, without copies.
+/// Files are written to a temporary file that is then renamed, so that a file is never
+/// left half written.
+///
+/// \verbatim
+/// BinaryFieldsFile w;
+/// w.setConstant("zed",1.5);
+/// w.setNumberOfRows(n);
+/// double* h=w.addColumn("height");
+/// for(unsigned i=0; i<n; i++) h[i]=...;
+/// w.write("STATE");
+///
+/// BinaryFieldsFile r;
+/// r.read("STATE");
+/// double zed; r.getConstant("zed",zed);
+/// const double* height=r.getColumn("height");
+/// \endverbatim
+class BinaryFieldsFile {
+/// A region of memory holding a file that has been read
+  class Mapping;
+  std::unique_ptr<Mapping> mapping;
+  std::vector<std::pair<std::string,std::string> > constants;
+  std::vector<std::string> columns;
+  std::size_t nrows;
+/// Data of the columns, when they are not read from a file
+  std::vector<double> data;
+/// Pointer to the first element of the columns, either in data or in the mapped file
+  const double* first;
+public:
+/// Version of the format written by this class
+  static const std::uint32_t version;
+  BinaryFieldsFile();
+  ~BinaryFieldsFile();
+  BinaryFieldsFile(const BinaryFieldsFile&)=delete;
+  BinaryFieldsFile& operator=(const BinaryFieldsFile&)=delete;
+/// Check if a file starts with the signature of binary files
+  static bool isBinary(const std::string& path);
+/// Remove all the fields
+  void clear();
+/// Set a constant field
+  void setConstant(const std::string& name,const std::string& value);
+/// Set a constant field, printed with all the significant digits
+  void setConstant(const std::string& name,double value);
+/// Set a constant integer field
+  template<typename T,typename=std::enable_if_t<std::is_integral<T>::value> >
+  void setConstant(const std::string& name,T value);
+/// Check if a constant field is present
+  bool hasConstant(const std::string& name) const ;
+/// Get the value of a constant field as a string
+  const std::string& getConstant(const std::string& name) const ;
+/// Get the value of a constant field converted to a number
+  template<typename T>
+  void getConstant(const std::string& name,T& value) const ;
+/// Get all the constant fields, in the order in which they were set
+  const std::vector<std::pair<std::string,std::string> >& getConstants() const ;
+/// Set the number of rows of the columns. This should be done before adding columns
+  void setNumberOfRows(std::size_t n);
+/// Get the number of rows of the columns
+  std::size_t getNumberOfRows() const ;
+/// Add a column and return a pointer to its (zeroed) elements
+  double* addColumn(const std::string& name);
+/// Check if a column is present
+  bool hasColumn(const std::string& name) const ;
+/// Get the names of the columns
+  const std::vector<std::string>& getColumnNames() const ;
+/// Get the elements of a column
+  const double* getColumn(const std::string& name) const ;
+/// Write the fields on a file
+  void write(const std::string& path) const ;
+/// Read the fields from a file. The file is checked for consistency and kept in memory until
+/// the next call to read() or clear()
+  void read(const std::string& path);
+};
+
+template<typename T,typename>
+void BinaryFieldsFile::setConstant(const std::string& name,T value) {
+  setConstant(name,std::to_string(value));
+}
+
+template<typename T>
+void BinaryFieldsFile::getConstant(const std::string& name,T& value) const {
+  plumed_massert(Tools::convertNoexcept(getConstant(name),value),"cannot convert field " + name + "=" + getConstant(name));
+}
+
+inline
+const std::vector<std::pair<std::string,std::string> >& BinaryFieldsFile::getConstants() const {
+  return constants;
+}
+
+inline
+std::size_t BinaryFieldsFile::getNumberOfRows() const {
+  return nrows;
+}
+
+inline
+const std::vector<std::string>& BinaryFieldsFile::getColumnNames() const {
+  return columns;
+}
+
+}
+
+#endif
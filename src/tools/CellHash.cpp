@@ -0,0 +1,138 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CellHash.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PLMD {
+
+std::size_t CellHash::KeyHash::operator()(const std::vector<int>& key) const {
+  std::size_t h=key.size();
+  for(const auto & k : key) h^=std::hash<int>()(k)+0x9e3779b9+(h<<6)+(h>>2);
+  return h;
+}
+
+CellHash::CellHash():
+  nstored(0)
+{
+}
+
+void CellHash::setup(const std::vector<double>& size, const std::vector<double>& per) {
+  plumed_massert(size.size()==per.size(),"number of cell sizes and periods should be the same");
+  cellsize=size;
+  period=per;
+  nperiodic.assign(cellsize.size(),0);
+  for(unsigned i=0; i<cellsize.size(); i++) {
+    plumed_massert(cellsize[i]>0,"cells should have a positive size");
+    if(period[i]>0) {
+      // make sure that an integer number of cells fits in the period
+      nperiodic[i]=std::max(1,static_cast<int>(std::floor(period[i]/cellsize[i])));
+      cellsize[i]=period[i]/nperiodic[i];
+    }
+  }
+  clear();
+}
+
+int CellHash::getCellIndex(unsigned i, double x) const {
+  return static_cast<int>(std::floor(x/cellsize[i]));
+}
+
+void CellHash::getCell(const std::vector<double>& pos, std::vector<int>& key) const {
+  plumed_dbg_assert(pos.size()==cellsize.size());
+  key.resize(cellsize.size());
+  for(unsigned i=0; i<cellsize.size(); i++) {
+    key[i]=getCellIndex(i,pos[i]);
+    if(nperiodic[i]>0) key[i]=((key[i]%nperiodic[i])+nperiodic[i])%nperiodic[i];
+  }
+}
+
+void CellHash::insert(unsigned id, const std::vector<double>& pos) {
+  plumed_dbg_assert(enabled());
+  std::vector<int> key;
+  getCell(pos,key);
+  cells[key].push_back(id);
+  nstored++;
+}
+
+void CellHash::remove(unsigned id, const std::vector<double>& pos) {
+  plumed_dbg_assert(enabled());
+  std::vector<int> key;
+  getCell(pos,key);
+  auto c=cells.find(key);
+  plumed_massert(c!=cells.end(),"cannot remove an object from an empty cell");
+  auto it=std::find(c->second.begin(),c->second.end(),id);
+  plumed_massert(it!=c->second.end(),"cannot find the object to be removed in its cell");
+  c->second.erase(it);
+  if(c->second.empty()) cells.erase(c);
+  nstored--;
+}
+
+void CellHash::clear() {
+  cells.clear();
+  nstored=0;
+}
+
+void CellHash::query(const std::vector<double>& pos, const std::vector<double>& range, std::vector<unsigned>& ids) const {
+  plumed_dbg_assert(enabled());
+  ids.clear();
+  const unsigned ndim=cellsize.size();
+  std::vector<int> lower(ndim), ncells(ndim);
+  double ntot=1.0;
+  for(unsigned i=0; i<ndim; i++) {
+    lower[i]=getCellIndex(i,pos[i]-range[i]);
+    ncells[i]=getCellIndex(i,pos[i]+range[i])-lower[i]+1;
+    if(nperiodic[i]>0 && ncells[i]>=nperiodic[i]) {
+      lower[i]=0;
+      ncells[i]=nperiodic[i];
+    }
+    ntot*=ncells[i];
+  }
+
+  // if the box spans more cells than those occupied it is cheaper to return everything
+  if(ntot>=cells.size()) {
+    ids.reserve(nstored);
+    for(const auto & c : cells) ids.insert(ids.end(),c.second.begin(),c.second.end());
+    return;
+  }
+
+  // loop over all the cells in the box
+  std::vector<int> shift(ndim,0), key(ndim);
+  while(true) {
+    for(unsigned i=0; i<ndim; i++) {
+      key[i]=lower[i]+shift[i];
+      if(nperiodic[i]>0) key[i]=((key[i]%nperiodic[i])+nperiodic[i])%nperiodic[i];
+    }
+    auto c=cells.find(key);
+    if(c!=cells.end()) ids.insert(ids.end(),c->second.begin(),c->second.end());
+    unsigned i=0;
+    for(; i<ndim; i++) {
+      shift[i]++;
+      if(shift[i]<ncells[i]) break;
+      shift[i]=0;
+    }
+    if(i==ndim) break;
+  }
+}
+
+}
@@ -0,0 +1,94 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_CellHash_h
+#define __PLUMED_tools_CellHash_h
+
+#include <vector>
+#include <unordered_map>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// A uniform cell hash in an arbitrary number of dimensions.
+/// It stores integer identifiers (e.g. the indices of kernels) according
+/// to a position, typically in CV space. Only the cells that contain
+/// at least one object are allocated, so the space to be indexed does not
+/// need to be bounded. Dimensions with a positive period are wrapped.
+class CellHash {
+private:
+/// Hash function for the integer coordinates of a cell
+  struct KeyHash {
+    std::size_t operator()(const std::vector<int>& key) const;
+  };
+/// The width of the cells in each direction
+  std::vector<double> cellsize;
+/// The period in each direction (zero if not periodic)
+  std::vector<double> period;
+/// The number of cells along periodic directions
+  std::vector<int> nperiodic;
+/// The identifiers stored in each of the occupied cells
+  std::unordered_map<std::vector<int>,std::vector<unsigned>,KeyHash> cells;
+/// The total number of stored identifiers
+  unsigned nstored;
+/// Get the (unwrapped) cell index along direction i
+  int getCellIndex(unsigned i, double x) const ;
+/// Get the cell that contains a position
+  void getCell(const std::vector<double>& pos, std::vector<int>& key) const ;
+public:
+  CellHash();
+/// Set the size of the cells and the periodicity; this also clears the hash
+  void setup(const std::vector<double>& cellsize, const std::vector<double>& period);
+/// Has the hash been set up
+  bool enabled() const ;
+/// Add an identifier at a given position
+  void insert(unsigned id, const std::vector<double>& pos);
+/// Remove an identifier that was inserted at a given position
+  void remove(unsigned id, const std::vector<double>& pos);
+/// Remove all the identifiers
+  void clear();
+/// Get the number of stored identifiers
+  unsigned size() const ;
+/// Get the number of occupied cells
+  unsigned getNumberOfCells() const ;
+/// Retrieve the identifiers stored in the cells overlapping the box pos-range,pos+range.
+/// The result is a superset of the objects in the box, it should be filtered by the caller
+  void query(const std::vector<double>& pos, const std::vector<double>& range, std::vector<unsigned>& ids) const ;
+};
+
+inline
+bool CellHash::enabled() const {
+  return cellsize.size()>0;
+}
+
+inline
+unsigned CellHash::size() const {
+  return nstored;
+}
+
+inline
+unsigned CellHash::getNumberOfCells() const {
+  return cells.size();
+}
+
+}
+
+#endif
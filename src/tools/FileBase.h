@@ -107,7 +107,7 @@ public:
   virtual FileBase& flush();
 /// Closes the file
 /// Should be used only for explicitely opened files.
-  void        close();
+  virtual void close();
 /// Virtual destructor (allows inheritance)
   virtual ~FileBase();
 /// Check for error/eof.
@@ -28,6 +28,7 @@
 #include "KernelFunctions.h"
 #include "RootFindingBase.h"
 #include "Communicator.h"
+#include "BinaryFieldsFile.h"
 #include "small_vector/small_vector.h"
 
 #include <vector>
@@ -37,6 +38,7 @@
 #include <cstdio>
 #include <cfloat>
 #include <array>
+#include <algorithm>
 
 namespace PLMD {
 
@@ -505,9 +507,56 @@ void GridBase::writeCubeFile(OFile& ofile, const double& lunit) {
 std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile,
     const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
     const std::vector<unsigned> & nbin,bool dosparse, bool dospline, bool doder) {
-  std::unique_ptr<GridBase> grid=GridBase::create(funcl,args,ifile,dosparse,dospline,doder);
-  std::vector<unsigned> cbin( grid->getNbin() );
-  std::vector<std::string> cmin( grid->getMin() ), cmax( grid->getMax() );
+  return create(funcl,args,ifile,gmin,gmax,nbin,(dosparse?Storage::sparse:Storage::dense),dospline,doder);
+}
+
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args,
+    const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
+    const std::vector<unsigned> & nbin, Storage storage, bool dospline, bool doder) {
+  std::unique_ptr<GridBase> grid;
+  if(storage==Storage::dense) grid=Tools::make_unique<Grid>(funcl,args,gmin,gmax,nbin,dospline,doder);
+  else if(storage==Storage::sparse) grid=Tools::make_unique<SparseGrid>(funcl,args,gmin,gmax,nbin,dospline,doder);
+  else grid=Tools::make_unique<TiledSparseGrid>(funcl,args,gmin,gmax,nbin,dospline,doder);
+  return grid;
+}
+
+void GridBase::writeToBinaryFile(BinaryFieldsFile& bfile) const {
+  for(unsigned j=0; j<dimension_; ++j) {
+    bfile.setConstant("min_" + argnames[j], str_min_[j] );
+    bfile.setConstant("max_" + argnames[j], str_max_[j] );
+    bfile.setConstant("nbins_" + argnames[j], static_cast<int>(nbin_[j]) );
+    bfile.setConstant("periodic_" + argnames[j], pbc_[j] ? "true" : "false" );
+  }
+  bfile.setNumberOfRows(maxsize_);
+// columns are filled right after being added, since adding a column can relocate the previous ones
+  std::vector<double> point(dimension_);
+  for(unsigned j=0; j<dimension_; ++j) {
+    double* xx=bfile.addColumn(argnames[j]);
+    for(index_t i=0; i<maxsize_; ++i) {
+      getPoint(i,point);
+      xx[i]=point[j];
+    }
+  }
+  double* f=bfile.addColumn(funcname);
+  std::vector<double> der(usederiv_?maxsize_*dimension_:0), dd(dimension_);
+  for(index_t i=0; i<maxsize_; ++i) {
+    if(usederiv_) {
+      f[i]=getValueAndDerivatives(i,dd.data(),dd.size());
+      for(unsigned j=0; j<dimension_; ++j) der[j*maxsize_+i]=dd[j];
+    } else f[i]=getValue(i);
+  }
+  if(usederiv_) for(unsigned j=0; j<dimension_; ++j) {
+      double* d=bfile.addColumn("der_" + argnames[j]);
+      std::copy(der.begin()+j*maxsize_,der.begin()+(j+1)*maxsize_,d);
+    }
+}
+
+/// Check that a grid that has been read has the boundaries expected from input
+static void checkGridBoundaries(const GridBase& grid, const std::vector<Value*> & args,
+                                const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
+                                const std::vector<unsigned> & nbin) {
+  std::vector<unsigned> cbin( grid.getNbin() );
+  std::vector<std::string> cmin( grid.getMin() ), cmax( grid.getMax() );
   for(unsigned i=0; i<args.size(); ++i) {
     plumed_massert( cmin[i]==gmin[i], "mismatched grid min" );
     plumed_massert( cmax[i]==gmax[i], "mismatched grid max" );
@@ -517,10 +566,80 @@ std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::
       plumed_massert( (cbin[i]-1)==nbin[i], "mismatched grid nbins");
     }
   }
+}
+
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, const BinaryFieldsFile& bfile,
+    const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
+    const std::vector<unsigned> & nbin, Storage storage, bool dospline, bool doder) {
+  unsigned nvar=args.size();
+  std::vector<unsigned> gbin(nvar);
+  std::vector<std::string> labels(nvar),fmin(nvar),fmax(nvar);
+  plumed_massert( bfile.hasColumn( funcl ), "no column labelled " + funcl + " in in grid input");
+  bool hasder=true;
+  for(unsigned i=0; i<nvar; ++i) {
+    labels[i]=args[i]->getName();
+    // This is a change to ensure that we can deal with old style names for multicolvars
+    std::size_t und = labels[i].find_first_of("_");
+    if( !bfile.hasColumn(labels[i]) && und!=std::string::npos ) labels[i] = labels[i].substr(0,und) + "." + labels[i].substr(und+1);
+    plumed_massert( bfile.hasColumn(labels[i]), "no column labelled " + labels[i] + " in grid input");
+    fmin[i]=bfile.getConstant("min_" + labels[i]);
+    fmax[i]=bfile.getConstant("max_" + labels[i]);
+    const std::string & pstring( bfile.getConstant("periodic_" + labels[i]) );
+    int gbin1; bfile.getConstant("nbins_" + labels[i], gbin1);
+    plumed_assert( gbin1>0 );
+    if( args[i]->isPeriodic() ) {
+      plumed_massert( pstring=="true", "input value is periodic but grid is not");
+      std::string pmin, pmax;
+      args[i]->getDomain( pmin, pmax ); gbin[i]=gbin1;
+      if( pmin!=fmin[i] || pmax!=fmax[i] ) plumed_merror("mismatch between grid boundaries and periods of values");
+    } else {
+      gbin[i]=gbin1-1;  // Note header in grid file indicates one more bin that there should be when data is not periodic
+      plumed_massert( pstring=="false", "input value is not periodic but grid is");
+    }
+    if( !bfile.hasColumn( "der_" + labels[i] ) ) hasder=false;
+  }
+  if( doder && !hasder ) plumed_merror("missing derivatives from grid file");
+
+  std::unique_ptr<GridBase> grid=create(funcl,args,fmin,fmax,gbin,storage,dospline,doder);
+  checkGridBoundaries(*grid,args,gmin,gmax,nbin);
+
+  std::vector<const double*> xx(nvar), der(nvar);
+  for(unsigned i=0; i<nvar; ++i) {
+    xx[i]=bfile.getColumn(labels[i]);
+    if(hasder) der[i]=bfile.getColumn("der_" + labels[i]);
+  }
+  const double* f=bfile.getColumn(funcl);
+  std::vector<double> x(nvar),dder(nvar);
+  std::vector<double> dx=grid->getDx();
+  for(std::size_t n=0; n<bfile.getNumberOfRows(); ++n) {
+    bool zero=(f[n]==0.0);
+    for(unsigned i=0; i<nvar; ++i) {
+      x[i]=xx[i][n]+dx[i]/2.0;
+      if(hasder) { dder[i]=der[i][n]; if(dder[i]!=0.0) zero=false; }
+    }
+    // grids start from zero, so that sparse grids do not need to store the empty points
+    if(zero) continue;
+    index_t index=grid->getIndex(x);
+    if(doder) grid->setValueAndDerivatives(index,f[n],dder);
+    else grid->setValue(index,f[n]);
+  }
+  return grid;
+}
+
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile,
+    const std::vector<std::string> & gmin,const std::vector<std::string> & gmax,
+    const std::vector<unsigned> & nbin, Storage storage, bool dospline, bool doder) {
+  std::unique_ptr<GridBase> grid=GridBase::create(funcl,args,ifile,storage,dospline,doder);
+  checkGridBoundaries(*grid,args,gmin,gmax,nbin);
   return grid;
 }
 
 std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, bool dosparse, bool dospline, bool doder)
+{
+  return create(funcl,args,ifile,(dosparse?Storage::sparse:Storage::dense),dospline,doder);
+}
+
+std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::vector<Value*> & args, IFile& ifile, Storage storage, bool dospline, bool doder)
 {
   std::unique_ptr<GridBase> grid;
   unsigned nvar=args.size(); bool hasder=false; std::string pstring;
@@ -570,25 +689,24 @@ std::unique_ptr<GridBase> GridBase::create(const std::string& funcl, const std::
     }
   }
 
-  if(!dosparse) {grid=Tools::make_unique<Grid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
-  else {grid=Tools::make_unique<SparseGrid>(funcl,args,gmin,gmax,gbin,dospline,doder);}
+  grid=create(funcl,args,gmin,gmax,gbin,storage,dospline,doder);
 
   std::vector<double> xx(nvar),dder(nvar);
   std::vector<double> dx=grid->getDx();
-  double f,x;
-  while( ifile.scanField(funcl,f) ) {
-    for(unsigned i=0; i<nvar; ++i) {
-      ifile.scanField(labels[i],x); xx[i]=x+dx[i]/2.0;
-      ifile.scanField( "min_" + labels[i], gmin[i]);
-      ifile.scanField( "max_" + labels[i], gmax[i]);
-      ifile.scanField( "nbins_" + labels[i], gbin1[i]);
-      ifile.scanField( "periodic_" + labels[i], pstring );
+// grid files can be large, so they are read in blocks of lines:
+// column 0 is the function, then the arguments and their derivatives
+  std::vector<std::string> colnames(1,funcl);
+  for(unsigned i=0; i<nvar; ++i) colnames.push_back(labels[i]);
+  if(hasder) { for(unsigned i=0; i<nvar; ++i) colnames.push_back("der_" + labels[i]); }
+  std::vector<std::vector<double>> columns;
+  while( std::size_t nrows=ifile.scanColumns(colnames,columns,4096) ) {
+    for(std::size_t n=0; n<nrows; ++n) {
+      for(unsigned i=0; i<nvar; ++i) xx[i]=columns[1+i][n]+dx[i]/2.0;
+      if(hasder) { for(unsigned i=0; i<nvar; ++i) dder[i]=columns[1+nvar+i][n]; }
+      index_t index=grid->getIndex(xx);
+      if(doder) {grid->setValueAndDerivatives(index,columns[0][n],dder);}
+      else {grid->setValue(index,columns[0][n]);}
     }
-    if(hasder) { for(unsigned i=0; i<nvar; ++i) { ifile.scanField( "der_" + labels[i], dder[i] ); } }
-    index_t index=grid->getIndex(xx);
-    if(doder) {grid->setValueAndDerivatives(index,f,dder);}
-    else {grid->setValue(index,f);}
-    ifile.scanField();
   }
   return grid;
 }
@@ -833,6 +951,194 @@ double SparseGrid::getMaxValue() const {
   return maxval;
 }
 
+void TiledSparseGrid::setupTiles() {
+  // tiles of a few hundreds points, so that values and derivatives fit in the L1/L2 cache
+  constexpr unsigned edge[]= {0,64,16,8,4};
+  const unsigned e=(dimension_<5?edge[dimension_]:2);
+  tile_nbin_.resize(dimension_);
+  ntiles_.resize(dimension_);
+  tile_size_=1;
+  for(unsigned i=0; i<dimension_; i++) {
+    tile_nbin_[i]=std::min(e,nbin_[i]);
+    ntiles_[i]=(nbin_[i]+tile_nbin_[i]-1)/tile_nbin_[i];
+    tile_size_*=tile_nbin_[i];
+  }
+  rehash(16);
+}
+
+void TiledSparseGrid::getTileAndOffset(index_t index, index_t& tile, unsigned& offset) const {
+  std::array<unsigned,maxdim> indices;
+  getIndices(index,indices.data(),dimension_);
+  tile=0;
+  offset=0;
+  for(unsigned i=dimension_; i>0; i--) {
+    tile=tile*ntiles_[i-1]+indices[i-1]/tile_nbin_[i-1];
+    offset=offset*tile_nbin_[i-1]+indices[i-1]%tile_nbin_[i-1];
+  }
+}
+
+bool TiledSparseGrid::getGridIndex(index_t tile, unsigned offset, index_t& index) const {
+  std::array<unsigned,maxdim> indices;
+  for(unsigned i=0; i<dimension_; i++) {
+    indices[i]=(tile%ntiles_[i])*tile_nbin_[i]+offset%tile_nbin_[i];
+    if(indices[i]>=nbin_[i]) return false;
+    tile/=ntiles_[i];
+    offset/=tile_nbin_[i];
+  }
+  index=getIndex(indices.data(),dimension_);
+  return true;
+}
+
+long TiledSparseGrid::findTile(index_t tile) const {
+  // Fibonacci hashing followed by linear probing
+  std::size_t h=hashTile(tile);
+  while(hash_keys_[h]!=empty_key) {
+    if(hash_keys_[h]==tile) return hash_slots_[h];
+    h=(h+1)&hash_mask_;
+  }
+  return -1;
+}
+
+void TiledSparseGrid::rehash(std::size_t size) {
+  plumed_assert(size>1 && (size&(size-1))==0);
+  hash_keys_.assign(size,empty_key);
+  hash_slots_.assign(size,0);
+  hash_mask_=size-1;
+  hash_shift_=64;
+  while(size>1) { size>>=1; hash_shift_--; }
+  for(unsigned k=0; k<tiles_.size(); k++) {
+    std::size_t h=hashTile(tiles_[k]);
+    while(hash_keys_[h]!=empty_key) h=(h+1)&hash_mask_;
+    hash_keys_[h]=tiles_[k];
+    hash_slots_[h]=k;
+  }
+}
+
+unsigned TiledSparseGrid::getTile(index_t tile) {
+  long k=findTile(tile);
+  if(k>=0) return k;
+  // keep the load factor of the hash table below one half
+  if(2*(tiles_.size()+1)>hash_keys_.size()) rehash(2*hash_keys_.size());
+  std::size_t h=hashTile(tile);
+  while(hash_keys_[h]!=empty_key) h=(h+1)&hash_mask_;
+  hash_keys_[h]=tile;
+  hash_slots_[h]=tiles_.size();
+  tiles_.push_back(tile);
+  values_.resize(tiles_.size()*tile_size_,0.0);
+  if(usederiv_) der_.resize(tiles_.size()*tile_size_*dimension_,0.0);
+  return tiles_.size()-1;
+}
+
+Grid::index_t TiledSparseGrid::getSize() const {
+  return values_.size();
+}
+
+Grid::index_t TiledSparseGrid::getMaxSize() const {
+  return maxsize_;
+}
+
+unsigned TiledSparseGrid::getNumberOfTiles() const {
+  return tiles_.size();
+}
+
+double TiledSparseGrid::getValue(index_t index)const {
+  plumed_assert(index<maxsize_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  long k=findTile(tile);
+  if(k<0) return 0.0;
+  return values_[k*tile_size_+offset];
+}
+
+double TiledSparseGrid::getValueAndDerivatives(index_t index, double* der, std::size_t der_size)const {
+  plumed_assert(index<maxsize_ && usederiv_ && der_size==dimension_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  long k=findTile(tile);
+  if(k<0) {
+    for(unsigned i=0; i<dimension_; ++i) der[i]=0.0;
+    return 0.0;
+  }
+  const index_t ipoint=k*tile_size_+offset;
+  for(unsigned i=0; i<dimension_; ++i) der[i]=der_[ipoint*dimension_+i];
+  return values_[ipoint];
+}
+
+void TiledSparseGrid::setValue(index_t index, double value) {
+  plumed_assert(index<maxsize_ && !usederiv_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  values_[getTile(tile)*tile_size_+offset]=value;
+}
+
+void TiledSparseGrid::setValueAndDerivatives(index_t index, double value, std::vector<double>& der) {
+  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  const index_t ipoint=getTile(tile)*tile_size_+offset;
+  values_[ipoint]=value;
+  for(unsigned i=0; i<dimension_; ++i) der_[ipoint*dimension_+i]=der[i];
+}
+
+void TiledSparseGrid::addValue(index_t index, double value) {
+  plumed_assert(index<maxsize_ && !usederiv_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  values_[getTile(tile)*tile_size_+offset]+=value;
+}
+
+void TiledSparseGrid::addValueAndDerivatives(index_t index, double value, std::vector<double>& der) {
+  plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
+  index_t tile; unsigned offset;
+  getTileAndOffset(index,tile,offset);
+  const index_t ipoint=getTile(tile)*tile_size_+offset;
+  values_[ipoint]+=value;
+  for(unsigned i=0; i<dimension_; ++i) der_[ipoint*dimension_+i]+=der[i];
+}
+
+void TiledSparseGrid::writeToFile(OFile& ofile) {
+  std::vector<double> xx(dimension_);
+  std::vector<double> der(dimension_);
+  writeHeader(ofile);
+  // tiles are written in order of position in the grid
+  std::vector<std::pair<index_t,unsigned> > sorted(tiles_.size());
+  for(unsigned k=0; k<tiles_.size(); k++) sorted[k]=std::make_pair(tiles_[k],k);
+  std::sort(sorted.begin(),sorted.end());
+  for(const auto & t : sorted) {
+    for(unsigned offset=0; offset<tile_size_; offset++) {
+      index_t i;
+      // skip the points of the tiles at the border that are outside of the grid
+      if(!getGridIndex(t.first,offset,i)) continue;
+      const index_t ipoint=t.second*tile_size_+offset;
+      getPoint(i,xx);
+      if(usederiv_) for(unsigned j=0; j<dimension_; ++j) der[j]=der_[ipoint*dimension_+j];
+      for(unsigned j=0; j<dimension_; ++j) {
+        ofile.printField("min_" + argnames[j], str_min_[j] );
+        ofile.printField("max_" + argnames[j], str_max_[j] );
+        ofile.printField("nbins_" + argnames[j], static_cast<int>(nbin_[j]) );
+        if( pbc_[j] ) ofile.printField("periodic_" + argnames[j], "true" );
+        else          ofile.printField("periodic_" + argnames[j], "false" );
+      }
+      for(unsigned j=0; j<dimension_; ++j) { ofile.fmtField(" "+fmt_); ofile.printField(argnames[j],xx[j]); }
+      ofile.fmtField(" "+fmt_); ofile.printField(funcname,values_[ipoint]);
+      if(usederiv_) for(unsigned j=0; j<dimension_; ++j) { ofile.fmtField(" "+fmt_); ofile.printField("der_" + argnames[j],der[j]); }
+      ofile.printField();
+    }
+  }
+}
+
+double TiledSparseGrid::getMinValue() const {
+  double minval=0.0;
+  for(const auto & v : values_) if(v<minval) minval=v;
+  return minval;
+}
+
+double TiledSparseGrid::getMaxValue() const {
+  double maxval=0.0;
+  for(const auto & v : values_) if(v>maxval) maxval=v;
+  return maxval;
+}
+
 void Grid::projectOnLowDimension(double &val, std::vector<int> &vHigh, WeightBase * ptr2obj ) {
   unsigned i=0;
   for(i=0; i<vHigh.size(); i++) {
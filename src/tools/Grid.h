@@ -29,6 +29,7 @@
 #include <cmath>
 #include <memory>
 #include <cstddef>
+#include <limits>
 
 #include "Exception.h"
 
@@ -84,6 +85,7 @@ public:
 class Value;
 class IFile;
 class OFile;
+class BinaryFieldsFile;
 class KernelFunctions;
 class Communicator;
 
@@ -100,6 +102,8 @@ public:
 /// Maximum dimension (exaggerated value).
 /// Can be used to replace local std::vectors with std::arrays (allocated on stack).
   static constexpr std::size_t maxdim=16;
+/// The different ways in which the values on the grid can be stored
+  enum class Storage {dense, sparse, tiled};
 
 
   /**
@@ -286,10 +290,22 @@ public:
 
 /// read grid from file
   static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,bool,bool,bool);
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,IFile&,Storage,bool,bool);
 /// read grid from file and check boundaries are what is expected from input
   static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&, IFile&,
                                           const std::vector<std::string>&,const std::vector<std::string>&,
                                           const std::vector<unsigned>&,bool,bool,bool);
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&, IFile&,
+                                          const std::vector<std::string>&,const std::vector<std::string>&,
+                                          const std::vector<unsigned>&,Storage,bool,bool);
+/// read grid from a binary file (see writeToBinaryFile()) and check boundaries are what is expected from input
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&, const BinaryFieldsFile&,
+                                          const std::vector<std::string>&,const std::vector<std::string>&,
+                                          const std::vector<unsigned>&,Storage,bool,bool);
+/// create an empty grid with a given storage
+  static std::unique_ptr<GridBase> create(const std::string&,const std::vector<Value*>&,
+                                          const std::vector<std::string>&,const std::vector<std::string>&,
+                                          const std::vector<unsigned>&,Storage,bool,bool);
 /// get grid size
   virtual index_t getSize() const=0;
 /// get grid value
@@ -324,6 +340,9 @@ public:
 
 /// dump grid on file
   virtual void writeToFile(OFile&)=0;
+/// store the grid in a binary file, with the same fields used by writeToFile().
+/// All the points of the grid are stored, also for sparse grids
+  void writeToBinaryFile(BinaryFieldsFile&) const;
 /// dump grid to gaussian cube file
   void writeCubeFile(OFile&, const double& lunit);
 
@@ -462,6 +481,94 @@ public:
   virtual ~SparseGrid() = default;
 };
 
+/// A sparse grid where neighboring points are grouped in tiles.
+/// A tile is allocated the first time one of its points is written,
+/// and the values and derivatives of its points are stored contiguously.
+/// Tiles are found through an open addressing hash table, so that reading
+/// a point does not require to walk a tree as in SparseGrid.
+class TiledSparseGrid : public GridBase
+{
+/// number of points along each direction of a tile
+  std::vector<unsigned> tile_nbin_;
+/// number of tiles along each direction of the grid
+  std::vector<unsigned> ntiles_;
+/// number of points in a tile
+  unsigned tile_size_;
+/// index of each allocated tile, in the order of allocation
+  std::vector<index_t> tiles_;
+/// values of the allocated tiles, one tile after the other
+  std::vector<double> values_;
+/// derivatives of the allocated tiles, one tile after the other
+  std::vector<double> der_;
+/// hash table: tile indices (or empty_key) and positions in tiles_
+  std::vector<index_t> hash_keys_;
+  std::vector<unsigned> hash_slots_;
+/// size of the hash table minus one, and 64 minus its base 2 logarithm
+  std::size_t hash_mask_;
+  unsigned hash_shift_;
+  static constexpr index_t empty_key=std::numeric_limits<index_t>::max();
+/// set the shape of the tiles
+  void setupTiles();
+/// get the tile containing a grid point and the position of the point in the tile
+  void getTileAndOffset(index_t index, index_t& tile, unsigned& offset) const;
+/// get the grid point corresponding to a position in a tile, false if it is outside the grid
+  bool getGridIndex(index_t tile, unsigned offset, index_t& index) const;
+/// get the position in tiles_ of a tile (-1 if it was not allocated)
+  long findTile(index_t tile) const;
+/// get the position in tiles_ of a tile, allocating it if needed
+  unsigned getTile(index_t tile);
+/// resize the hash table
+  void rehash(std::size_t);
+/// home position of a tile in the hash table (Fibonacci hashing, keeping the high bits of the product)
+  std::size_t hashTile(index_t tile) const {
+    return static_cast<std::size_t>((static_cast<unsigned long long>(tile)*11400714819323198485ull)>>hash_shift_);
+  }
+
+public:
+  TiledSparseGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
+                  const std::vector<std::string> & gmax,
+                  const std::vector<unsigned> & nbin, bool dospline, bool usederiv):
+    GridBase(funcl,args,gmin,gmax,nbin,dospline,usederiv)
+  {
+    setupTiles();
+  }
+
+/// number of points in the allocated tiles
+  index_t getSize() const override;
+  index_t getMaxSize() const;
+/// number of allocated tiles
+  unsigned getNumberOfTiles() const;
+
+/// this is to access to Grid:: version of these methods (allowing overloading of virtual methods)
+  using GridBase::getValue;
+  using GridBase::getValueAndDerivatives;
+  using GridBase::setValue;
+  using GridBase::setValueAndDerivatives;
+  using GridBase::addValue;
+  using GridBase::addValueAndDerivatives;
+
+/// get grid value
+  double getValue(index_t index) const override;
+/// get grid value and derivatives
+  double getValueAndDerivatives(index_t index, double* der, std::size_t der_size) const override;
+
+/// set grid value
+  void setValue(index_t index, double value) override;
+/// set grid value and derivatives
+  void setValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+/// add to grid value
+  void addValue(index_t index, double value) override;
+/// add to grid value and derivatives
+  void addValueAndDerivatives(index_t index, double value, std::vector<double>& der) override;
+
+/// get minimum value
+  double getMinValue() const override;
+/// get maximum value
+  double getMaxValue() const override;
+/// dump the points of the allocated tiles on file
+  void writeToFile(OFile&) override;
+};
+
 
 inline
 GridBase::index_t GridBase::getIndex(const unsigned* indices,std::size_t indices_size) const {
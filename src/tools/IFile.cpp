@@ -29,6 +29,8 @@
 #include <cstdarg>
 #include <cstring>
 #include <cmath>
+#include <charconv>
+#include <algorithm>
 
 #include <iostream>
 #include <string>
@@ -38,6 +40,26 @@
 
 namespace PLMD {
 
+namespace {
+
+/// Size of the blocks that are read from the file at once
+constexpr std::size_t blockSize=1<<16;
+
+/// Convert the word in [b,e) to a real number.
+/// Plain numbers are parsed directly, anything else (e.g. pi or an expression) goes through Tools::convert.
+/// Floating point std::from_chars is missing in some standard libraries, which then always use Tools::convert
+void parseReal(const char*b,const char*e,double&x) {
+#if __cpp_lib_to_chars >= 201611L
+  if(b<e && ((*b>='0' && *b<='9') || *b=='-' || *b=='.')) {
+    auto res=std::from_chars(b,e,x);
+    if(res.ec==std::errc() && res.ptr==e) return;
+  }
+#endif
+  Tools::convert(std::string(b,e),x);
+}
+
+}
+
 size_t IFile::llread(char*ptr,size_t s) {
   plumed_assert(fp);
   size_t r;
@@ -58,14 +80,90 @@ size_t IFile::llread(char*ptr,size_t s) {
   return r;
 }
 
+bool IFile::nextLine(std::size_t&begin,std::size_t&end) {
+  if(eof || err) return false;
+  std::size_t scan=bufferBegin;
+  bool exhausted=false;
+  while(true) {
+    const char* nl=nullptr;
+    if(scan<bufferEnd) nl=static_cast<const char*>(std::memchr(buffer.data()+scan,'\n',bufferEnd-scan));
+    if(nl) {
+      begin=bufferBegin;
+      end=nl-buffer.data();
+      bufferBegin=end+1;
+      if(end>begin && buffer[end-1]=='\r') end--;
+      plumed_massert(!std::memchr(buffer.data()+begin,'\r',end-begin),"plumed only accepts \\n (unix) or \\r\\n (dos) new lines");
+      return true;
+    }
+    scan=bufferEnd;
+    if(exhausted) break;
+// keep the incomplete line at the beginning of the buffer and append a new block
+    if(bufferBegin>0) {
+      std::memmove(buffer.data(),buffer.data()+bufferBegin,bufferEnd-bufferBegin);
+      scan-=bufferBegin;
+      bufferEnd-=bufferBegin;
+      bufferBegin=0;
+    }
+    if(buffer.size()<bufferEnd+blockSize) buffer.resize(bufferEnd+blockSize);
+    std::size_t n=llread(buffer.data()+bufferEnd,blockSize);
+    if(err) break;
+    bufferEnd+=n;
+// eof is only reported when there are no more lines in the buffer
+    if(eof || n==0) exhausted=true;
+    eof=false;
+  }
+  if(noEOL && !err && bufferEnd>bufferBegin) {
+    begin=bufferBegin;
+    end=bufferEnd;
+    bufferBegin=bufferEnd;
+    return true;
+  }
+  eof=true;
+  return false;
+}
+
+bool IFile::splitLine(std::size_t begin,std::size_t end) {
+  lineWords.clear();
+  const char* p=buffer.data();
+  std::size_t i=begin;
+  while(i<end) {
+    while(i<end && (p[i]==' ' || p[i]=='\t')) i++;
+    if(i==end) break;
+    if(p[i]=='#') {
+// "#!" lines are left to the full parser, other comments are skipped
+      if(lineWords.empty() && i+1<end && p[i+1]=='!') return false;
+      break;
+    }
+    std::size_t start=i;
+    for(; i<end && p[i]!=' ' && p[i]!='\t' && p[i]!='#'; i++) if(p[i]=='{' || p[i]=='}') return false;
+    lineWords.emplace_back(start,i);
+  }
+  return true;
+}
+
 IFile& IFile::advanceField() {
   plumed_assert(!inMiddleOfField);
-  std::string line;
   bool done=false;
   while(!done) {
-    getline(line);
-// using explicit conversion not to confuse cppcheck 1.86
-    if(!bool(*this)) {return *this;}
+    std::size_t begin,end;
+    if(!nextLine(begin,end)) {return *this;}
+    unsigned nf=0;
+    for(unsigned i=0; i<fields.size(); i++) if(!fields[i].constant) nf++;
+    if(splitLine(begin,end)) {
+// plain data line, the values are copied directly from the buffer
+      if(lineWords.empty()) continue;
+      if(lineWords.size()!=nf) plumed_merror("file " + getPath() + ": mismatch between number of fields in file and expected number\n this is the faulty line:\n"+std::string(buffer.data()+begin,end-begin));
+      unsigned j=0;
+      for(unsigned i=0; i<fields.size(); i++) {
+        if(fields[i].constant) continue;
+        fields[i].value.assign(buffer.data()+lineWords[j].first,lineWords[j].second-lineWords[j].first);
+        fields[i].read=false;
+        j++;
+      }
+      done=true;
+      continue;
+    }
+    std::string line(buffer.data()+begin,end-begin);
     std::vector<std::string> words=Tools::getWords(line);
     if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS") {
       fields.clear();
@@ -81,8 +179,6 @@ IFile& IFile::advanceField() {
       field.constant=true;
       fields.push_back(field);
     } else {
-      unsigned nf=0;
-      for(unsigned i=0; i<fields.size(); i++) if(!fields[i].constant) nf++;
       Tools::trimComments(line);
       words=Tools::getWords(line);
       if( words.size()==nf ) {
@@ -109,6 +205,8 @@ IFile& IFile::open(const std::string&path) {
   err=false;
   fp=NULL;
   gzfp=NULL;
+  bufferBegin=0;
+  bufferEnd=0;
   bool do_exist=FileExist(path);
   plumed_massert(do_exist,"file " + path + " cannot be found");
   fp=std::fopen(const_cast<char*>(this->path.c_str()),"r");
@@ -134,11 +232,18 @@ IFile& IFile::scanFieldList(std::vector<std::string>&s) {
 }
 
 bool IFile::FieldExist(const std::string& s) {
-  std::vector<std::string> slist;
-  scanFieldList(slist);
-  int mycount = (int) std::count(slist.begin(), slist.end(), s);
-  if(mycount>0) return true;
-  else return false;
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return false;
+  for(const auto & f : fields) if(f.name==s) return true;
+  return false;
+}
+
+bool IFile::FieldIsConstant(const std::string& s) {
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return false;
+  return fields[findField(s)].constant;
 }
 
 IFile& IFile::scanField(const std::string&name,std::string&str) {
@@ -152,12 +257,76 @@ IFile& IFile::scanField(const std::string&name,std::string&str) {
 }
 
 IFile& IFile::scanField(const std::string&name,double &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return *this;
+  unsigned i=findField(name);
+  const std::string & str(fields[i].value);
+  parseReal(str.data(),str.data()+str.length(),x);
+  fields[i].read=true;
   return *this;
 }
 
+std::size_t IFile::scanColumns(const std::vector<std::string>&names,std::vector<std::vector<double>>&columns,std::size_t maxRows) {
+  columns.resize(names.size());
+  for(auto & c : columns) c.clear();
+  if(maxRows==0) return 0;
+  if(!inMiddleOfField) advanceField();
+// using explicit conversion not to confuse cppcheck 1.86
+  if(!bool(*this)) return 0;
+// position of each requested field among the words of a data line,
+// constant fields are converted only once
+  std::vector<int> position(names.size(),-1);
+  std::vector<double> constants(names.size(),0.0);
+  std::vector<unsigned> nonConstant;
+  for(unsigned i=0; i<fields.size(); i++) if(!fields[i].constant) nonConstant.push_back(i);
+  for(unsigned i=0; i<names.size(); i++) {
+    unsigned f=findField(names[i]);
+    fields[f].read=true;
+    if(fields[f].constant) {
+      const std::string & str(fields[f].value);
+      parseReal(str.data(),str.data()+str.length(),constants[i]);
+    } else {
+      position[i]=std::find(nonConstant.begin(),nonConstant.end(),f)-nonConstant.begin();
+    }
+  }
+  if(!ignoreFields) {
+    for(unsigned f : nonConstant) plumed_massert(fields[f].read,"field "+fields[f].name+" was not read: all the fields need to be read otherwise you could miss important infos" );
+  }
+// the first line was already split by advanceField
+  for(unsigned i=0; i<names.size(); i++) {
+    if(position[i]<0) columns[i].push_back(constants[i]);
+    else {
+      const std::string & str(fields[nonConstant[position[i]]].value);
+      columns[i].emplace_back();
+      parseReal(str.data(),str.data()+str.length(),columns[i].back());
+    }
+  }
+  inMiddleOfField=false;
+  std::size_t nrows=1;
+  while(nrows<maxRows) {
+    std::size_t begin,end;
+    if(!nextLine(begin,end)) break;
+    if(!splitLine(begin,end)) {
+// "#!" lines and lines with braces are handled by advanceField in the next call
+      bufferBegin=begin;
+      break;
+    }
+    if(lineWords.empty()) continue;
+    if(lineWords.size()!=nonConstant.size()) plumed_merror("file " + getPath() + ": mismatch between number of fields in file and expected number\n this is the faulty line:\n"+std::string(buffer.data()+begin,end-begin));
+    for(unsigned i=0; i<names.size(); i++) {
+      if(position[i]<0) columns[i].push_back(constants[i]);
+      else {
+        const auto & w(lineWords[position[i]]);
+        columns[i].emplace_back();
+        parseReal(buffer.data()+w.first,buffer.data()+w.second,columns[i].back());
+      }
+    }
+    nrows++;
+  }
+  return nrows;
+}
+
 IFile& IFile::scanField(const std::string&name,int &x) {
   std::string str;
   scanField(name,str);
@@ -228,7 +397,9 @@ IFile& IFile::scanField() {
 IFile::IFile():
   inMiddleOfField(false),
   ignoreFields(false),
-  noEOL(false)
+  noEOL(false),
+  bufferBegin(0),
+  bufferEnd(0)
 {
 }
 
@@ -237,31 +408,11 @@ IFile::~IFile() {
 }
 
 IFile& IFile::getline(std::string &str) {
-  char tmp=0;
-  str="";
-  fpos_t pos;
-  fgetpos(fp,&pos);
-  while(llread(&tmp,1)==1 && tmp && tmp!='\n' && tmp!='\r' && !eof && !err) {
-    str+=tmp;
-  }
-  if(tmp=='\r') {
-    llread(&tmp,1);
-    plumed_massert(tmp=='\n',"plumed only accepts \\n (unix) or \\r\\n (dos) new lines");
-  }
-  if(eof && noEOL) {
-    if(str.length()>0) eof=false;
-  } else if(eof || err || tmp!='\n') {
-    eof = true;
-    str="";
-    if(!err) fsetpos(fp,&pos);
-// there was a fsetpos here that apparently is not necessary
-//  fsetpos(fp,&pos);
-// I think it was necessary to have rewind working correctly
-// after end of file. Since rewind is not used now anywhere,
-// it should be ok not to reset position.
-// This is necessary so that eof works properly for emacs files
-// with no endline at end of file.
-  }
+  str.clear();
+  std::size_t begin,end;
+// an incomplete last line is kept in the buffer, so that reading can continue
+// after reset(false) if the file is being written by someone else
+  if(nextLine(begin,end)) str.assign(buffer.data()+begin,end-begin);
   return *this;
 }
 
@@ -25,6 +25,7 @@
 #include "FileBase.h"
 #include <vector>
 #include <cstddef>
+#include <utility>
 
 namespace PLMD {
 
@@ -58,6 +59,22 @@ class IFile:
   bool ignoreFields;
 /// Set to true to allow files without end-of-line at the end
   bool noEOL;
+/// Buffer where the file is read in large blocks
+  std::vector<char> buffer;
+/// Position of the first character of buffer that was not consumed yet
+  std::size_t bufferBegin;
+/// Number of valid characters in buffer
+  std::size_t bufferEnd;
+/// Words of the last data line, stored as offsets in buffer
+  std::vector<std::pair<std::size_t,std::size_t>> lineWords;
+/// Find the next complete line in buffer, reading more data if needed.
+/// On success the line spans [begin,end) in buffer (without the end-of-line characters)
+/// and it is consumed. Otherwise the incomplete line is left in the buffer, so
+/// that it can be completed if the file grows.
+  bool nextLine(std::size_t&begin,std::size_t&end);
+/// Split the data line in [begin,end) into words, stopping at comments.
+/// Returns false if the line requires the full parser (e.g. it has braces)
+  bool splitLine(std::size_t begin,std::size_t end);
 /// Advance to next field (= read one line)
   IFile& advanceField();
 /// Find field index by name
@@ -87,6 +104,13 @@ public:
   IFile& scanField(const std::string&,long long unsigned&);
 /// Read a string field
   IFile& scanField(const std::string&,std::string&);
+/// Read the following data lines in one go, storing the requested fields column by column.
+/// columns[i] receives the values of field names[i]. At most maxRows lines are read.
+/// Reading stops early at the end of file and before a "#!" line,
+/// so that changes in the list of fields are seen by the next call.
+/// All the fields that are not constant should be requested, unless allowIgnoredFields() was called.
+/// Returns the number of lines that were read, zero at end of file.
+  std::size_t scanColumns(const std::vector<std::string>&names,std::vector<std::vector<double>>&columns,std::size_t maxRows);
   /**
    Ends a field-formatted line.
 
@@ -102,6 +126,8 @@ public:
   void reset(bool);
 /// Check if a field exist
   bool FieldExist(const std::string& s);
+/// Check if a field is constant, i.e. if it was set with a "#! SET" line
+  bool FieldIsConstant(const std::string& s);
 /// Read in a value
   IFile& scanField(Value* val);
 /// Allow some of the fields in the input to be ignored
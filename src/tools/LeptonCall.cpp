@@ -68,6 +68,8 @@ void LeptonCall::set(const std::string & func, const std::vector<std::string>& v
       nt++;
     }
   }
+  for(auto & e : expression) e.setBatchVariables(var);
+  for(auto & ed : expression_deriv) for(auto & e : ed) e.setBatchVariables(var);
 }
 
 double LeptonCall::evaluate( const std::vector<double>& args ) const {
@@ -88,4 +90,13 @@ double LeptonCall::evaluateDeriv( const unsigned& ider, const std::vector<double
   return expression_deriv[ider][t].evaluate();
 }
 
+void LeptonCall::evaluateBatch( const unsigned& n, const std::vector<const double*>& args, double* vals, const std::vector<double*>& derivs ) const {
+  plumed_dbg_assert( allow_extra_args || args.size()==nargs );
+  const unsigned t=OpenMP::getThreadNum();
+  expression[t].evaluateBatch( n, args.data(), vals );
+  if( derivs.empty() ) return;
+  plumed_dbg_assert( derivs.size()==nargs );
+  for(unsigned i=0; i<nargs; ++i) expression_deriv[i][t].evaluateBatch( n, args.data(), derivs[i] );
+}
+
 }
@@ -45,6 +45,10 @@ public:
   unsigned getNumberOfArguments() const ;
   double evaluate( const std::vector<double>& args ) const ;
   double evaluateDeriv( const unsigned& ider, const std::vector<double>& args ) const ;
+/// Evaluate the function at n points, args[j] points to the n values of the j-th argument.
+/// The values of the function are stored in vals and, if derivs is not empty,
+/// the derivatives with respect to the j-th argument are stored in derivs[j]
+  void evaluateBatch( const unsigned& n, const std::vector<const double*>& args, double* vals, const std::vector<double*>& derivs ) const ;
 };
 
 inline
@@ -20,4 +20,31 @@
    along with plumed.  If not, see <http://www.gnu.org/licenses/>.
 +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
 #include "Log.h"
+#include "Exception.h"
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+namespace PLMD {
+
+int Log::printf(const char*fmt,...) {
+  std::vector<char> buf(1024);
+  va_list arg;
+  va_start(arg, fmt);
+  va_list arg2;
+  va_copy(arg2, arg);
+  int r=std::vsnprintf(buf.data(),buf.size(),fmt,arg);
+  va_end(arg);
+  if(r>=static_cast<int>(buf.size())) {
+    buf.resize(r+1);
+    r=std::vsnprintf(buf.data(),buf.size(),fmt,arg2);
+  }
+  va_end(arg2);
+  plumed_massert(r>-1,"error using fmt string " + std::string(fmt));
+  std::lock_guard<std::mutex> lock(mtx);
+  OFile::printf("%s",buf.data());
+  return r;
+}
+
+}
 
@@ -23,6 +23,7 @@
 #define __PLUMED_tools_Log_h
 
 #include "OFile.h"
+#include <mutex>
 
 namespace PLMD {
 
@@ -31,12 +32,32 @@ namespace PLMD {
 /// It is similar to a FILE stream. It allows a printf() function, and
 /// also to write with a << operator. Moreover, it can prefix
 /// lines with the "PLUMED:" prefix, useful to grep out plumed
-/// log from output
+/// log from output.
+///
+/// Since actions can be calculated concurrently (see PlumedMain::forwardLoopConcurrent()),
+/// printf() and << are serialized, so that the text passed in a single call is not
+/// mixed with the one written by other threads.
 class Log :
   public OFile
 {
+/// Serializes the writes from different threads
+  std::mutex mtx;
+public:
+/// Formatted output with explicit format - a la printf
+  int printf(const char*fmt,...);
+/// Formatted output with << operator
+  template <class T>
+  friend Log& operator<<(Log&,const T &);
 };
 
+/// Write using << syntax
+template <class T>
+Log& operator<<(Log&log,const T &t) {
+  std::lock_guard<std::mutex> lock(log.mtx);
+  static_cast<OFile&>(log)<<t;
+  return log;
+}
+
 }
 
 #endif
@@ -30,7 +30,9 @@ MultiValue::MultiValue( const size_t& nvals, const size_t& nder, const size_t& n
   values(nvals),
   nderivatives(nder),
   derivatives(nvals*nder),
-  hasderiv(nvals*nder,false),
+  nset(nvals,0),
+  set_list(nvals*nder),
+  set_position(nvals*nder,0),
   tmpval(0),
   nactive(nvals),
   active_list(nvals*nder),
@@ -42,25 +44,28 @@ MultiValue::MultiValue( const size_t& nvals, const size_t& nder, const size_t& n
   nmatrix_cols(maxcol),
   matrix_row_stash(nmat*maxcol,0),
   matrix_force_stash(nder*nmat),
+  matrix_force_nset(nmat,0),
+  matrix_force_list(nder*nmat),
+  matrix_force_position(nder*nmat,0),
   matrix_bookeeping(nbook,0),
   matrix_row_nderivatives(nmat,0),
   matrix_row_derivative_indices(nmat)
 {
   for(unsigned i=0; i<nmat; ++i) matrix_row_derivative_indices[i].resize( nder );
-  // This is crap that will be deleted in future
-  std::vector<unsigned> myind( nder );
-  for(unsigned i=0; i<nder; ++i) myind[i]=i;
 }
 
 void MultiValue::resize( const size_t& nvals, const size_t& nder, const size_t& nmat, const size_t& maxcol, const size_t& nbook ) {
+  // Derivatives that are still set would end up in the wrong place if the number of derivatives changes
+  if( atLeastOneSet ) for(unsigned i=0; i<values.size(); ++i) clearDerivatives(i);
+  clearMatrixForces();
+  // The vectors only grow, so resizing a MultiValue that is reused for the same action does not allocate memory
   values.resize(nvals); nderivatives=nder; derivatives.resize( nvals*nder );
-  hasderiv.resize(nvals*nder,false); nactive.resize(nvals); active_list.resize(nvals*nder);
-  nmatrix_cols=maxcol; matrix_row_stash.resize(nmat*maxcol,0); matrix_force_stash.resize(nmat*nder,0); matrix_bookeeping.resize(nbook, 0);
+  nset.assign(nvals,0); set_list.resize(nvals*nder); set_position.resize(nvals*nder,0); nactive.resize(nvals); active_list.resize(nvals*nder);
+  nmatrix_cols=maxcol; matrix_row_stash.resize(nmat*maxcol,0); matrix_force_stash.resize(nmat*nder,0); matrix_bookeeping.assign(nbook, 0);
+  matrix_force_nset.assign(nmat,0); matrix_force_list.resize(nmat*nder); matrix_force_position.resize(nmat*nder,0);
   matrix_row_nderivatives.resize(nmat,0); matrix_row_derivative_indices.resize(nmat); atLeastOneSet=false;
   for(unsigned i=0; i<nmat; ++i) matrix_row_derivative_indices[i].resize( nder );
-  // All crap from here onwards
-  tmpder.resize( nder ); std::vector<unsigned> myind( nder );
-  for(unsigned i=0; i<nder; ++i) myind[i]=i;
+  tmpder.resize( nder );
 }
 
 void MultiValue::clearAll() {
@@ -70,31 +75,34 @@ void MultiValue::clearAll() {
   // Clear matrix derivative indices
   std::fill( matrix_row_nderivatives.begin(), matrix_row_nderivatives.end(), 0 );
   // Clear matrix forces
-  std::fill(matrix_force_stash.begin(),matrix_force_stash.end(),0);
+  clearMatrixForces();
   if( !atLeastOneSet ) return;
   for(unsigned i=0; i<values.size(); ++i) clearDerivatives(i);
   atLeastOneSet=false;
 }
 
+void MultiValue::clearMatrixForces() {
+  for(unsigned i=0; i<matrix_force_nset.size(); ++i) {
+    unsigned base=i*nderivatives;
+    for(unsigned k=0; k<matrix_force_nset[i]; ++k) matrix_force_stash[base+matrix_force_list[base+k]]=0;
+    matrix_force_nset[i]=0;
+  }
+}
+
 void MultiValue::clearDerivatives( const unsigned& ival ) {
   values[ival]=0;
   if( !atLeastOneSet ) return;
+  // All the derivatives that were set are cleared, including those that were not put in the active list
   unsigned base=ival*nderivatives;
-  for(unsigned i=0; i<nactive[ival]; ++i) {
-    unsigned k = base+active_list[base+i]; derivatives[k]=0.; hasderiv[k]=false;
-  }
-  nactive[ival]=0;
-#ifndef NDEBUG
-  for(unsigned i=0; i<nderivatives; ++i) {
-    if( hasderiv[base+i] ) {
-      std::string num1, num2;
-      Tools::convert(ival,num1); Tools::convert(i,num2);
-      plumed_merror("FAILING TO CLEAR VALUE " + num1 + " DERIVATIVE " + num2 + " IS PROBLEMATIC");
-    }
-    // As this is debugging code we hard code an escape here otherwise this check is really expensive
-    if( i>1000 ) return;
-  }
-#endif
+  for(unsigned i=0; i<nset[ival]; ++i) derivatives[base+set_list[base+i]]=0.;
+  nset[ival]=0; nactive[ival]=0;
+}
+
+MultiValue& MultiValue::getTemporyMultiValue( const std::size_t& nvals, const std::size_t& nder ) {
+  if( !tmp_multivalue ) tmp_multivalue=Tools::make_unique<MultiValue>( nvals, nder );
+  else tmp_multivalue->resize( nvals, nder );
+  tmp_multivalue->clearAll();
+  return *tmp_multivalue;
 }
 
 }
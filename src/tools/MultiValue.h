@@ -27,6 +27,7 @@
 #include "Tensor.h"
 #include <vector>
 #include <cstddef>
+#include <memory>
 
 namespace PLMD {
 
@@ -41,8 +42,12 @@ private:
   unsigned nderivatives;
 /// Derivatives
   std::vector<double> derivatives;
-/// Matrix asserting which values have derivatives
-  std::vector<bool> hasderiv;
+/// Compact set of the derivatives of each value that have been set. The indices of the
+/// derivatives of value ival that were set are in the first nset[ival] elements of the
+/// row ival of set_list, and set_position[nderivatives*ival+jder] gives the position of
+/// jder in this row. Checking, adding and clearing indices does not require any search and
+/// clearing a value only touches the derivatives that were set.
+  std::vector<unsigned> nset, set_list, set_position;
 /// Tempory value
   double tmpval;
 /// Lists of active variables
@@ -58,6 +63,9 @@ private:
   unsigned nmatrix_cols;
   std::vector<double> matrix_row_stash;
   std::vector<double> matrix_force_stash;
+/// The indices of the forces in row imat of matrix_force_stash that have been set are stored in the
+/// same way as the indices of the derivatives that have been set so only these forces need to be cleared
+  std::vector<unsigned> matrix_force_nset, matrix_force_list, matrix_force_position;
   std::vector<unsigned> matrix_bookeeping;
 /// These are used to store the indices that have derivatives wrt to at least one
 /// of the elements in a matrix
@@ -69,6 +77,14 @@ private:
   std::vector<std::vector<Vector> > tmp_atom_der;
   std::vector<Tensor> tmp_atom_virial;
   std::vector<std::vector<double> > tmp_vectors;
+/// This is used in tasks that need a second set of values
+  std::unique_ptr<MultiValue> tmp_multivalue;
+/// Check if derivative jder of value ival has been set
+  bool hasDerivative( const std::size_t& ival, const std::size_t& jder ) const ;
+/// Mark derivative jder of value ival as set
+  void setHasDerivative( const std::size_t& ival, const std::size_t& jder );
+/// Clear the forces that have been stashed on the matrices
+  void clearMatrixForces();
 public:
   MultiValue( const std::size_t& nvals, const std::size_t& nder, const std::size_t& nmat=0, const std::size_t& maxcol=0, const std::size_t& nbook=0 );
   void resize( const std::size_t& nvals, const std::size_t& nder, const std::size_t& nmat=0, const std::size_t& maxcol=0, const std::size_t& nbook=0 );
@@ -101,6 +117,9 @@ public:
   std::vector<Tensor>& getFirstAtomVirialVector();
   void resizeTemporyVector(const unsigned& n );
   std::vector<double>& getTemporyVector(const unsigned& ind );
+/// Get a cleared set of values and derivatives that can be used as a scratch space in a task.
+/// The memory is kept between calls
+  MultiValue& getTemporyMultiValue( const std::size_t& nvals, const std::size_t& nder );
 ///
   bool inVectorCall() const ;
 /// Set value numbered
@@ -147,6 +166,9 @@ public:
 /// Stash the forces on the matrix
   void addMatrixForce( const unsigned& imat, const unsigned& jind, const double& f );
   double getStashedMatrixForce( const unsigned& imat, const unsigned& jind ) const ;
+/// Get the number of forces that have been stashed on matrix imat and the index of the kth of these forces
+  unsigned getNumberOfStashedMatrixForces( const unsigned& imat ) const ;
+  unsigned getStashedMatrixForceIndex( const unsigned& imat, const unsigned& k ) const ;
 };
 
 inline
@@ -177,16 +199,29 @@ void MultiValue::addValue( const std::size_t& ival,  const double& val) {
   values[ival]+=val;
 }
 
+inline
+bool MultiValue::hasDerivative( const std::size_t& ival, const std::size_t& jder ) const {
+  unsigned pos=set_position[nderivatives*ival+jder];
+  return pos<nset[ival] && set_list[nderivatives*ival+pos]==jder;
+}
+
+inline
+void MultiValue::setHasDerivative( const std::size_t& ival, const std::size_t& jder ) {
+  if( hasDerivative( ival, jder ) ) return;
+  set_position[nderivatives*ival+jder]=nset[ival];
+  set_list[nderivatives*ival+nset[ival]]=jder; nset[ival]++;
+}
+
 inline
 void MultiValue::addDerivative( const std::size_t& ival, const std::size_t& jder, const double& der) {
   plumed_dbg_assert( ival<=values.size() && jder<nderivatives ); atLeastOneSet=true;
-  hasderiv[nderivatives*ival+jder]=true; derivatives[nderivatives*ival+jder] += der;
+  setHasDerivative( ival, jder ); derivatives[nderivatives*ival+jder] += der;
 }
 
 inline
 void MultiValue::setDerivative( const std::size_t& ival, const std::size_t& jder, const double& der) {
   plumed_dbg_assert( ival<=values.size() && jder<nderivatives ); atLeastOneSet=true;
-  hasderiv[nderivatives*ival+jder]=true; derivatives[nderivatives*ival+jder]=der;
+  setHasDerivative( ival, jder ); derivatives[nderivatives*ival+jder]=der;
 }
 
 
@@ -202,7 +237,7 @@ void MultiValue::updateIndex( const std::size_t& ival, const std::size_t& jder )
 #ifdef DNDEBUG
   for(unsigned i=0; i<nactive[ival]; ++i) plumed_dbg_assert( active_list[nderivatives*ival+nactive[ival]]!=jder );
 #endif
-  if( hasderiv[nderivatives*ival+jder] ) {
+  if( hasDerivative( ival, jder ) ) {
     plumed_dbg_assert( nactive[ival]<nderivatives);
     active_list[nderivatives*ival+nactive[ival]]=jder;
     nactive[ival]++;
@@ -337,7 +372,12 @@ std::vector<unsigned>& MultiValue::getMatrixRowDerivativeIndices( const unsigned
 
 inline
 void MultiValue::addMatrixForce( const unsigned& imat, const unsigned& jind, const double& f ) {
-  matrix_force_stash[imat*nderivatives + jind]+=f;
+  unsigned base=imat*nderivatives, pos=matrix_force_position[base+jind];
+  if( pos>=matrix_force_nset[imat] || matrix_force_list[base+pos]!=jind ) {
+    matrix_force_position[base+jind]=matrix_force_nset[imat];
+    matrix_force_list[base+matrix_force_nset[imat]]=jind; matrix_force_nset[imat]++;
+  }
+  matrix_force_stash[base+jind]+=f;
 }
 
 inline
@@ -345,6 +385,16 @@ double MultiValue::getStashedMatrixForce( const unsigned& imat, const unsigned&
   return matrix_force_stash[imat*nderivatives + jind];
 }
 
+inline
+unsigned MultiValue::getNumberOfStashedMatrixForces( const unsigned& imat ) const {
+  return matrix_force_nset[imat];
+}
+
+inline
+unsigned MultiValue::getStashedMatrixForceIndex( const unsigned& imat, const unsigned& k ) const {
+  return matrix_force_list[imat*nderivatives + k];
+}
+
 inline
 void MultiValue::resizeTemporyVector(const unsigned& n ) {
   if( n>tmp_vectors.size() ) tmp_vectors.resize(n);
@@ -26,6 +26,7 @@
 #include "Communicator.h"
 #include "OpenMP.h"
 #include "Tools.h"
+#include "LinkCells.h"
 #include <vector>
 #include <algorithm>
 #include <numeric>
@@ -45,7 +46,8 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
                            const Pbc& pbc,
                            Communicator& cm,
                            const double& distance,
-                           const unsigned& stride)
+                           const unsigned& stride,
+                           const double& skin)
   : reduced(false),
     serial_(serial),
     do_pair_(do_pair),
@@ -58,7 +60,8 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
     distance_(distance),
     nlist0_(list0.size()),
     nlist1_(list1.size()),
-    stride_(stride) {
+    stride_(stride),
+    skin_(skin) {
   // store the rest of the atoms into fullatomlist_
   fullatomlist_.insert(fullatomlist_.end(),list1.begin(),list1.end());
   if(!do_pair) {
@@ -78,7 +81,8 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
                            const Pbc& pbc,
                            Communicator& cm,
                            const double& distance,
-                           const unsigned& stride)
+                           const unsigned& stride,
+                           const double& skin)
   : reduced(false),
     serial_(serial),
     do_pbc_(do_pbc),
@@ -90,13 +94,17 @@ NeighborList::NeighborList(const std::vector<AtomNumber>& list0,
     distance_(distance),
     nlist0_(list0.size()),
     nallpairs_(nlist0_*(nlist0_-1)/2),
-    stride_(stride) {
+    stride_(stride),
+    skin_(skin) {
   initialize();
 }
 
 NeighborList::~NeighborList()=default;
 
 void NeighborList::initialize() {
+  // with a skin the list is built at the first call to update(), as its users
+  // check needsUpdate() before using it, so there is no need to store all the pairs
+  if(skin_>0.0) return;
 #ifdef __APPLE__
   //this mac-only error is here because on my experience the mac tries to page
   //the memory on the hdd instead of throwing a memory error
@@ -158,31 +166,39 @@ void NeighborList::update(const std::vector<Vector>& positions) {
   }
   std::vector<unsigned> local_flat_nl;
 
-  #pragma omp parallel num_threads(nt)
-  {
-    std::vector<unsigned> private_flat_nl;
-    #pragma omp for nowait
-    for(unsigned int i=rank; i<nallpairs_; i+=stride) {
-      pairIDs index=getIndexPair(i);
-      unsigned index0=index.first;
-      unsigned index1=index.second;
-      Vector distance;
-      if(do_pbc_) {
-        distance=pbc_->distance(positions[index0],positions[index1]);
-      } else {
-        distance=delta(positions[index0],positions[index1]);
-      }
-      double value=modulo2(distance);
-      if(value<=d2) {
-        private_flat_nl.push_back(index0);
-        private_flat_nl.push_back(index1);
+  // link cells can only be used if the two atoms in a pair are not fixed
+  // and if the box is known
+  const bool uselinkcells=!(twolists_ && do_pair_) && do_pbc_ && pbc_->isSet();
+  if(uselinkcells) {
+    findPairsWithLinkCells(positions,rank,stride,nt,local_flat_nl);
+  } else {
+    #pragma omp parallel num_threads(nt)
+    {
+      std::vector<unsigned> private_flat_nl;
+      #pragma omp for nowait
+      for(unsigned int i=rank; i<nallpairs_; i+=stride) {
+        pairIDs index=getIndexPair(i);
+        unsigned index0=index.first;
+        unsigned index1=index.second;
+        Vector distance;
+        if(do_pbc_) {
+          distance=pbc_->distance(positions[index0],positions[index1]);
+        } else {
+          distance=delta(positions[index0],positions[index1]);
+        }
+        double value=modulo2(distance);
+        if(value<=d2) {
+          private_flat_nl.push_back(index0);
+          private_flat_nl.push_back(index1);
+        }
       }
+      #pragma omp critical
+      local_flat_nl.insert(local_flat_nl.end(),
+                           private_flat_nl.begin(),
+                           private_flat_nl.end());
     }
-    #pragma omp critical
-    local_flat_nl.insert(local_flat_nl.end(),
-                         private_flat_nl.begin(),
-                         private_flat_nl.end());
   }
+  if(skin_>0.0) reference_positions_=positions;
 
   // find total dimension of neighborlist
   std::vector <int> local_nl_size(stride, 0);
@@ -219,10 +235,71 @@ void NeighborList::update(const std::vector<Vector>& positions) {
     unsigned j=2*i;
     neighbors_[i] = std::make_pair(merge_nl[j],merge_nl[j+1]);
   }
+  // pairs found with link cells are sorted so that they are in the same order
+  // as the ones found by looping over all the pairs
+  if(uselinkcells) std::sort(neighbors_.begin(),neighbors_.end());
 
   setRequestList();
 }
 
+void NeighborList::findPairsWithLinkCells(const std::vector<Vector>& positions,const unsigned rank,const unsigned stride,const unsigned nt,std::vector<unsigned>& flat_nl) const {
+  const double d2=distance_*distance_;
+  // with two lists only the atoms of the second list are put in the cells,
+  // with a single list all the atoms are
+  const unsigned firstincell=(twolists_ ? nlist0_ : 0);
+  std::vector<Vector> cellpos(positions.begin()+firstincell,positions.end());
+  std::vector<unsigned> cellind(cellpos.size());
+  std::iota(cellind.begin(),cellind.end(),firstincell);
+  LinkCells cells(comm);
+  cells.setCutoff(distance_);
+  cells.buildCellLists(cellpos,cellind,*pbc_);
+  const unsigned maxneigh=1+27*cells.getMaxInCell();
+
+  #pragma omp parallel num_threads(nt)
+  {
+    std::vector<unsigned> private_flat_nl;
+    std::vector<unsigned> cell_list;
+    std::vector<unsigned> atoms(maxneigh);
+    #pragma omp for nowait
+    for(unsigned int index0=rank; index0<nlist0_; index0+=stride) {
+      unsigned natoms=1;
+      atoms[0]=index0;
+      cells.retrieveNeighboringAtoms(positions[index0],cell_list,natoms,atoms);
+      for(unsigned k=1; k<natoms; ++k) {
+        const unsigned index1=atoms[k];
+        // with a single list each pair is only stored once
+        if(!twolists_ && index1<index0) continue;
+        Vector distance=pbc_->distance(positions[index0],positions[index1]);
+        if(modulo2(distance)<=d2) {
+          private_flat_nl.push_back(index0);
+          private_flat_nl.push_back(index1);
+        }
+      }
+    }
+    #pragma omp critical
+    flat_nl.insert(flat_nl.end(),
+                   private_flat_nl.begin(),
+                   private_flat_nl.end());
+  }
+}
+
+bool NeighborList::needsUpdate(const std::vector<Vector>& positions) const {
+  if(reference_positions_.size()!=positions.size()) return true;
+  const double maxdisp2=0.25*skin_*skin_;
+  bool moved=false;
+  #pragma omp parallel for num_threads(OpenMP::getNumThreads()) reduction(||:moved)
+  for(unsigned i=0; i<positions.size(); ++i) {
+    Vector displacement;
+    if(do_pbc_) {
+      displacement=pbc_->distance(reference_positions_[i],positions[i]);
+    } else {
+      displacement=delta(reference_positions_[i],positions[i]);
+    }
+    if(modulo2(displacement)>maxdisp2) moved=true;
+  }
+  return moved;
+}
+
 void NeighborList::setRequestList() {
   requestlist_.clear();
   for(unsigned int i=0; i<size(); ++i) {
@@ -256,6 +333,10 @@ unsigned NeighborList::getStride() const {
   return stride_;
 }
 
+double NeighborList::getSkin() const {
+  return skin_;
+}
+
 unsigned NeighborList::getLastUpdate() const {
   return lastupdate_;
 }
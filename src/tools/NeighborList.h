@@ -55,6 +55,9 @@ private:
   size_t nallpairs_;
   unsigned stride_=0;
   unsigned lastupdate_=0;
+  double skin_=0.0;
+/// Positions of the atoms when the list was last updated (only stored if skin_>0)
+  std::vector<PLMD::Vector> reference_positions_{};
 /// Initialize the neighbor list with all possible pairs
   void initialize();
 /// Return the pair of indexes in the positions array
@@ -62,6 +65,8 @@ private:
   pairIDs getIndexPair(unsigned i);
 /// Extract the list of atoms from the current list of close pairs
   void setRequestList();
+/// Find the close pairs using link cells, the pairs are stored as in update()
+  void findPairsWithLinkCells(const std::vector<PLMD::Vector>& positions,unsigned rank,unsigned stride,unsigned nt,std::vector<unsigned>& flat_nl) const;
 public:
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const std::vector<PLMD::AtomNumber>& list1,
@@ -71,14 +76,16 @@ public:
                const PLMD::Pbc& pbc,
                Communicator &cm,
                const double& distance=1.0e+30,
-               const unsigned& stride=0);
+               const unsigned& stride=0,
+               const double& skin=0.0);
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const bool& serial,
                const bool& do_pbc,
                const PLMD::Pbc& pbc,
                Communicator &cm,
                const double& distance=1.0e+30,
-               const unsigned& stride=0);
+               const unsigned& stride=0,
+               const double& skin=0.0);
   ~NeighborList();
 /// Return the list of all atoms. These are needed to rebuild the neighbor list.
   std::vector<PLMD::AtomNumber>& getFullAtomList();
@@ -91,6 +98,10 @@ public:
   void update(const std::vector<PLMD::Vector>& positions);
 /// Get the update stride of the neighbor list
   unsigned getStride() const;
+/// Get the skin of the neighbor list
+  double getSkin() const;
+/// Check if an atom moved by more than half of the skin since the last update
+  bool needsUpdate(const std::vector<PLMD::Vector>& positions) const;
 /// Get the last step in which the neighbor list was updated
   unsigned getLastUpdate() const;
 /// Set the step of the last update
@@ -26,6 +26,7 @@
 #include "core/Value.h"
 #include "Communicator.h"
 #include "Tools.h"
+#include "AsyncWriter.h"
 #include <cstdarg>
 #include <cstring>
 
@@ -43,21 +44,35 @@
 
 namespace PLMD {
 
-size_t OFile::llwrite(const char*ptr,size_t s) {
+size_t OFile::rawWrite(const char*ptr,size_t s) {
   size_t r;
-  if(linked) return linked->llwrite(ptr,s);
-  if(! (comm && comm->Get_rank()>0)) {
-    if(!fp) plumed_merror("writing on uninitialized File");
-    if(gzfp) {
+  if(!fp) plumed_merror("writing on uninitialized File");
+  if(gzfp) {
 #ifdef __PLUMED_HAS_ZLIB
-      r=gzwrite(gzFile(gzfp),ptr,s);
+    r=gzwrite(gzFile(gzfp),ptr,s);
 #else
-      plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
+    plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
-    } else {
-      r=std::fwrite(ptr,1,s,fp);
+  } else {
+    r=std::fwrite(ptr,1,s,fp);
+  }
+  return r;
+}
+
+size_t OFile::llwrite(const char*ptr,size_t s) {
+  size_t r;
+  if(linked) return linked->llwrite(ptr,s);
+  if(async) {
+// the number of written bytes is not known yet, so that processes do not need to communicate
+    if(! (comm && comm->Get_rank()>0)) {
+      if(!fp) plumed_merror("writing on uninitialized File");
+      asyncBuffer.insert(asyncBuffer.end(),ptr,ptr+s);
+// data are passed to the background thread in chunks
+      if(asyncBuffer.size()>=65536) asyncSubmit();
     }
+    return s;
   }
+  if(! (comm && comm->Get_rank()>0)) r=rawWrite(ptr,s);
   if(comm) {
 //  This barrier is apparently useless since it comes
 //  just before a Bcast.
@@ -74,6 +89,8 @@ size_t OFile::llwrite(const char*ptr,size_t s) {
 
 OFile::OFile():
   linked(NULL),
+  async(false),
+  asyncTicket(0),
   fieldChanged(false),
   backstring("bck"),
   enforceRestart_(false),
@@ -89,6 +106,41 @@ OFile::OFile():
   buffer_string.resize(1000,0);
 }
 
+OFile::~OFile() {
+  if(async) {
+// exceptions cannot be thrown from a destructor
+    try {
+      asyncSync();
+    } catch(...) {
+    }
+  }
+}
+
+void OFile::asyncSubmit() {
+  if(asyncBuffer.empty()) return;
+  std::vector<char> data;
+  std::swap(data,asyncBuffer);
+  auto size=data.size();
+  asyncTicket=AsyncWriter::get().submit(size,[this,data=std::move(data)]() { rawWrite(data.data(),data.size()); },this);
+}
+
+void OFile::asyncSync() {
+  asyncSubmit();
+  if(asyncTicket>0) AsyncWriter::get().wait(asyncTicket,this);
+  asyncTicket=0;
+}
+
+OFile& OFile::enableAsync() {
+  plumed_massert(!fp,"asynchronous output should be enabled before opening the file");
+  async=true;
+  return *this;
+}
+
+void OFile::close() {
+  if(async) asyncSync();
+  FileBase::close();
+}
+
 OFile& OFile::link(OFile&l) {
   fp=NULL;
   gzfp=NULL;
@@ -327,6 +379,7 @@ OFile& OFile::open(const std::string&path) {
   gzfp=NULL;
   this->path=path;
   this->path=appendSuffix(path,getSuffix());
+  if(plumed && plumed->getAsyncOutput()) async=true;
   if(checkRestart()) {
     fp=std::fopen(const_cast<char*>(this->path.c_str()),"a");
     mode="a";
@@ -350,6 +403,9 @@ OFile& OFile::open(const std::string&path) {
 #endif
     }
   }
+// all processes open the file, make sure they are done before the first process writes
+// (synchronous writes are already synchronized)
+  if(async && comm) comm->Barrier();
   if(plumed) plumed->insertFile(*this);
   return *this;
 }
@@ -359,6 +415,7 @@ OFile& OFile::rewind() {
 // the reason is that normal rewind does not work when in append mode
 // moreover, we can take a backup of the file
   plumed_assert(fp);
+  if(async) asyncSync();
   clearFields();
 
   if(!comm || comm->Get_rank()==0) {
@@ -384,10 +441,12 @@ OFile& OFile::rewind() {
     // no exception here
     fp=std::fopen(const_cast<char*>(path.c_str()),"w");
   }
+  if(async && comm) comm->Barrier();
   return *this;
 }
 
 FileBase& OFile::flush() {
+  if(async) asyncSync();
   if(heavyFlush) {
     if(gzfp) {
 #ifdef __PLUMED_HAS_ZLIB
@@ -27,6 +27,7 @@
 #include <sstream>
 #include <memory>
 #include <cstddef>
+#include <cstdint>
 
 namespace PLMD {
 
@@ -167,6 +168,18 @@ class OFile:
   };
 /// Low-level write
   std::size_t llwrite(const char*,std::size_t);
+/// Write directly on the underlying file
+  std::size_t rawWrite(const char*,std::size_t);
+/// True if data are written on a background thread (see AsyncWriter)
+  bool async;
+/// Data waiting to be passed to the background thread
+  std::vector<char> asyncBuffer;
+/// Ticket of the last write passed to the background thread
+  std::uint64_t asyncTicket;
+/// Pass the data in asyncBuffer to the background thread
+  void asyncSubmit();
+/// Wait until all the data has been written
+  void asyncSync();
 /// True if fields has changed.
 /// This could be due to a change in the list of fields or a reset
 /// of a nominally constant field
@@ -196,6 +209,8 @@ class OFile:
 public:
 /// Constructor
   OFile();
+/// Destructor, waits for the data written asynchronously
+  ~OFile();
 /// Allows overloading of link
   using FileBase::link;
 /// Allows overloading of open
@@ -264,6 +279,12 @@ public:
   OFile&rewind();
 /// Flush a file
   FileBase&flush() override;
+/// Close the file, after all the data written asynchronously has reached it
+  void close() override;
+/// Write the data on a background thread, so that the calling thread does not wait for the disk.
+/// Should be called before opening the file. Data is guaranteed to be on the file
+/// after flush(), rewind() and close().
+  OFile&enableAsync();
 /// Enforce restart, also if the attached plumed object is not restarting.
 /// Useful for tests
   OFile&enforceRestart();
@@ -22,6 +22,8 @@
 
 #include "OpenMP.h"
 #include "Tools.h"
+#include "Exception.h"
+#include <cstdint>
 #include <cstdlib>
 #if defined(_OPENMP)
 #include <omp.h>
@@ -78,5 +80,49 @@ unsigned getThreadNum() {
 #endif
 }
 
+BufferReduction::BufferReduction(unsigned nthreads,const std::vector<double>& buffer):
+  n(buffer.size()),
+  blocksize(std::max<std::size_t>(1,getCachelineSize()/sizeof(double))),
+  shift(0),
+  arrays(nthreads),
+  written(nthreads)
+{
+  const std::size_t misalign=reinterpret_cast<std::uintptr_t>(buffer.data())%(blocksize*sizeof(double));
+  if(misalign%sizeof(double)==0) shift=misalign/sizeof(double);
+  nblocks=(n+shift+blocksize-1)/blocksize;
+}
+
+std::vector<double>& BufferReduction::getArray() {
+  std::vector<double>& a(arrays[getThreadNum()]);
+  a.assign(n,0.0);
+  return a;
+}
+
+void BufferReduction::sum(std::vector<double>& result) {
+  plumed_dbg_assert(result.size()==n);
+  const unsigned it=getThreadNum();
+  if(!arrays[it].empty()) {
+    const std::vector<double>& a(arrays[it]);
+    std::vector<char>& w(written[it]);
+    w.assign(nblocks,0);
+    for(std::size_t k=0; k<nblocks; ++k) {
+      const std::size_t jend=blockStart(k+1);
+      for(std::size_t j=blockStart(k); j<jend; ++j) {
+        if(a[j]!=0.0) { w[k]=1; break; }
+      }
+    }
+  }
+  #pragma omp barrier
+  #pragma omp for schedule(static)
+  for(std::size_t k=0; k<nblocks; ++k) {
+    const std::size_t jstart=blockStart(k), jend=blockStart(k+1);
+    for(unsigned t=0; t<arrays.size(); ++t) {
+      if(arrays[t].empty() || !written[t][k]) continue;
+      const std::vector<double>& a(arrays[t]);
+      for(std::size_t j=jstart; j<jend; ++j) result[j]+=a[j];
+    }
+  }
+}
+
 }//namespace OpenMP
 }//namespace PLMD
@@ -22,6 +22,7 @@
 #ifndef __PLUMED_tools_OpenMP_h
 #define __PLUMED_tools_OpenMP_h
 
+#include <algorithm>
 #include <vector>
 
 namespace PLMD {
@@ -66,6 +67,73 @@ unsigned getGoodNumThreads(const std::vector<T> & v) {
   else return getGoodNumThreads(&v[0],v.size());
 }
 
+/// Thread-private copies of an array that are then summed into a shared array.
+/// Each thread accumulates in the copy returned by getArray(). The copies are then
+/// summed by calling sum() from all the threads of the team: each thread takes care
+/// of a contiguous block of elements and sums it over all the copies, so that no
+/// critical section is needed and the result does not depend on the order in which
+/// the threads finish.
+template<typename T>
+class ArrayReduction {
+  std::size_t n;
+  std::vector<std::vector<T>> arrays;
+public:
+/// Prepare the copies of an array of n elements for nthreads threads
+  ArrayReduction(unsigned nthreads,std::size_t n):
+    n(n),
+    arrays(nthreads)
+  {}
+/// Get the zeroed copy of the calling thread.
+/// Memory is allocated by the thread that uses it
+  std::vector<T>& getArray() {
+    std::vector<T>& a(arrays[getThreadNum()]);
+    a.assign(n,T());
+    return a;
+  }
+/// Add the copies of all the threads to result.
+/// This should be called by all the threads in the team, as it contains a barrier
+/// and a worksharing loop
+  void sum(std::vector<T>& result) const {
+    #pragma omp barrier
+    #pragma omp for
+    for(std::size_t i=0; i<n; ++i) {
+      for(const auto & a : arrays) {
+        if(!a.empty()) result[i]+=a[i];
+      }
+    }
+  }
+};
+
+/// Thread-private copies of a buffer of doubles that are summed block by block.
+/// The buffer is split in blocks of one cache line, aligned with the cache lines of the
+/// shared buffer, and each thread owns a contiguous range of blocks when the copies are summed.
+/// Before summing, each thread records the blocks of its copy that contain non-zero elements,
+/// so that blocks that were never written by a thread are not read from its copy.
+/// This is useful when each thread only writes to a small part of a large buffer.
+class BufferReduction {
+  std::size_t n;
+  std::size_t blocksize;
+/// Offset, in elements, of the shared buffer from the preceding cache line boundary
+  std::size_t shift;
+  std::size_t nblocks;
+  std::vector<std::vector<double>> arrays;
+  std::vector<std::vector<char>> written;
+/// First element of block k
+  std::size_t blockStart(std::size_t k) const {
+    return k*blocksize>shift ? std::min(n,k*blocksize-shift) : 0;
+  }
+public:
+/// Prepare the copies of buffer for nthreads threads
+  BufferReduction(unsigned nthreads,const std::vector<double>& buffer);
+/// Get the zeroed copy of the calling thread.
+/// Memory is allocated by the thread that uses it
+  std::vector<double>& getArray();
+/// Add the copies of all the threads to result, which should be the buffer passed to the constructor.
+/// This should be called by all the threads in the team, as it contains barriers
+/// and a worksharing loop
+  void sum(std::vector<double>& result);
+};
+
 }//namespace OpenMP
 }//namespace PLMD
 
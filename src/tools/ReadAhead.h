@@ -0,0 +1,152 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_ReadAhead_h
+#define __PLUMED_tools_ReadAhead_h
+
+#include "Exception.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// Prepares objects in advance on a background thread, keeping them in a ring buffer
+/// from which they are consumed in order.
+/// The producer function fills the object it is passed and returns false when there
+/// is nothing left to produce. Objects are recycled, so that the memory they allocated
+/// can be reused, and the one returned by next() stays valid until next() is called again.
+///
+/// \verbatim
+/// // decode up to four frames while the current one is analysed
+/// ReadAhead<std::vector<double>> frames(4,[&](std::vector<double>& v) { return readFrame(v); });
+/// while(auto* v=frames.next()) analyse(*v);
+/// \endverbatim
+///
+/// Exceptions thrown by the producer are rethrown by next() once the objects
+/// produced before are consumed.
+template<typename T>
+class ReadAhead {
+  std::vector<T> ring;
+  std::function<bool(T&)> produce;
+  std::mutex mtx;
+  std::condition_variable cv;
+/// Index of the object that is next to be consumed
+  unsigned head=0;
+/// Number of objects that are ready to be consumed
+  unsigned nready=0;
+/// True when the object at head is held by the consumer
+  bool holding=false;
+  bool finished=false;
+  bool stop=false;
+  std::exception_ptr error;
+  std::thread worker;
+/// Loop run by the background thread
+  void run();
+public:
+/// Create a buffer that produces up to n objects in advance
+  ReadAhead(unsigned n,const std::function<bool(T&)>& produce);
+  ~ReadAhead();
+  ReadAhead(const ReadAhead&)=delete;
+  ReadAhead& operator=(const ReadAhead&)=delete;
+/// Release the object returned by the previous call and get the next one.
+/// Returns nullptr when the producer is done.
+  T* next();
+};
+
+template<typename T>
+ReadAhead<T>::ReadAhead(unsigned n,const std::function<bool(T&)>& produce):
+  ring(n+1),
+  produce(produce)
+{
+  plumed_assert(n>0);
+  worker=std::thread([this]() { run(); });
+}
+
+template<typename T>
+ReadAhead<T>::~ReadAhead() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    stop=true;
+  }
+  cv.notify_all();
+  worker.join();
+}
+
+template<typename T>
+void ReadAhead<T>::run() {
+  unsigned tail=0;
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock,[this]() { return stop || nready+holding<ring.size(); });
+      if(stop) return;
+    }
+// the object at tail is neither ready nor held, so that it can be filled without the lock
+    bool more=false;
+    std::exception_ptr e;
+    try {
+      more=produce(ring[tail]);
+    } catch(...) {
+      e=std::current_exception();
+    }
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if(more) nready++;
+      else {
+        finished=true;
+        error=e;
+      }
+    }
+    cv.notify_all();
+    if(!more) return;
+    tail=(tail+1)%ring.size();
+  }
+}
+
+template<typename T>
+T* ReadAhead<T>::next() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    if(holding) {
+      head=(head+1)%ring.size();
+      holding=false;
+    }
+  }
+  cv.notify_all();
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock,[this]() { return nready>0 || finished; });
+  if(nready>0) {
+    nready--;
+    holding=true;
+    return &ring[head];
+  }
+  if(error) std::rethrow_exception(error);
+  return nullptr;
+}
+
+}
+
+#endif
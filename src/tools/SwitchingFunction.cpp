@@ -27,6 +27,7 @@
 #include <limits>
 #include <algorithm>
 #include <optional>
+#include <array>
 
 namespace PLMD {
 
@@ -221,6 +222,29 @@ double baseSwitch::calculateSqr(double distance2,double&dfunc) const {
   double res= calculate(std::sqrt(distance2),dfunc);//RVO!
   return res;
 }
+void baseSwitch::calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const {
+  for(unsigned i=0; i<n; ++i) {
+    result[i]=calculateSqr(distance2[i],dfunc[i]);
+  }
+}
+template<typename F>
+void baseSwitch::calculateBatchWithSqrt(F func,const double* distance2,double* result,double* dfunc,unsigned n) const {
+  //same operations as calculate(), with the branches replaced by selections
+  //the values computed outside of (d0,dmax] are discarded
+  #pragma omp simd
+  for(unsigned i=0; i<n; ++i) {
+    const double distance=std::sqrt(distance2[i]);
+    const double rdist = (distance-d0)*invr0;
+    double df=0.0;
+    double res = func(rdist,df);
+    df *= invr0;
+    df /= distance;
+    res = (rdist > 0.0) ? res : 1.0;
+    df = (rdist > 0.0) ? df : 0.0;
+    result[i] = (distance <= dmax) ? res*stretch+shift : 0.0;
+    dfunc[i] = (distance <= dmax) ? df*stretch : 0.0;
+  }
+}
 double baseSwitch::get_d0() const {return d0;}
 double baseSwitch::get_r0() const {return 1.0/invr0;}
 double baseSwitch::get_dmax() const {return dmax;}
@@ -290,6 +314,17 @@ public:
     return result;
 
   }
+
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    #pragma omp simd
+    for(unsigned i=0; i<n; ++i) {
+      const double rdist = distance2[i]*invr0_2;
+      double df=0.0;
+      const double res = doRational<N/2>(rdist,df);
+      result[i] = (distance2[i] <= dmax_2) ? res*stretch+shift : 0.0;
+      dfunc[i] = (distance2[i] <= dmax_2) ? df*2*invr0_2*stretch : 0.0;
+    }
+  }
 };
 
 //these enums are useful for clarifying the settings in the factory
@@ -386,6 +421,22 @@ public:
       return res;
     }
   }
+
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    if constexpr (isFast==rationalPow::fast) {
+      #pragma omp simd
+      for(unsigned i=0; i<n; ++i) {
+        const double rdist = distance2[i]*invr0_2;
+        double df=preDfuncF;
+        const double res = doRational(rdist,df,preSecDevF,nnf,mmf,preRes);
+        result[i] = (distance2[i] <= dmax_2) ? res*stretch+shift : 0.0;
+        dfunc[i] = (distance2[i] <= dmax_2) ? df*2*invr0_2*stretch : 0.0;
+      }
+    } else {
+      calculateBatchWithSqrt([this](double rdist,double&df) {return rational::function(rdist,df);},
+      distance2,result,dfunc,n);
+    }
+  }
 };
 
 
@@ -446,6 +497,10 @@ protected:
     dfunc=-result;
     return result;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return exponentialSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class gaussianSwitch: public baseSwitch {
@@ -458,6 +513,10 @@ protected:
     dfunc=-rdist*result;
     return result;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return gaussianSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class fastGaussianSwitch: public baseSwitch {
@@ -483,6 +542,14 @@ protected:
     }
     return result;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    #pragma omp simd
+    for(unsigned i=0; i<n; ++i) {
+      const double res = std::exp(-0.5*distance2[i]);
+      result[i] = (distance2[i] <= dmax_2) ? res*stretch+shift : 0.0;
+      dfunc[i] = (distance2[i] <= dmax_2) ? -res*stretch : 0.0;
+    }
+  }
 };
 
 class smapSwitch: public baseSwitch {
@@ -511,6 +578,10 @@ protected:
     dfunc=-b*sx/rdist*result/(1.0+sx);
     return result;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return smapSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class cubicSwitch: public baseSwitch {
@@ -537,6 +608,10 @@ protected:
     dfunc = 2*tmp1*tmp2 + 2*tmp1*tmp1;
     return tmp1*tmp1*tmp2;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return cubicSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class tanhSwitch: public baseSwitch {
@@ -551,6 +626,10 @@ protected:
     //return result;
     return 1.0 - tmp1;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return tanhSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class cosinusSwitch: public baseSwitch {
@@ -569,6 +648,10 @@ protected:
     }
     return result;
   }
+  void calculateSqrBatch(const double* distance2,double* result,double* dfunc,unsigned n) const override {
+    calculateBatchWithSqrt([this](double rdist,double&df) {return cosinusSwitch::function(rdist,df);},
+    distance2,result,dfunc,n);
+  }
 };
 
 class nativeqSwitch: public baseSwitch {
@@ -928,6 +1011,36 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
   return function -> calculateSqr(distance2, dfunc);
 }
 
+void SwitchingFunction::calculateSqr(const double* distance2,double* result,double* dfunc,unsigned n)const {
+  plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+  // the distances beyond dmax are usually the large majority, so they are set to zero here
+  // and only the others are packed and passed to the switching function
+  constexpr unsigned chunk=64;
+  std::array<double,chunk> packed_distance2;
+  std::array<double,chunk> packed_result;
+  std::array<double,chunk> packed_dfunc;
+  std::array<unsigned,chunk> packed_index;
+  const double dmax2=function->get_dmax2();
+  for(unsigned start=0; start<n; start+=chunk) {
+    const unsigned end=std::min(n,start+chunk);
+    unsigned npacked=0;
+    for(unsigned i=start; i<end; ++i) {
+      result[i]=0.0;
+      dfunc[i]=0.0;
+      if(distance2[i]<=dmax2) {
+        packed_distance2[npacked]=distance2[i];
+        packed_index[npacked]=i;
+        npacked++;
+      }
+    }
+    function -> calculateSqrBatch(packed_distance2.data(),packed_result.data(),packed_dfunc.data(),npacked);
+    for(unsigned k=0; k<npacked; ++k) {
+      result[packed_index[k]]=packed_result[k];
+      dfunc[packed_index[k]]=packed_dfunc[k];
+    }
+  }
+}
+
 double SwitchingFunction::calculate(double distance,double&dfunc)const {
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
   double result=function->calculate(distance,dfunc);
@@ -52,12 +52,18 @@ protected:
   virtual std::string specificDescription() const;
   //
   virtual double function(double rdist, double& dfunc) const=0;
+  /// loop used by calculateSqrBatch() for the functions that need the square root of the distance,
+  /// func should be a non-virtual call to function()
+  template<typename F>
+  void calculateBatchWithSqrt(F func, const double* distance2, double* result, double* dfunc, unsigned n) const;
 public:
   baseSwitch(double D0,double DMAX, double R0, std::string_view name);
   virtual ~baseSwitch();
   ///the driver for the function (prepares rdist or returns 1 or 0 automatically)
   virtual double calculate(double distance, double& dfunc) const;
   virtual double calculateSqr(double distance2, double& dfunc) const;
+  /// batched version of calculateSqr(), the default implementation calls calculateSqr() on each element
+  virtual void calculateSqrBatch(const double* distance2, double* result, double* dfunc, unsigned n) const;
   void setupStretch();
   void removeStretch();
   std::string description() const;
@@ -103,6 +109,11 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function on n squared distances.
+/// result[i] and dfunc[i] are the same as those returned by calculateSqr(distance2[i],dfunc[i]),
+/// but the loop is done within the switching function. This avoids a virtual call per distance and,
+/// for the most common functional forms, allows the compiler to vectorize the loop
+  void calculateSqr(const double* distance2,double* result,double* dfunc,unsigned n)const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
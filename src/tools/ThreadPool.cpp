@@ -0,0 +1,143 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "ThreadPool.h"
+#include "Exception.h"
+
+namespace PLMD {
+
+ThreadPool::ThreadPool(unsigned nthreads) {
+  plumed_assert(nthreads>0);
+  for(unsigned i=1; i<nthreads; i++) workers.emplace_back([this]() { workerLoop(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    stop=true;
+  }
+  cv.notify_all();
+  for(auto & w : workers) w.join();
+}
+
+void ThreadPool::workerLoop() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while(true) {
+    cv.wait(lock,[this]() { return stop || !ready.empty(); });
+    if(stop) return;
+    unsigned i=ready.top();
+    ready.pop();
+    runTask(i,lock);
+  }
+}
+
+void ThreadPool::runTask(unsigned i,std::unique_lock<std::mutex>& lock) {
+  bool skip=false;
+  for(auto d : (*deps)[i]) if(failed[d]) skip=true;
+  lock.unlock();
+  std::exception_ptr error;
+  if(!skip) {
+    try {
+      (*func)(i);
+    } catch(...) {
+      error=std::current_exception();
+    }
+  }
+  lock.lock();
+  if(error) (*errors)[i]=error;
+  failed[i]=skip || error;
+  unsigned nready=0;
+  for(auto j : dependents[i]) {
+    missing[j]--;
+    if(missing[j]==0) {
+      ready.push(j);
+      nready++;
+    }
+  }
+  ncompleted++;
+  if(nready>1) cv.notify_all();
+  else if(nready==1) cv.notify_one();
+  if(ncompleted==ntasks) cvDone.notify_all();
+}
+
+bool ThreadPool::isAcyclic(const std::vector<std::vector<unsigned>>& deps) {
+  const unsigned n=deps.size();
+  std::vector<std::vector<unsigned>> dependents(n);
+  std::vector<unsigned> missing(n,0);
+  for(unsigned i=0; i<n; i++) {
+    for(auto d : deps[i]) {
+      plumed_assert(d<n);
+      dependents[d].push_back(i);
+      missing[i]++;
+    }
+  }
+  std::vector<unsigned> todo;
+  for(unsigned i=0; i<n; i++) if(missing[i]==0) todo.push_back(i);
+  unsigned nvisited=0;
+  while(!todo.empty()) {
+    unsigned i=todo.back();
+    todo.pop_back();
+    nvisited++;
+    for(auto j : dependents[i]) if(--missing[j]==0) todo.push_back(j);
+  }
+  return nvisited==n;
+}
+
+void ThreadPool::runGraph(const std::vector<std::vector<unsigned>>& deps,const std::function<void(unsigned)>& func,std::vector<std::exception_ptr>& errors) {
+  const unsigned n=deps.size();
+  errors.assign(n,nullptr);
+  if(n==0) return;
+  std::unique_lock<std::mutex> lock(mtx);
+  plumed_assert(ready.empty());
+  this->deps=&deps;
+  this->func=&func;
+  this->errors=&errors;
+  ntasks=n;
+  ncompleted=0;
+  dependents.assign(n,std::vector<unsigned>());
+  missing.assign(n,0);
+  failed.assign(n,0);
+  for(unsigned i=0; i<n; i++) {
+    for(auto d : deps[i]) {
+      plumed_assert(d<n);
+      dependents[d].push_back(i);
+      missing[i]++;
+    }
+  }
+  for(unsigned i=0; i<n; i++) if(missing[i]==0) ready.push(i);
+  plumed_assert(!ready.empty()) << "the graph of tasks contains a cycle";
+  cv.notify_all();
+// the calling thread works as well, until all the tasks are completed
+  while(ncompleted<ntasks) {
+    if(!ready.empty()) {
+      unsigned i=ready.top();
+      ready.pop();
+      runTask(i,lock);
+    } else {
+      cvDone.wait(lock,[this]() { return ncompleted==ntasks || !ready.empty(); });
+    }
+  }
+  this->deps=nullptr;
+  this->func=nullptr;
+  this->errors=nullptr;
+}
+
+}
@@ -0,0 +1,93 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2023 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_ThreadPool_h
+#define __PLUMED_tools_ThreadPool_h
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace PLMD {
+
+/// \ingroup TOOLBOX
+/// A pool of persistent threads running graphs of dependent tasks.
+/// Tasks are identified by their index and are started as soon as all
+/// the tasks they depend on are completed. Among the tasks that are ready,
+/// the one with the smallest index is started first. The calling thread
+/// takes part in the calculation, so that a pool with a single thread
+/// runs all the tasks serially, in a topological order.
+///
+/// \verbatim
+/// ThreadPool pool(4);
+/// // task 2 needs the results of tasks 0 and 1
+/// std::vector<std::vector<unsigned>> deps{{},{},{0,1}};
+/// std::vector<std::exception_ptr> errors;
+/// pool.runGraph(deps,[&](unsigned i) { work(i); },errors);
+/// \endverbatim
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex mtx;
+/// Signals the workers that a task is ready or that the pool is being destroyed
+  std::condition_variable cv;
+/// Signals the calling thread that all the tasks are completed
+  std::condition_variable cvDone;
+  bool stop=false;
+/// Status of the graph being run
+  std::priority_queue<unsigned,std::vector<unsigned>,std::greater<unsigned>> ready;
+  std::vector<std::vector<unsigned>> dependents;
+  std::vector<unsigned> missing;
+  std::vector<char> failed;
+  unsigned ncompleted=0;
+  unsigned ntasks=0;
+  const std::vector<std::vector<unsigned>>* deps=nullptr;
+  const std::function<void(unsigned)>* func=nullptr;
+  std::vector<std::exception_ptr>* errors=nullptr;
+/// Loop run by the workers
+  void workerLoop();
+/// Run task i and mark it as completed. The lock is released while the task runs.
+  void runTask(unsigned i,std::unique_lock<std::mutex>& lock);
+public:
+/// Create a pool that runs tasks on nthreads threads, including the calling one
+  explicit ThreadPool(unsigned nthreads);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&)=delete;
+  ThreadPool& operator=(const ThreadPool&)=delete;
+/// Number of threads, including the calling one
+  unsigned getNumThreads() const {
+    return workers.size()+1;
+  }
+/// Check that the graph defined by deps has no cycles
+  static bool isAcyclic(const std::vector<std::vector<unsigned>>& deps);
+/// Run func(i) for each task i. Task i is only started when the tasks in deps[i] are completed.
+/// The graph should not contain cycles (see isAcyclic()).
+/// Exceptions thrown by task i are stored in errors[i]. The tasks depending on a task that
+/// failed are not run, and their errors are left empty.
+  void runGraph(const std::vector<std::vector<unsigned>>& deps,const std::function<void(unsigned)>& func,std::vector<std::exception_ptr>& errors);
+};
+
+}
+
+#endif
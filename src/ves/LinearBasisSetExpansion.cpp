@@ -32,6 +32,7 @@
 #include "tools/Keywords.h"
 #include "tools/Grid.h"
 #include "tools/Communicator.h"
+#include "tools/OpenMP.h"
 
 #include "GridProjWeights.h"
 
@@ -40,6 +41,70 @@
 namespace PLMD {
 namespace ves {
 
+namespace {
+
+// Contracts one dimension of a tensor stored in column-major order. The input has shape
+// (nbefore,nin,nafter), the output has shape (nbefore,nout,nafter) and is given by
+// out(p,x,q) = sum_i in(p,i,q)*matrix[x*nin+i]
+void contractDimension(const std::vector<double>& in, std::vector<double>& out, const size_t nbefore, const size_t nin, const size_t nout, const size_t nafter, const std::vector<double>& matrix) {
+  plumed_dbg_assert(in.size()==nbefore*nin*nafter);
+  plumed_dbg_assert(matrix.size()==nout*nin);
+  out.assign(nbefore*nout*nafter,0.0);
+  const size_t nouter=nout*nafter;
+  #pragma omp parallel num_threads(OpenMP::getNumThreads())
+  {
+    #pragma omp for
+    for(size_t j=0; j<nouter; j++) {
+      const size_t x=j%nout;
+      const size_t q=j/nout;
+      double* out_pntr=out.data()+nbefore*j;
+      for(size_t i=0; i<nin; i++) {
+        const double* in_pntr=in.data()+nbefore*(i+nin*q);
+        const double m=matrix[x*nin+i];
+        for(size_t p=0; p<nbefore; p++) {
+          out_pntr[p]+=m*in_pntr[p];
+        }
+      }
+    }
+  }
+}
+
+
+// Advances the column-major indices of a coefficient by step
+void advanceIndices(std::vector<unsigned int>& indices, const std::vector<unsigned int>& shape, const size_t step) {
+  size_t carry=step;
+  for(unsigned int k=0; k<indices.size() && carry>0; k++) {
+    carry+=indices[k];
+    indices[k]=carry%shape[k];
+    carry/=shape[k];
+  }
+}
+
+
+// Values and derivatives of the basis functions of dimension k on the grid points along
+// this dimension, stored as values[x*nbasisf+i] for grid point x and basis function i
+void getBasisFunctionsOnGridAxis(const Grid& grid, const unsigned int k, const BasisFunctions* basisf_pntr, std::vector<double>& values, std::vector<double>& derivs) {
+  const unsigned int nbasisf=basisf_pntr->getNumberOfBasisFunctions();
+  const unsigned int npoints=grid.getNbin()[k];
+  values.resize(npoints*nbasisf);
+  derivs.resize(npoints*nbasisf);
+  std::vector<unsigned int> indices(grid.getDimension(),0);
+  std::vector<double> point(grid.getDimension());
+  std::vector<double> tmp_val(nbasisf);
+  std::vector<double> tmp_der(nbasisf);
+  for(unsigned int x=0; x<npoints; x++) {
+    indices[k]=x;
+    grid.getPoint(indices,point);
+    double arg_trsfrm;
+    bool inside=true;
+    basisf_pntr->getAllValues(point[k],arg_trsfrm,inside,tmp_val,tmp_der);
+    std::copy(tmp_val.begin(),tmp_val.end(),values.begin()+x*nbasisf);
+    std::copy(tmp_der.begin(),tmp_der.end(),derivs.begin()+x*nbasisf);
+  }
+}
+
+}
+
 void LinearBasisSetExpansion::registerKeywords(Keywords& keys) {
 }
 
@@ -177,11 +242,15 @@ void LinearBasisSetExpansion::updateBiasGrid() {
   if(action_pntr_!=NULL &&  getStepOfLastBiasGridUpdate()==action_pntr_->getStep()) {
     return;
   }
+  std::vector<double> bias_values;
+  std::vector<std::vector<double>> forces_values(bias_grid_pntr_->hasDerivatives() ? nargs_ : 0);
+  getBiasAndForcesOnGrid(*bias_grid_pntr_,bias_values,forces_values);
+  std::vector<double> forces(nargs_,0.0);
   for(Grid::index_t l=0; l<bias_grid_pntr_->getSize(); l++) {
-    std::vector<double> forces(nargs_);
-    std::vector<double> args = bias_grid_pntr_->getPoint(l);
-    bool all_inside=true;
-    double bias=getBiasAndForces(args,all_inside,forces);
+    double bias=bias_values[l];
+    for(unsigned int k=0; k<forces_values.size(); k++) {
+      forces[k]=forces_values[k][l];
+    }
     //
     if(biasCutoffActive()) {
       vesbias_pntr_->applyBiasCutoff(bias,forces);
@@ -212,11 +281,15 @@ void LinearBasisSetExpansion::updateBiasWithoutCutoffGrid() {
     return;
   }
   //
+  std::vector<double> bias_values;
+  std::vector<std::vector<double>> forces_values(bias_withoutcutoff_grid_pntr_->hasDerivatives() ? nargs_ : 0);
+  getBiasAndForcesOnGrid(*bias_withoutcutoff_grid_pntr_,bias_values,forces_values);
+  std::vector<double> forces(nargs_,0.0);
   for(Grid::index_t l=0; l<bias_withoutcutoff_grid_pntr_->getSize(); l++) {
-    std::vector<double> forces(nargs_);
-    std::vector<double> args = bias_withoutcutoff_grid_pntr_->getPoint(l);
-    bool all_inside=true;
-    double bias=getBiasAndForces(args,all_inside,forces);
+    double bias=bias_values[l];
+    for(unsigned int k=0; k<forces_values.size(); k++) {
+      forces[k]=forces_values[k][l];
+    }
     if(bias_withoutcutoff_grid_pntr_->hasDerivatives()) {
       bias_withoutcutoff_grid_pntr_->setValueAndDerivatives(l,bias,forces);
     }
@@ -383,10 +456,13 @@ double LinearBasisSetExpansion::getBiasAndForces(const std::vector<double>& args
     stride=comm_in->Get_size();
     rank=comm_in->Get_rank();
   }
-  // loop over coeffs
+  // loop over coeffs, the indices are advanced by stride instead of being recomputed for each coeff
   double bias=0.0;
+  const std::vector<unsigned int> shape=coeffs_pntr_in->shapeOfIndices();
+  std::vector<unsigned int> indices;
+  if(rank<coeffs_pntr_in->numberOfCoeffs()) {indices=coeffs_pntr_in->getIndices(rank);}
   for(size_t i=rank; i<coeffs_pntr_in->numberOfCoeffs(); i+=stride) {
-    std::vector<unsigned int> indices=coeffs_pntr_in->getIndices(i);
+    if(i>rank) {advanceIndices(indices,shape,stride);}
     double coeff = coeffs_pntr_in->getValue(i);
     double bf_curr=1.0;
     for(unsigned int k=0; k<nargs; k++) {
@@ -439,8 +515,11 @@ void LinearBasisSetExpansion::getBasisSetValues(const std::vector<double>& args_
     rank=comm_in->Get_rank();
   }
   // loop over basis set
+  const std::vector<unsigned int> shape=coeffs_pntr_in->shapeOfIndices();
+  std::vector<unsigned int> indices;
+  if(rank<coeffs_pntr_in->numberOfCoeffs()) {indices=coeffs_pntr_in->getIndices(rank);}
   for(size_t i=rank; i<coeffs_pntr_in->numberOfCoeffs(); i+=stride) {
-    std::vector<unsigned int> indices=coeffs_pntr_in->getIndices(i);
+    if(i>rank) {advanceIndices(indices,shape,stride);}
     double bf_curr=1.0;
     for(unsigned int k=0; k<nargs; k++) {
       bf_curr*=bf_values[k][indices[k]];
@@ -479,6 +558,144 @@ double LinearBasisSetExpansion::getBasisSetValue(const std::vector<double>& args
 }
 
 
+void LinearBasisSetExpansion::getBiasAndForcesOnGrid(const Grid& grid, std::vector<double>& bias_values, std::vector<std::vector<double>>& forces_values, std::vector<BasisFunctions*>& basisf_pntrs_in, CoeffsVector* coeffs_pntr_in, Communicator* comm_in) {
+  unsigned int nargs = grid.getDimension();
+  plumed_assert(coeffs_pntr_in->numberOfDimensions()==nargs);
+  plumed_assert(basisf_pntrs_in.size()==nargs);
+  plumed_assert(forces_values.size()==0 || forces_values.size()==nargs);
+  const std::vector<unsigned int> npoints=grid.getNbin();
+  std::vector<unsigned int> shape=coeffs_pntr_in->shapeOfIndices();
+  //
+  size_t stride=1;
+  size_t rank=0;
+  if(comm_in!=NULL)
+  {
+    stride=comm_in->Get_size();
+    rank=comm_in->Get_rank();
+  }
+  // the coeffs are divided between the ranks along the last dimension
+  const unsigned int first=(shape[nargs-1]*rank)/stride;
+  const unsigned int last=(shape[nargs-1]*(rank+1))/stride;
+  size_t blocksize=1;
+  for(unsigned int k=0; k<(nargs-1); k++) {blocksize*=shape[k];}
+  //
+  std::vector< std::vector <double> > bf_values(nargs);
+  std::vector< std::vector <double> > bf_derivs(nargs);
+  for(unsigned int k=0; k<nargs; k++) {
+    plumed_assert(basisf_pntrs_in[k]->getNumberOfBasisFunctions()==shape[k]);
+    getBasisFunctionsOnGridAxis(grid,k,basisf_pntrs_in[k],bf_values[k],bf_derivs[k]);
+  }
+  // keep only the basis functions of this rank for the last dimension
+  if(last-first!=shape[nargs-1]) {
+    const unsigned int k=nargs-1;
+    for(unsigned int x=0; x<npoints[k]; x++) {
+      for(unsigned int i=first; i<last; i++) {
+        bf_values[k][x*(last-first)+(i-first)]=bf_values[k][x*shape[k]+i];
+        bf_derivs[k][x*(last-first)+(i-first)]=bf_derivs[k][x*shape[k]+i];
+      }
+    }
+    bf_values[k].resize(npoints[k]*(last-first));
+    bf_derivs[k].resize(npoints[k]*(last-first));
+  }
+  shape[nargs-1]=last-first;
+  // contract the coeffs one dimension at a time, starting from the last one,
+  // partial[k] is the result after the dimensions from k onwards have been contracted
+  std::vector< std::vector <double> > partial(nargs+1);
+  const std::vector<double> coeffs=coeffs_pntr_in->getDataAsVector();
+  partial[nargs].assign(coeffs.begin()+first*blocksize,coeffs.begin()+last*blocksize);
+  auto nbefore = [&shape](const unsigned int k) {
+    size_t n=1;
+    for(unsigned int l=0; l<k; l++) {n*=shape[l];}
+    return n;
+  };
+  auto nafter = [&npoints,nargs](const unsigned int k) {
+    size_t n=1;
+    for(unsigned int l=k+1; l<nargs; l++) {n*=npoints[l];}
+    return n;
+  };
+  for(unsigned int k=nargs; k>0; k--) {
+    contractDimension(partial[k],partial[k-1],nbefore(k-1),shape[k-1],npoints[k-1],nafter(k-1),bf_values[k-1]);
+  }
+  bias_values.swap(partial[0]);
+  // the derivative along dimension k uses the derivatives of the basis functions for this dimension
+  std::vector<double> tmp1;
+  std::vector<double> tmp2;
+  for(unsigned int k=0; k<forces_values.size(); k++) {
+    contractDimension(partial[k+1],tmp1,nbefore(k),shape[k],npoints[k],nafter(k),bf_derivs[k]);
+    for(unsigned int l=k; l>0; l--) {
+      contractDimension(tmp1,tmp2,nbefore(l-1),shape[l-1],npoints[l-1],nafter(l-1),bf_values[l-1]);
+      tmp1.swap(tmp2);
+    }
+    forces_values[k].resize(tmp1.size());
+    for(size_t l=0; l<tmp1.size(); l++) {
+      forces_values[k][l]=-tmp1[l];
+    }
+  }
+  //
+  if(comm_in!=NULL) {
+    comm_in->Sum(bias_values);
+    for(unsigned int k=0; k<forces_values.size(); k++) {
+      comm_in->Sum(forces_values[k]);
+    }
+  }
+}
+
+
+void LinearBasisSetExpansion::getBasisSetAveragesOnGrid(const Grid& grid, const std::vector<double>& weights, std::vector<double>& basisset_averages, std::vector<BasisFunctions*>& basisf_pntrs_in, CoeffsVector* coeffs_pntr_in, Communicator* comm_in) {
+  unsigned int nargs = grid.getDimension();
+  plumed_assert(coeffs_pntr_in->numberOfDimensions()==nargs);
+  plumed_assert(basisf_pntrs_in.size()==nargs);
+  plumed_assert(weights.size()==grid.getSize());
+  std::vector<unsigned int> npoints=grid.getNbin();
+  const std::vector<unsigned int> shape=coeffs_pntr_in->shapeOfIndices();
+  //
+  size_t stride=1;
+  size_t rank=0;
+  if(comm_in!=NULL)
+  {
+    stride=comm_in->Get_size();
+    rank=comm_in->Get_rank();
+  }
+  // the grid points are divided between the ranks along the last dimension
+  const unsigned int first=(npoints[nargs-1]*rank)/stride;
+  const unsigned int last=(npoints[nargs-1]*(rank+1))/stride;
+  size_t blocksize=1;
+  for(unsigned int k=0; k<(nargs-1); k++) {blocksize*=npoints[k];}
+  // the matrices are transposed, bf_values[k][i*npoints+x] for basis function i and grid point x
+  std::vector< std::vector <double> > bf_values(nargs);
+  for(unsigned int k=0; k<nargs; k++) {
+    plumed_assert(basisf_pntrs_in[k]->getNumberOfBasisFunctions()==shape[k]);
+    std::vector<double> values;
+    std::vector<double> derivs;
+    getBasisFunctionsOnGridAxis(grid,k,basisf_pntrs_in[k],values,derivs);
+    const unsigned int x0 = (k==nargs-1) ? first : 0;
+    const unsigned int x1 = (k==nargs-1) ? last : npoints[k];
+    bf_values[k].resize(shape[k]*(x1-x0));
+    for(unsigned int x=x0; x<x1; x++) {
+      for(unsigned int i=0; i<shape[k]; i++) {
+        bf_values[k][i*(x1-x0)+(x-x0)]=values[x*shape[k]+i];
+      }
+    }
+  }
+  npoints[nargs-1]=last-first;
+  // contract the weights one dimension at a time, starting from the last one
+  std::vector<double> tmp1(weights.begin()+first*blocksize,weights.begin()+last*blocksize);
+  std::vector<double> tmp2;
+  for(unsigned int k=nargs; k>0; k--) {
+    size_t nbefore=1;
+    for(unsigned int l=0; l<(k-1); l++) {nbefore*=npoints[l];}
+    size_t nafter=1;
+    for(unsigned int l=k; l<nargs; l++) {nafter*=shape[l];}
+    contractDimension(tmp1,tmp2,nbefore,npoints[k-1],shape[k-1],nafter,bf_values[k-1]);
+    tmp1.swap(tmp2);
+  }
+  basisset_averages.swap(tmp1);
+  if(comm_in!=NULL) {
+    comm_in->Sum(basisset_averages);
+  }
+}
+
+
 void LinearBasisSetExpansion::setupUniformTargetDistribution() {
   std::vector< std::vector <double> > bf_integrals(0);
   std::vector<double> targetdist_averages(ncoeffs_,0.0);
@@ -555,21 +772,12 @@ void LinearBasisSetExpansion::restartTargetDistribution() {
 
 void LinearBasisSetExpansion::calculateTargetDistAveragesFromGrid(const Grid* targetdist_grid_pntr) {
   plumed_assert(targetdist_grid_pntr!=NULL);
-  std::vector<double> targetdist_averages(ncoeffs_,0.0);
-  std::vector<double> integration_weights = GridIntegrationWeights::getIntegrationWeights(targetdist_grid_pntr);
-  Grid::index_t stride=mycomm_.Get_size();
-  Grid::index_t rank=mycomm_.Get_rank();
-  for(Grid::index_t l=rank; l<targetdist_grid_pntr->getSize(); l+=stride) {
-    std::vector<double> args_values = targetdist_grid_pntr->getPoint(l);
-    std::vector<double> basisset_values(ncoeffs_);
-    // parallelization done over the grid -> should NOT use parallel in getBasisSetValues!!
-    getBasisSetValues(args_values,basisset_values,false);
-    double weight = integration_weights[l]*targetdist_grid_pntr->getValue(l);
-    for(unsigned int i=0; i<ncoeffs_; i++) {
-      targetdist_averages[i] += weight*basisset_values[i];
-    }
+  std::vector<double> targetdist_averages;
+  std::vector<double> weights = GridIntegrationWeights::getIntegrationWeights(targetdist_grid_pntr);
+  for(Grid::index_t l=0; l<targetdist_grid_pntr->getSize(); l++) {
+    weights[l] *= targetdist_grid_pntr->getValue(l);
   }
-  mycomm_.Sum(targetdist_averages);
+  getBasisSetAveragesOnGrid(*targetdist_grid_pntr,weights,targetdist_averages,basisf_pntrs_,bias_coeffs_pntr_,&mycomm_);
   // the overall constant;
   targetdist_averages[0] = getBasisSetConstant();
   TargetDistAverages() = targetdist_averages;
@@ -124,10 +124,16 @@ public:
   double getBiasAndForces(const std::vector<double>&, bool&, std::vector<double>&, std::vector<double>&);
   double getBiasAndForces(const std::vector<double>&, bool&, std::vector<double>&);
   double getBias(const std::vector<double>&, bool&, const bool parallel=true);
+  // calculate bias and derivatives on all the points of a grid by contracting the coeffs one dimension at a time
+  static void getBiasAndForcesOnGrid(const Grid&, std::vector<double>&, std::vector<std::vector<double>>&, std::vector<BasisFunctions*>&, CoeffsVector*, Communicator* comm_in=NULL);
+  void getBiasAndForcesOnGrid(const Grid&, std::vector<double>&, std::vector<std::vector<double>>&);
   //
   static void getBasisSetValues(const std::vector<double>&, std::vector<double>&, std::vector<BasisFunctions*>&, CoeffsVector*, Communicator* comm_in=NULL);
   void getBasisSetValues(const std::vector<double>&, std::vector<double>&, const bool parallel=true);
   //
+  // averages of the basis functions over a grid with the given weights on each point
+  static void getBasisSetAveragesOnGrid(const Grid&, const std::vector<double>&, std::vector<double>&, std::vector<BasisFunctions*>&, CoeffsVector*, Communicator* comm_in=NULL);
+  //
   static double getBasisSetValue(const std::vector<double>&, const size_t, std::vector<BasisFunctions*>&, CoeffsVector*);
   double getBasisSetValue(const std::vector<double>&, const size_t);
   double getBasisSetConstant();
@@ -219,6 +225,12 @@ double LinearBasisSetExpansion::getBias(const std::vector<double>& args_values,
 }
 
 
+inline
+void LinearBasisSetExpansion::getBiasAndForcesOnGrid(const Grid& grid, std::vector<double>& bias_values, std::vector<std::vector<double>>& forces_values) {
+  getBiasAndForcesOnGrid(grid,bias_values,forces_values,basisf_pntrs_,bias_coeffs_pntr_,&mycomm_);
+}
+
+
 inline
 void LinearBasisSetExpansion::getBasisSetValues(const std::vector<double>& args_values, std::vector<double>& basisset_values, const bool parallel) {
   if(parallel) {
@@ -192,6 +192,7 @@ public:
   void apply() override {};
   void calculate() override {};
   void update() override;
+  bool checkIsHistoryDependent()const override {return true;}
   unsigned int getNumberOfDerivatives() override {return 0;}
   //
   bool fixedStepSize() const {return fixed_stepsize_;}